@@ -234,7 +234,7 @@ void Camera::update_view() {
 
 void Camera::allocate_buffers(Device& device) {
     for (int i = 0; i < FRAME_OVERLAP; i++) {
-        Buffer::create_buffer(device, &g_frames[i].cameraBuffer, sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        Buffer::create_buffer(device, &g_frames[i].cameraBuffer, sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
     }
 }
 
@@ -246,4 +246,29 @@ GPUCameraData Camera::gpu_format() {
     camData.flip = this->get_flip();
 
     return camData;
+}
+
+/**
+ * Planes are extracted from the rows of the view projection matrix (Gribb & Hartmann), with a [0, 1] depth range.
+ * A point p is inside the frustum when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+ * @brief frustum planes of a view projection
+ * @param viewProj view projection matrix
+ * @return normalized left, right, bottom, top, near and far planes
+ */
+std::array<glm::vec4, 6> Camera::frustum_planes(const glm::mat4& viewProj) {
+    const glm::mat4 m = glm::transpose(viewProj); // rows of the matrix as columns
+    std::array<glm::vec4, 6> planes = {
+            m[3] + m[0],
+            m[3] - m[0],
+            m[3] + m[1],
+            m[3] - m[1],
+            m[2],
+            m[3] - m[2],
+    };
+
+    for (auto& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return planes;
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include <GLFW/glfw3.h>
 #include <cmath>
 #include <unordered_map>
+#include <array>
 
 class Device;
 
@@ -70,6 +71,7 @@ public:
     bool update_camera(float delta);
     static void allocate_buffers(Device& device);
     GPUCameraData gpu_format();
+    static std::array<glm::vec4, 6> frustum_planes(const glm::mat4& viewProj);
 
 private:
     glm::vec3 position = glm::vec3();
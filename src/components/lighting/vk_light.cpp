@@ -98,10 +98,3 @@ GPULightData LightingManager::gpu_format() {
 
     return lightingData;
 }
-
-void LightingManager::allocate_buffers(Device& device) {
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-        const size_t lightBufferSize = helper::pad_uniform_buffer_size(device, sizeof(GPULightData)); // FRAME_OVERLAP * 
-        Buffer::create_buffer(device, &g_frames[i].lightingBuffer, lightBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-    }
-}
\ No newline at end of file
@@ -72,5 +72,4 @@ class LightingManager final : public System {
 public:
     GPULightData gpu_format();
 
-    static void allocate_buffers(Device& device);
 };
\ No newline at end of file
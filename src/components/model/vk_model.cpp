@@ -10,7 +10,10 @@
 #include "core/vk_device.h"
 #include "core/vk_command_buffer.h"
 #include "components/camera/vk_camera.h"
-#include "core/vk_descriptor_allocator.h"
+#include "core/vk_bindless_table.h"
+
+#include <functional>
+#include <algorithm>
 
 std::atomic<uint32_t> Model::nextID {0};
 
@@ -21,6 +24,16 @@ Model::~Model() {
 }
 
 void Model::destroy() {
+    if (_bindless) {
+        for (auto& image : _images) {
+            _bindless->release_texture(image._bindlessIndex);
+        }
+        for (auto& material : _materials) {
+            _bindless->release_material(material._bindlessIndex);
+        }
+        _bindless = nullptr;
+    }
+
     for (auto node : _nodes) {
         delete node;
     }
@@ -44,8 +57,22 @@ VkDescriptorImageInfo Model::get_texture_descriptor(const size_t index)
     return _images[index]._texture._descriptor;
 }
 
-void Model::draw_node(Node* node, VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance) {
-    if (!node->mesh.primitives.empty()) {
+/**
+ * Primitives are enumerated depth first, in node order : the same order as the culling results.
+ * @brief draw the primitives of a node and its children
+ * @param visibility per primitive visibility, every primitive is drawn if null
+ * @param primitiveIndex index of the next primitive in the enumeration
+ */
+void Model::draw_node(Node* node, VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance, const uint8_t* visibility, uint32_t& primitiveIndex) {
+    const uint32_t first = primitiveIndex;
+    primitiveIndex += static_cast<uint32_t>(node->mesh.primitives.size());
+
+    bool visible = visibility == nullptr;
+    for (uint32_t i = first; i < primitiveIndex && !visible; i++) {
+        visible = visibility[i] != 0;
+    }
+
+    if (visible && !node->mesh.primitives.empty()) {
         glm::mat4 nodeMatrix = node->matrix;
         Node* parent = node->parent;
         while (parent) {
@@ -55,59 +82,149 @@ void Model::draw_node(Node* node, VkCommandBuffer& commandBuffer, VkPipelineLayo
 
         vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
 
-        for (Primitive& primitive : node->mesh.primitives) {
-            if (primitive.indexCount > 0) {
+        for (uint32_t i = 0; i < node->mesh.primitives.size(); i++) {
+            Primitive& primitive = node->mesh.primitives[i];
+            if (primitive.indexCount > 0 && (visibility == nullptr || visibility[first + i])) {
+                uint32_t materialIndex = BindlessTable::DEFAULT_INDEX;
                 if (!_materials.empty() && primitive.materialIndex != -1) { // handle non-gltf meshes // !_textures.empty()
-                    Materials material = _materials[primitive.materialIndex];
-                    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, offset, sizeof(Materials::Factors), &material.factors);
-                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &material._descriptorSet, 0, nullptr);
+                    materialIndex = _materials[primitive.materialIndex]._bindlessIndex;
                 }
+                // Textures and factors are fetched from the bindless set : only the material slot changes between primitives
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, offset, sizeof(uint32_t), &materialIndex);
                 vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, instance);
             }
         }
     }
 
     for (auto& child : node->children) {
-        draw_node(child, commandBuffer, pipelineLayout, offset, instance);
+        draw_node(child, commandBuffer, pipelineLayout, offset, instance, visibility, primitiveIndex);
     }
 }
 
-void Model::draw(VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance, bool bind) {
+void Model::bind(VkCommandBuffer& commandBuffer) {
+    VkDeviceSize offsets[1] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &_vertexBuffer._buffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, _indexBuffer.allocation._buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void Model::draw(VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance, bool bind, const uint8_t* visibility) {
     if (bind) {
-        VkDeviceSize offsets[1] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &_vertexBuffer._buffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, _indexBuffer.allocation._buffer, 0, VK_INDEX_TYPE_UINT32);
+        this->bind(commandBuffer);
     }
 
+    uint32_t primitiveIndex = 0;
     for (auto& node : _nodes) {
-        draw_node(node, commandBuffer, pipelineLayout, offset, instance);
+        draw_node(node, commandBuffer, pipelineLayout, offset, instance, visibility, primitiveIndex);
     }
 }
 
-void Model::setup_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout) {
-    std::vector<VkDescriptorPoolSize> poolSizes = {
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>( 5 ) }
+/**
+ * Bound the indexed vertices of every primitive, in model space. Primitives without vertices keep an empty box.
+ * @brief compute primitive bounding boxes
+ */
+void Model::compute_bounds() {
+    std::function<void(Node*)> compute = [&](Node* node) {
+        for (Primitive& primitive : node->mesh.primitives) {
+            primitive.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            primitive.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+            const uint32_t last = std::min(primitive.firstIndex + primitive.indexCount, static_cast<uint32_t>(_indexesBuffer.size()));
+            for (uint32_t i = primitive.firstIndex; i < last; i++) {
+                if (_indexesBuffer[i] < _verticesBuffer.size()) {
+                    primitive.boundsMin = glm::min(primitive.boundsMin, _verticesBuffer[_indexesBuffer[i]].position);
+                    primitive.boundsMax = glm::max(primitive.boundsMax, _verticesBuffer[_indexesBuffer[i]].position);
+                }
+            }
+        }
+        for (auto& child : node->children) {
+            compute(child);
+        }
     };
-    Texture& emptyTexture = this->_images.back()._texture;
+
+    for (auto& node : _nodes) {
+        compute(node);
+    }
+}
+
+/**
+ * Register model textures and materials into the bindless table. Materials reference textures by slot index,
+ * missing textures fall back to the white texture of the table default slot.
+ * @brief setup model textures and materials
+ * @param bindlessTable bindless textures and materials
+ */
+void Model::setup_descriptors(BindlessTable& bindlessTable) {
+    if (_bindless == &bindlessTable) {
+        return; // models shared by several objects are set up once
+    }
+    _bindless = &bindlessTable;
+
+    for (auto& image : this->_images) {
+        image._bindlessIndex = bindlessTable.register_texture(image._texture._descriptor);
+    }
 
     for (auto &material: this->_materials) {
-        VkDescriptorImageInfo colorMap = material.baseColorTexture ? material.baseColorTexture->_texture._descriptor : emptyTexture._descriptor;
-        VkDescriptorImageInfo normalMap = material.normalTexture ? material.normalTexture->_texture._descriptor : emptyTexture._descriptor;
-        VkDescriptorImageInfo metallicRoughnessMap = material.metallicRoughnessTexture ? material.metallicRoughnessTexture->_texture._descriptor : emptyTexture._descriptor;
-        VkDescriptorImageInfo aoMap = material.aoTexture ? material.aoTexture->_texture._descriptor : emptyTexture._descriptor;
-        VkDescriptorImageInfo emissiveMap = material.emissiveTexture ? material.emissiveTexture->_texture._descriptor : emptyTexture._descriptor;
-
-        DescriptorBuilder::begin(layoutCache, allocator)
-            .bind_image(colorMap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0)
-            .bind_image(normalMap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
-            .bind_image(metallicRoughnessMap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2)
-            .bind_image(aoMap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3)
-            .bind_image(emissiveMap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4)
-            .layout(setLayout)
-            .build(material._descriptorSet, setLayout, poolSizes);
+        material._bindlessIndex = bindlessTable.register_material(material_data(material));
     }
 }
 
+/**
+ * Objects sharing the model pick one of its materials with RenderObject::materialIndex. The material is registered
+ * right away if the model descriptors are already set up.
+ * @brief add a material to the model, identical materials are shared
+ * @param material
+ * @return index of the material in the model
+ */
+uint32_t Model::add_material(const Materials& material) {
+    auto same = [&material](const Materials& other) {
+        return other.factors.baseColorFactor == material.factors.baseColorFactor &&
+               other.factors.metallicFactor == material.factors.metallicFactor &&
+               other.factors.roughnessFactor == material.factors.roughnessFactor &&
+               other.factors.alphaCutoff == material.factors.alphaCutoff &&
+               other.pbr == material.pbr &&
+               other.baseColorTexture == material.baseColorTexture &&
+               other.normalTexture == material.normalTexture &&
+               other.metallicRoughnessTexture == material.metallicRoughnessTexture &&
+               other.aoTexture == material.aoTexture &&
+               other.emissiveTexture == material.emissiveTexture;
+    };
+
+    auto it = std::find_if(_materials.begin(), _materials.end(), same);
+    if (it != _materials.end()) {
+        return static_cast<uint32_t>(it - _materials.begin());
+    }
+
+    _materials.push_back(material);
+    if (_bindless) {
+        _materials.back()._bindlessIndex = _bindless->register_material(material_data(_materials.back()));
+    }
+    return static_cast<uint32_t>(_materials.size() - 1);
+}
+
+/**
+ * Textures must be registered : missing textures fall back to the white texture of the table default slot, shared
+ * by every model.
+ * @brief bindless material entry of a model material
+ * @param material
+ * @return material data
+ */
+GPUMaterialData Model::material_data(const Materials& material) const {
+    auto textureIndex = [](const Image* image) {
+        return image ? image->_bindlessIndex : BindlessTable::DEFAULT_INDEX;
+    };
+
+    GPUMaterialData data;
+    data.baseColorFactor = material.factors.baseColorFactor;
+    data.metallicFactor = material.factors.metallicFactor;
+    data.roughnessFactor = material.factors.roughnessFactor;
+    data.alphaCutoff = material.factors.alphaCutoff;
+    data.baseColorTexture = textureIndex(material.baseColorTexture);
+    data.normalTexture = textureIndex(material.normalTexture);
+    data.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+    data.aoTexture = textureIndex(material.aoTexture);
+    data.emissiveTexture = textureIndex(material.emissiveTexture);
+
+    return data;
+}
+
 VertexInputDescription Vertex::get_vertex_description()
 {
     VertexInputDescription description;
@@ -163,13 +280,3 @@ VertexInputDescription Vertex::get_vertex_description()
 
     return description;
 }
-
-void Model::load_empty(const Device& device, const UploadContext& ctx) {
-    // === Empty texture ===
-    unsigned char pixels[] = {255, 255, 255, 255};
-    Image image;
-    image._texture.load_image_from_buffer(device, ctx, pixels, 4, VK_FORMAT_R8G8B8A8_UNORM, 1, 1);
-    image._texture._name = "Empty";
-    image._texture._uri = "Unknown";
-    _images.emplace_back(std::move(image));
-}
@@ -17,6 +17,7 @@
 #include <vector>
 #include <iostream>
 #include <atomic>
+#include <limits>
 
 #include "core/manager/vk_system_manager.h"
 #include "core/vk_texture.h"
@@ -26,8 +27,7 @@
 #include "core/vk_descriptor_builder.h"
 
 class Device;
-class DescriptorLayoutCache;
-class DescriptorAllocator;
+class BindlessTable;
 
 struct VertexInputDescription {
     std::vector<VkVertexInputBindingDescription> bindings;
@@ -62,6 +62,9 @@ struct Primitive {
     uint32_t firstIndex;
     uint32_t indexCount;
     int32_t materialIndex;
+    /** @brief model space bounding box, empty (min > max) until computed */
+    glm::vec3 boundsMin {std::numeric_limits<float>::max()};
+    glm::vec3 boundsMax {std::numeric_limits<float>::lowest()};
 };
 
 struct Mesh {
@@ -87,6 +90,7 @@ struct Node {
 struct Image {
     Texture _texture;
     VkDescriptorSet _descriptorSet; // access texture from the fragment shader
+    uint32_t _bindlessIndex = 0; // slot in the bindless texture array
 };
 
 struct Materials {
@@ -109,7 +113,7 @@ struct Materials {
     Image *aoTexture = nullptr;
     Image *emissiveTexture = nullptr;
 
-    VkDescriptorSet _descriptorSet = VK_NULL_HANDLE; // access texture from the fragment shader
+    uint32_t _bindlessIndex = 0; // slot in the bindless material buffer, accessed from the fragment shader
 
     bool pbr = false;
 
@@ -160,14 +164,19 @@ public:
     virtual bool load_model(const Device& device, const UploadContext& ctx, const char *filename) { return false; };
 
     void destroy();
-    void draw(VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance, bool bind);
+    void bind(VkCommandBuffer& commandBuffer);
+    void draw(VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance, bool bind, const uint8_t* visibility = nullptr);
+    void compute_bounds();
     VkDescriptorImageInfo get_texture_descriptor(const size_t index);
-    void setup_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout);
-    void load_empty(const Device& device, const UploadContext& ctx);
+    void setup_descriptors(BindlessTable& bindlessTable);
+    uint32_t add_material(const Materials& material);
 
 protected:
-    void draw_node(Node* node, VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance);
+    void draw_node(Node* node, VkCommandBuffer& commandBuffer, VkPipelineLayout& pipelineLayout, uint32_t offset, uint32_t instance, const uint8_t* visibility, uint32_t& primitiveIndex);
+    GPUMaterialData material_data(const Materials& material) const;
 
 private:
     Device* _device {nullptr};
+    /** @brief bindless table holding model textures and materials */
+    BindlessTable* _bindless {nullptr};
 };
\ No newline at end of file
@@ -8,13 +8,51 @@
 
 #include "vk_poly.h"
 #include "core/vk_device.h"
+#include "core/manager/vk_mesh_manager.h"
 
 #include <array>
+#include <sstream>
+
+/**
+ * Meshes built from the same shape and parameters share a key : MeshManager::get_or_create_model uploads them once.
+ * @brief mesh manager key of a procedural mesh
+ * @param shape shape name
+ * @param parameters shape parameters
+ * @return key
+ */
+std::string ModelPOLY::key(const std::string& shape, std::initializer_list<float> parameters) {
+    std::ostringstream stream;
+    stream << shape << "(";
+    for (auto it = parameters.begin(); it != parameters.end(); it++) {
+        stream << (it == parameters.begin() ? "" : ",") << *it;
+    }
+    stream << ")";
+    return stream.str();
+}
 
+/**
+ * Every shape parameter is part of the key. The shared mesh has no material of its own : objects drawing it pick
+ * theirs with RenderObject::materialIndex.
+ * @brief get a UV sphere from the mesh manager, created and uploaded on first request
+ * @param meshManager mesh manager owning the shared mesh
+ * @param device
+ * @param ctx upload context
+ * @param center sphere center
+ * @param radius sphere radius
+ * @param stacks number of horizontal slices
+ * @param sectors number of vertical slices
+ * @param color vertex color
+ * @return shared mesh
+ */
+std::shared_ptr<Model> ModelPOLY::get_uv_sphere(MeshManager& meshManager, Device* device, UploadContext& ctx, const glm::vec3& center, float radius, uint32_t stacks, uint32_t sectors, glm::vec3 color) {
+    const std::string name = key("uv_sphere", {center.x, center.y, center.z, radius, static_cast<float>(stacks), static_cast<float>(sectors), color.r, color.g, color.b});
+    return meshManager.get_or_create_model(name, [&]() {
+        return create_uv_sphere(device, ctx, center, radius, stacks, sectors, color);
+    });
+}
 
 std::shared_ptr<Model> ModelPOLY::create_cube(Device* device, UploadContext& ctx, const glm::vec3& p0, const glm::vec3& p1, std::optional<Materials> props) {
     std::shared_ptr<Model> model = std::make_shared<ModelPOLY>(device);
-    model->load_empty(*device, ctx);
     model->_name = "Cube";
     Node *node = new Node{};
     node->matrix = glm::mat4(1.f);
@@ -95,7 +133,6 @@ std::shared_ptr<Model> ModelPOLY::create_cube(Device* device, UploadContext& ctx
 
 std::shared_ptr<Model> ModelPOLY::create_uv_sphere(Device* device, UploadContext& ctx, const glm::vec3& center, float radius, uint32_t stacks, uint32_t sectors, glm::vec3 color, std::optional<Materials> props) {
     std::shared_ptr<Model> model = std::make_shared<ModelPOLY>(device);
-    model->load_empty(*device, ctx);
     model->_name = "UV_sphere";
     float x, y, z, xy = 0;
     Node* node = new Node{};
@@ -159,7 +196,6 @@ std::shared_ptr<Model> ModelPOLY::create_uv_sphere(Device* device, UploadContext
 
 std::shared_ptr<Model> ModelPOLY::create_triangle(Device* device, UploadContext& ctx, glm::vec3 color, std::optional<Materials> props) {
     std::shared_ptr<Model> model = std::make_shared<ModelPOLY>(device);
-    model->load_empty(*device, ctx);
     model->_name = "Triangle";
 
     Node* node = new Node{};
@@ -199,7 +235,6 @@ std::shared_ptr<Model> ModelPOLY::create_triangle(Device* device, UploadContext&
 
 std::shared_ptr<Model> ModelPOLY::create_plane(Device* device, UploadContext& ctx, const glm::vec3& p0, const glm::vec3& p1, glm::vec3 color, std::optional<Materials> props) {
     std::shared_ptr<Model> model = std::make_shared<ModelPOLY>(device);
-    model->load_empty(*device, ctx);
     model->_name = "Plane";
 
     Node *node = new Node{};
@@ -10,9 +10,12 @@
 
 #include "vk_model.h"
 #include <optional>
+#include <string>
+#include <initializer_list>
 
 class Device;
 class Model;
+class MeshManager;
 
 class ModelPOLY final: public Model {
 public:
@@ -21,5 +24,8 @@ public:
     static std::shared_ptr<Model> create_cube(Device* device, UploadContext& ctx, const glm::vec3& p0, const glm::vec3& p1, std::optional<Materials> props = std::nullopt);
     static std::shared_ptr<Model> create_triangle(Device* device, UploadContext& ctx, glm::vec3 color = { 1.f, 1.f, 1.f}, std::optional<Materials> props = std::nullopt);
     static std::shared_ptr<Model> create_uv_sphere(Device* device, UploadContext& ctx, const glm::vec3& center, float radius = 1.f, uint32_t stacks = 16, uint32_t sectors = 17, glm::vec3 color = {1.f, 1.f, 1.f}, const std::optional<Materials> props = std::nullopt);
+    static std::shared_ptr<Model> get_uv_sphere(MeshManager& meshManager, Device* device, UploadContext& ctx, const glm::vec3& center, float radius = 1.f, uint32_t stacks = 16, uint32_t sectors = 17, glm::vec3 color = {1.f, 1.f, 1.f});
+    static std::string key(const std::string& shape, std::initializer_list<float> parameters);
+
     static std::shared_ptr<Model> create_plane(Device* device, UploadContext& ctx, const glm::vec3& p0, const glm::vec3& p1, glm::vec3 color = {1.f, 1.f, 1.f}, std::optional<Materials> props = std::nullopt);
 };
\ No newline at end of file
@@ -19,6 +19,7 @@
 #include "components/camera/vk_camera.h"
 #include "core/utilities/vk_initializers.h"
 #include "core/utilities/vk_global.h"
+#include "core/utilities/vk_memory_statistics.h"
 #include "techniques/vk_env_map.h"
 
 #include "stb_image.h"
@@ -124,12 +125,14 @@ void Skybox::load_sphere_texture(const char* file, Texture& texture, VkFormat fo
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(_device._allocator, &imgInfo, &imgAllocinfo, &texture._image, &texture._allocation, nullptr);
+    MemoryStatistics::track(_device._allocator, texture._allocation, MemoryCategory::IBL);
 
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, texture._image, VK_IMAGE_ASPECT_COLOR_BIT);
     vkCreateImageView(_device._logicalDevice, &imageViewInfo, nullptr, &texture._imageView);
 
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(_device._logicalDevice, &samplerInfo, nullptr, &texture._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(_device, _uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
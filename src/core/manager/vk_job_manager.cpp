@@ -14,10 +14,12 @@
 */
 void JobManager::init() {
     _finishedLabel.store(0);
+    _currentLabel.store(0);
 
     // Get number of threads supported
     unsigned int nCores = std::thread::hardware_concurrency();
-    _numThreads = 2u > (nCores / 2) ? 1u : 2u;
+    // Keep one core for the main thread
+    _numThreads = nCores > 1 ? nCores - 1 : 1u;
     _run = true;
     std::printf("Number of threads supported %i, used %i \n", nCores, _numThreads);
 
@@ -131,4 +133,7 @@ void JobManager::dispatch(uint32_t jobCount, uint32_t groupSize, std::function<v
                 poll();
             }
         }
+
+    // Wake up every worker : groups are meant to run in parallel
+    _cv.notify_all();
     };
\ No newline at end of file
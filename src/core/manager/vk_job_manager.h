@@ -83,8 +83,8 @@ namespace JobManager {
     inline std::mutex _mutex;
     /** @brief Job pool */
     inline ThreadSafeQueue<std::function<void()>> _jobPool;
-    /** @brief Label of latest job submitted by main thread*/
-    inline uint32_t _currentLabel;
+    /** @brief Label of latest job submitted. Jobs can be submitted from worker threads. */
+    inline std::atomic<uint32_t> _currentLabel;
     /** @brief State of execution. Latest job executed. */
     inline std::atomic<uint32_t> _finishedLabel;
 
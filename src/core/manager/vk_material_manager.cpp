@@ -9,20 +9,59 @@
 #include "vk_material_manager.h"
 #include "core/vk_device.h"
 #include "core/vk_pipeline.h"
+#include "core/utilities/vk_global.h"
+#include "core/utilities/vk_helpers.h"
 #include "components/model/vk_pbr_material.h"
+#include "core/vk_shader_module_cache.h"
+
+#include <algorithm>
 
 MaterialManager::MaterialManager(const Device* device) : _device(device) {}
 
 MaterialManager::~MaterialManager() {
    _entities.clear();
-   _discarded.clear();
 }
 
 std::shared_ptr<Material> MaterialManager::get_material(const std::string &name) {
     return std::static_pointer_cast<Material>(this->get_entity(name));
 }
 
+/**
+ * A pass with the same pipeline description is returned when it has already been built,
+ * no shader is loaded and no pipeline is compiled. The name is an alias of the pass, or of a variant sharing
+ * its pipeline when only dynamic rasterization state differs.
+ * @brief create or get a material
+ * @param pipelineBuilder pipeline builder holding the fixed-function state
+ * @param name material name
+ * @param setLayouts collection of descriptor set layouts
+ * @param constants push constants, in order
+ * @param shaders shader stages and SPIR-V file paths
+ * @param shaderSpecialization specialization constants per shader stage
+ * @return material
+ */
 std::shared_ptr<Material> MaterialManager::create_material(PipelineBuilder& pipelineBuilder, std::string name, std::vector<VkDescriptorSetLayout> setLayouts, std::vector<PushConstant> constants, std::vector<std::pair<ShaderType, const char*>> shaders, std::unordered_map<ShaderType, VkSpecializationInfo> shaderSpecialization) {
+    // Uber-shaders are only drawn through their variants : the unspecialized pipeline is never compiled
+    if (shaderSpecialization.empty() && declares_variant(shaders)) {
+        auto material = std::make_shared<ShaderPass>();
+        material->pipelineLayout = VK_NULL_HANDLE;
+        material->pipeline = VK_NULL_HANDLE;
+        material->_device = _device->_logicalDevice;
+        material->variants = std::make_shared<MaterialVariants>();
+        material->variants->name = name;
+        material->variants->setLayouts = setLayouts;
+        material->variants->constants = constants;
+        for (const auto& [type, path] : shaders) {
+            material->variants->shaders.emplace_back(type, path);
+        }
+
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (this->_entities.count(name) != 0) {
+            g_deletionQueue.retire(this->get_entity(name));
+        }
+        this->add_entity(name, material);
+        return material;
+    }
+
     std::vector<VkPushConstantRange> pushConstants {};
     uint32_t offset = 0;
     for (const auto& p: constants) {
@@ -42,18 +81,299 @@ std::shared_ptr<Material> MaterialManager::create_material(PipelineBuilder& pipe
         modules.emplace_back(std::make_tuple(Shader::get_shader_stage(it.first), it.second, third));
     }
 
-    std::shared_ptr<ShaderEffect> effect = pipelineBuilder.build_effect(setLayouts, pushConstants, modules);
-    std::shared_ptr<ShaderPass> pass = pipelineBuilder.build_pass(effect);
+    const std::string key = pipeline_key(pipelineBuilder, setLayouts, pushConstants, modules);
+    std::shared_ptr<ShaderPass> pass;
+    std::shared_future<std::shared_ptr<ShaderPass>> pending;
+    std::promise<std::shared_ptr<ShaderPass>> promise;
+    bool owner = false;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        auto it = _passes.find(key);
+        if (it != _passes.end()) {
+            pass = it->second.lock();
+            if (!pass) {
+                _passes.erase(it); // every name referring to it was replaced
+            }
+        }
+
+        if (!pass) {
+            auto inFlight = _pending.find(key);
+            if (inFlight != _pending.end()) {
+                pending = inFlight->second;
+            } else {
+                _pending[key] = promise.get_future().share();
+                owner = true;
+            }
+        }
+    }
+
+    // Same description being built by another thread
+    if (!pass && !owner) {
+        pass = pending.get();
+    }
+
+    if (owner) {
+        std::shared_ptr<ShaderEffect> effect = pipelineBuilder.build_effect(setLayouts, pushConstants, modules);
+        pass = pipelineBuilder.build_pass(effect);
+    }
+
+    // Descriptions differing only by dynamic rasterization state share the pipeline, the variant keeps its own state
+    std::shared_ptr<ShaderPass> material = pass;
+    DynamicRasterState rasterState;
+    if (pass->dynamicRaster && pipelineBuilder.raster_state(rasterState) && !(rasterState == pass->rasterState)) {
+        material = std::make_shared<ShaderPass>();
+        material->pipelineLayout = pass->pipelineLayout;
+        material->pipeline = pass->pipeline;
+        material->effect = pass->effect;
+        material->_device = pass->_device;
+        material->dynamicRaster = true;
+        material->rasterState = rasterState;
+        material->sharedPass = pass;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (owner) {
+            for (auto it = _passes.begin(); it != _passes.end();) { // passes released since the last build
+                it = it->second.expired() ? _passes.erase(it) : std::next(it);
+            }
+            _passes[key] = pass;
+            _pending.erase(key);
+            promise.set_value(pass);
+        }
+
+        // Obsolete material might still be used by in-flight command buffers: destroyed once current frame completed
+        if (this->_entities.count(name) != 0 && this->get_entity(name) != material) {
+            g_deletionQueue.retire(this->get_entity(name));
+        }
 
-    if (this->_entities.count(name) != 0) {
-        this->_discarded.emplace(name, std::move(this->get_entity(name)));
+        this->add_entity(name, material);
     }
 
-    this->add_entity(name, pass);
+    return material;
+}
 
-    for (auto& shader : effect->shaderStages) {
-        vkDestroyShaderModule(_device->_logicalDevice, shader.shaderModule, nullptr);
+/**
+ * Arguments are copied : shader paths and specialization data may be released by the caller once submitted.
+ * The pipeline builder is referenced and must outlive the returned future.
+ * @brief queue material creation on the job system
+ * @param pipelineBuilder pipeline builder holding the fixed-function state
+ * @param name material name
+ * @param setLayouts collection of descriptor set layouts
+ * @param constants push constants, in order
+ * @param shaders shader stages and SPIR-V file paths
+ * @param shaderSpecialization specialization constants per shader stage
+ * @return material, available once compiled
+ */
+MaterialManager::MaterialFuture MaterialManager::create_material_async(PipelineBuilder& pipelineBuilder, std::string name, std::vector<VkDescriptorSetLayout> setLayouts, std::vector<PushConstant> constants, std::vector<std::pair<ShaderType, const char*>> shaders, std::unordered_map<ShaderType, VkSpecializationInfo> shaderSpecialization) {
+    auto request = std::make_shared<MaterialRequest>();
+    request->pipelineBuilder = &pipelineBuilder;
+    request->name = std::move(name);
+    request->setLayouts = std::move(setLayouts);
+    request->constants = std::move(constants);
+    for (const auto& [type, path] : shaders) {
+        request->shaders.emplace_back(type, path);
     }
 
-    return pass;
-}
\ No newline at end of file
+    for (const auto& [type, info] : shaderSpecialization) {
+        auto& [entries, data] = request->specializationData[type];
+        entries.assign(info.pMapEntries, info.pMapEntries + info.mapEntryCount);
+        data.assign(static_cast<const char*>(info.pData), static_cast<const char*>(info.pData) + info.dataSize);
+
+        VkSpecializationInfo copy = info;
+        copy.pMapEntries = entries.data();
+        copy.pData = data.data();
+        request->shaderSpecialization[type] = copy;
+    }
+
+    MaterialFuture future = request->promise.get_future().share();
+    _inFlight++;
+    _requests.push_back(request);
+    JobManager::execute([this]() { compile_next(); });
+
+    return future;
+}
+
+/**
+ * The calling thread compiles pending requests while waiting, so a job thread can wait for its own batch.
+ * @brief wait for materials queued with create_material_async
+ * @param materials futures to wait for
+ */
+void MaterialManager::wait(const std::vector<MaterialFuture>& materials) {
+    for (const auto& material : materials) {
+        while (material.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!compile_next()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+/**
+ * The variant is queued on the job system once, later requests return the same future.
+ * Materials created with their own specialization constants have no variant : the material itself is returned.
+ * @brief queue the compilation of a shader variant of a material
+ * @param pipelineBuilder pipeline builder holding the fixed-function state of the material, must outlive the future
+ * @param material material created without specialization
+ * @param variant engine features specialized into the shaders
+ * @return specialized material, available once compiled
+ */
+MaterialManager::MaterialFuture MaterialManager::prepare_variant(PipelineBuilder& pipelineBuilder, const std::shared_ptr<Material>& material, const ShaderVariant& variant) {
+    if (!material->variants) {
+        std::promise<std::shared_ptr<Material>> ready;
+        ready.set_value(material);
+        return ready.get_future().share();
+    }
+
+    MaterialVariants& variants = *material->variants;
+    const uint64_t key = variant.key();
+    std::scoped_lock<std::mutex> lock(variants.mutex);
+    auto it = variants.materials.find(key);
+    if (it != variants.materials.end()) {
+        return it->second.future;
+    }
+
+    const VkSpecializationInfo specialization = variant.specialization(); // copied by the request
+    std::vector<std::pair<ShaderType, const char*>> shaders;
+    std::unordered_map<ShaderType, VkSpecializationInfo> shaderSpecialization;
+    for (const auto& [type, path] : variants.shaders) {
+        shaders.emplace_back(type, path.c_str());
+        shaderSpecialization[type] = specialization;
+    }
+
+    MaterialFuture future = create_material_async(pipelineBuilder, variants.name + "#" + std::to_string(key), variants.setLayouts, variants.constants, shaders, shaderSpecialization);
+    variants.materials.emplace(key, MaterialVariants::Variant{variant, future});
+
+    return future;
+}
+
+/**
+ * The pipeline builders referenced by the requests can be released once it returns.
+ * @brief compile every queued request and wait for the ones compiled by other threads
+ */
+void MaterialManager::wait_all() {
+    while (_inFlight > 0) {
+        if (!compile_next()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * Never compiles while a variant was already selected for the material : the variant is queued if needed and the
+ * previous one is returned until it is compiled. The first selection of a material waits for its variant.
+ * Materials created with their own specialization constants have no variant : the material itself is returned.
+ * @brief select the shader variant of a material
+ * @param pipelineBuilder pipeline builder holding the fixed-function state of the material, must outlive the compilation
+ * @param material material created without specialization
+ * @param variant engine features specialized into the shaders
+ * @return specialized material, or the previous variant while it is compiled
+ */
+std::shared_ptr<Material> MaterialManager::get_variant(PipelineBuilder& pipelineBuilder, const std::shared_ptr<Material>& material, const ShaderVariant& variant) {
+    if (!material->variants) {
+        return material;
+    }
+
+    MaterialVariants& variants = *material->variants;
+    MaterialFuture future = prepare_variant(pipelineBuilder, material, variant);
+    if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        std::scoped_lock<std::mutex> lock(variants.mutex);
+        if (variants.current) {
+            return variants.current;
+        }
+    }
+
+    // Nothing to draw yet : the calling thread compiles
+    wait({future});
+    std::shared_ptr<Material> selected;
+    try {
+        selected = future.get();
+    } catch (...) {
+        std::scoped_lock<std::mutex> lock(variants.mutex);
+        variants.materials.erase(variant.key()); // requested again on next selection
+        throw;
+    }
+
+    std::scoped_lock<std::mutex> lock(variants.mutex);
+    variants.current = selected;
+    return selected;
+}
+
+/**
+ * Shader modules are reflected when loaded, the check does not compile anything.
+ * @brief tell if a shader declares specialization constants of the engine feature variants
+ * @param shaders shader stages and SPIR-V file paths
+ * @return true if the material is an uber-shader specialized per variant
+ */
+bool MaterialManager::declares_variant(const std::vector<std::pair<ShaderType, const char*>>& shaders) const {
+    for (const auto& [type, path] : shaders) {
+        const ShaderReflection* reflection = _device->_shaderModuleCache->reflection(_device->_shaderModuleCache->get_module(path));
+        if (reflection == nullptr) {
+            continue;
+        }
+        for (uint32_t id : reflection->_specializationIds) {
+            const bool variantId = std::any_of(ShaderVariant::mapEntries.begin(), ShaderVariant::mapEntries.end(), [id](const VkSpecializationMapEntry& entry) { return entry.constantID == id; });
+            if (variantId) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief compile the oldest pending request
+ * @return false if no request was pending
+ */
+bool MaterialManager::compile_next() {
+    std::shared_ptr<MaterialRequest> request;
+    if (!_requests.pop_front(request)) {
+        return false;
+    }
+
+    std::vector<std::pair<ShaderType, const char*>> shaders;
+    shaders.reserve(request->shaders.size());
+    for (const auto& [type, path] : request->shaders) {
+        shaders.emplace_back(type, path.c_str());
+    }
+
+    try {
+        request->promise.set_value(create_material(*request->pipelineBuilder, request->name, request->setLayouts, request->constants, shaders, request->shaderSpecialization));
+    } catch (...) {
+        request->promise.set_exception(std::current_exception());
+    }
+    _inFlight--;
+
+    return true;
+}
+
+/**
+ * @brief pipeline description key
+ * @param pipelineBuilder pipeline builder holding the fixed-function state
+ * @param setLayouts collection of descriptor set layouts
+ * @param pushConstants push constant ranges
+ * @param modules shader stages, file paths and specialization constants
+ * @return pipeline description as a byte string
+ */
+std::string MaterialManager::pipeline_key(const PipelineBuilder& pipelineBuilder, const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants, const std::vector<std::tuple<VkShaderStageFlagBits, const char*, VkSpecializationInfo>>& modules) {
+    std::string key = pipelineBuilder.state_key();
+
+    for (auto setLayout : setLayouts) {
+        helper::append_key(key, setLayout);
+    }
+    for (const auto& range : pushConstants) {
+        helper::append_key(key, range);
+    }
+    for (const auto& [stage, path, specialization] : modules) {
+        helper::append_key(key, stage);
+        key.append(path).push_back('\0');
+        for (uint32_t i = 0; i < specialization.mapEntryCount; i++) {
+            helper::append_key(key, specialization.pMapEntries[i]);
+        }
+        if (specialization.dataSize > 0) {
+            key.append(static_cast<const char*>(specialization.pData), specialization.dataSize);
+        }
+    }
+
+    return key;
+}
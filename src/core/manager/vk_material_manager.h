@@ -11,15 +11,56 @@
 #include <vector>
 #include <iostream>
 #include <unordered_map>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <atomic>
 
 #include "core/manager/vk_system_manager.h"
 #include "core/vk_shaders.h"
+#include "core/manager/vk_job_manager.h"
 
 class Device;
 class PipelineBuilder;
 
+/**
+ * @brief material description kept to build its shader variants, and the variants built so far
+ */
+struct MaterialVariants {
+    std::string name;
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<PushConstant> constants;
+    std::vector<std::pair<ShaderType, std::string>> shaders;
+    /** @brief guards the variants */
+    std::mutex mutex;
+    /** @brief specialization data and material being built, nodes keep the data address stable */
+    struct Variant {
+        ShaderVariant variant;
+        std::shared_future<std::shared_ptr<Material>> future;
+    };
+    /** @brief variants requested so far, by variant key */
+    std::unordered_map<uint64_t, Variant> materials;
+    /** @brief last variant selected, drawn while the requested one is compiled */
+    std::shared_ptr<Material> current;
+};
+
+/**
+ * Materials are shader passes registered by name. Passes are deduplicated by their full pipeline description
+ * (fixed-function state, set layouts, push constants, shaders and specialization data) : names requesting the
+ * same description are aliases of a single pass. With extended dynamic state, descriptions differing only by
+ * rasterization and depth state are variants sharing the pipeline of a single pass.
+ * Materials can be compiled in batch on the job system : each request returns a future, the requesting thread
+ * compiles pending requests itself while waiting. Identical descriptions compiled concurrently are built once.
+ * Materials created without specialization whose shaders declare the constants of ShaderVariant are uber-shaders :
+ * their own pipeline is never compiled, variants specialized by engine features are compiled
+ * on the job system when prepared (scene load, feature toggle) and cached with the material. Until a variant is
+ * compiled, the variant selected previously is drawn.
+ * @brief material manager
+ */
 class MaterialManager : public System {
 public:
+    typedef std::shared_future<std::shared_ptr<Material>> MaterialFuture;
+
     MaterialManager(const Device* _device);
     ~MaterialManager();
     MaterialManager(const MaterialManager&) = delete;
@@ -29,9 +70,40 @@ public:
 
     std::shared_ptr<Material> get_material(const std::string &name);
     std::shared_ptr<Material> create_material(PipelineBuilder& pipelineBuilder, std::string name, std::vector<VkDescriptorSetLayout> setLayouts, std::vector<PushConstant> constants, std::vector<std::pair<ShaderType, const char*>> shaders, std::unordered_map<ShaderType, VkSpecializationInfo> shaderSpecialization = {});
+    MaterialFuture create_material_async(PipelineBuilder& pipelineBuilder, std::string name, std::vector<VkDescriptorSetLayout> setLayouts, std::vector<PushConstant> constants, std::vector<std::pair<ShaderType, const char*>> shaders, std::unordered_map<ShaderType, VkSpecializationInfo> shaderSpecialization = {});
+    void wait(const std::vector<MaterialFuture>& materials);
+    MaterialFuture prepare_variant(PipelineBuilder& pipelineBuilder, const std::shared_ptr<Material>& material, const ShaderVariant& variant);
+    void wait_all();
+    std::shared_ptr<Material> get_variant(PipelineBuilder& pipelineBuilder, const std::shared_ptr<Material>& material, const ShaderVariant& variant);
 
 private:
     const class Device* _device;
-    /** @brief Maintain obsolete materials until command buffer stop running */
-    std::unordered_map<std::string, std::shared_ptr<Entity>> _discarded;
+    /** @brief guards the pass cache */
+    std::mutex _mutex;
+    /** @brief built passes by pipeline description, alive as long as a name refers to them. Expired entries are erased on lookup and on insertion */
+    std::unordered_map<std::string, std::weak_ptr<ShaderPass>> _passes;
+    /** @brief passes being built by another thread */
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<ShaderPass>>> _pending;
+
+    /** @brief material creation request, owns copies of the caller data */
+    struct MaterialRequest {
+        PipelineBuilder* pipelineBuilder;
+        std::string name;
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        std::vector<PushConstant> constants;
+        std::vector<std::pair<ShaderType, std::string>> shaders;
+        std::unordered_map<ShaderType, VkSpecializationInfo> shaderSpecialization;
+        std::unordered_map<ShaderType, std::pair<std::vector<VkSpecializationMapEntry>, std::vector<char>>> specializationData;
+        std::promise<std::shared_ptr<Material>> promise;
+    };
+
+    /** @brief requests waiting for a thread */
+    ThreadSafeQueue<std::shared_ptr<MaterialRequest>> _requests;
+    /** @brief requests queued or being compiled */
+    std::atomic<uint32_t> _inFlight {0};
+
+    bool compile_next();
+    bool declares_variant(const std::vector<std::pair<ShaderType, const char*>>& shaders) const;
+
+    static std::string pipeline_key(const PipelineBuilder& pipelineBuilder, const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants, const std::vector<std::tuple<VkShaderStageFlagBits, const char*, VkSpecializationInfo>>& modules);
 };
\ No newline at end of file
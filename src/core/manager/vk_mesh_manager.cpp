@@ -26,6 +26,8 @@ MeshManager::~MeshManager() {
 }
 
 void MeshManager::upload_mesh(Model& mesh) {
+    mesh.compute_bounds(); // CPU side geometry is complete : bound primitives for culling
+
     size_t vertexBufferSize = mesh._verticesBuffer.size() * sizeof(Vertex);
     size_t indexBufferSize = mesh._indexesBuffer.size() * sizeof(uint32_t);
     mesh._indexBuffer.count = static_cast<uint32_t>(mesh._indexesBuffer.size());
@@ -46,18 +48,26 @@ void MeshManager::upload_mesh(Model& mesh) {
 
     Buffer::create_buffer(*_device, &mesh._indexBuffer.allocation, indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 
-    CommandBuffer::immediate_submit(*_device, *_uploadContext, [&](VkCommandBuffer cmd) {      
+    VkBufferMemoryBarrier vertexBarrier = {};
+    vertexBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    vertexBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vertexBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vertexBarrier.buffer = mesh._vertexBuffer._buffer;
+    vertexBarrier.offset = 0;
+    vertexBarrier.size = VK_WHOLE_SIZE;
+
+    VkBufferMemoryBarrier indexBarrier = vertexBarrier;
+    indexBarrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+    indexBarrier.buffer = mesh._indexBuffer.allocation._buffer;
+
+    // Both copies share a single submission on the transfer queue, ownership is then acquired by the graphics queue.
+    CommandBuffer::transfer_submit(*_device, *_uploadContext, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, {vertexBarrier, indexBarrier}, {}, [&](VkCommandBuffer cmd) {
         VkBufferCopy copy;
         copy.dstOffset = 0;
         copy.srcOffset = 0;
         copy.size = vertexBufferSize;
         vkCmdCopyBuffer(cmd, vertexStaging._buffer, mesh._vertexBuffer._buffer, 1, &copy);
-    });
 
-    CommandBuffer::immediate_submit(*_device, *_uploadContext, [&](VkCommandBuffer cmd) {
-        VkBufferCopy copy;
-        copy.dstOffset = 0;
-        copy.srcOffset = 0;
         copy.size = indexBufferSize;
         vkCmdCopyBuffer(cmd, indexStaging._buffer, mesh._indexBuffer.allocation._buffer, 1, &copy);
     });
@@ -68,4 +78,21 @@ void MeshManager::upload_mesh(Model& mesh) {
 
 std::shared_ptr<Model> MeshManager::get_model(const std::string &name) {
     return std::static_pointer_cast<Model>(this->get_entity(name));
+}
+
+/**
+ * Procedural meshes built with the same parameters are shared : objects drawing them become instances of one mesh.
+ * @brief get a mesh by key, create and upload it if missing
+ * @param key mesh name, built from the mesh parameters (see ModelPOLY::key)
+ * @param create mesh factory
+ * @return shared mesh
+ */
+std::shared_ptr<Model> MeshManager::get_or_create_model(const std::string &key, const std::function<std::shared_ptr<Model>()>& create) {
+    std::shared_ptr<Model> model = get_model(key);
+    if (model == nullptr) {
+        model = create();
+        upload_mesh(*model);
+        add_entity(key, std::static_pointer_cast<Entity>(model));
+    }
+    return model;
 }
\ No newline at end of file
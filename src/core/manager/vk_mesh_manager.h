@@ -11,6 +11,7 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <functional>
 
 #include "VkBootstrap.h"
 #include "core/manager/vk_system_manager.h"
@@ -30,6 +31,7 @@ public:
 
     void upload_mesh(Model& mesh);
     std::shared_ptr<Model> get_model(const std::string &name);
+    std::shared_ptr<Model> get_or_create_model(const std::string &key, const std::function<std::shared_ptr<Model>()>& create);
 
 private:
     const class Device* _device;
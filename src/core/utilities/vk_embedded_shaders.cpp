@@ -0,0 +1,42 @@
+/*
+*  H2Vk - Embedded shaders
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_embedded_shaders.h"
+
+#include <string_view>
+
+#ifdef H2VK_EMBED_SHADERS
+// Generated by the shaders target : SPIR-V arrays and the embeddedShaders table
+#include "embedded_shaders.inc"
+#endif
+
+/**
+ * Paths are matched from the shaders folder, so "../src/shaders/pbr/pbr_ibl.vert.spv" finds "pbr/pbr_ibl.vert.spv".
+ * @brief find an embedded shader
+ * @param filePath path to file containing shader code
+ * @return embedded shader, nullptr if the shader is not embedded
+ */
+const EmbeddedShader* EmbeddedShaders::find(const char* filePath) {
+#ifdef H2VK_EMBED_SHADERS
+    constexpr std::string_view folder = "shaders/";
+    std::string_view path(filePath);
+    const size_t pos = path.rfind(folder);
+    if (pos == std::string_view::npos) {
+        return nullptr;
+    }
+    path.remove_prefix(pos + folder.size());
+
+    for (const EmbeddedShader& shader : embeddedShaders) {
+        if (path == shader.path) {
+            return &shader;
+        }
+    }
+#endif
+
+    return nullptr;
+}
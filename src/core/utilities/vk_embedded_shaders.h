@@ -0,0 +1,31 @@
+/*
+*  H2Vk - Embedded shaders
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief SPIR-V compiled into the executable
+ */
+struct EmbeddedShader {
+    /** @brief path relative to the shaders folder (ie. pbr/pbr_ibl.vert.spv) */
+    const char* path;
+    const uint32_t* code;
+    size_t wordCount;
+};
+
+/**
+ * Shaders are embedded when the engine is built with H2VK_EMBED_SHADERS : the shaders target generates
+ * a SPIR-V array per shader and the table of embedded shaders.
+ * @brief embedded shaders lookup
+ */
+namespace EmbeddedShaders {
+    const EmbeddedShader* find(const char* filePath);
+}
@@ -15,7 +15,78 @@
 #include "core/vk_command_buffer.h"
 #include "core/vk_buffer.h"
 
+#include <mutex>
+#include <algorithm>
+
 constexpr uint32_t FRAME_OVERLAP = 2;
 constexpr uint32_t MAX_OBJECTS = 10000;
+constexpr uint32_t MAX_DRAWS = 65536;
+constexpr uint32_t INSTANCE_PASSES = 5; // frame instance buffer slices of MAX_DRAWS slots : scene, then each shadow cascade
+constexpr uint32_t MAX_DRAW_BATCHES = 1024;
+
+inline FrameData g_frames[FRAME_OVERLAP];
+
+/**
+ * Resources retired while frame N is the current frame are destroyed once frame N fence has been signaled,
+ * ie. when its frame slot is reused FRAME_OVERLAP frames later. Avoid waiting the queue to be idle before
+ * destroying pipelines, buffers, textures or descriptor pools still referenced by in-flight command buffers.
+ * @brief per-frame deferred deletion queue
+ * @note thread-safe: resources can be retired from job threads (ex. scene loading)
+ */
+struct FrameDeletionQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> deletors[FRAME_OVERLAP];
+    /** @brief frame slot currently recorded */
+    uint32_t frameIndex = 0;
+
+    void push_function(std::function<void()>&& function) {
+        std::scoped_lock<std::mutex> lock(mutex);
+        deletors[frameIndex].push_back(function);
+    }
+
+    /**
+     * @brief keep resource alive until current frame completed. Released by the last owner.
+     */
+    template<typename T>
+    void retire(std::shared_ptr<T> resource) {
+        if (resource) {
+            push_function([resource]() mutable { resource.reset(); });
+        }
+    }
+
+    /**
+     * Destroy resources retired by the frame slot. Must be called after frame fence has been signaled.
+     * @param index frame slot becoming the current frame
+     */
+    void flush(uint32_t index) {
+        std::deque<std::function<void()>> expired;
+        {
+            std::scoped_lock<std::mutex> lock(mutex);
+            expired.swap(deletors[index]);
+            frameIndex = index;
+        }
+
+        // reverse iterate the deletion queue to execute all the functions
+        for (auto it = expired.rbegin(); it != expired.rend(); it++) {
+            (*it)();
+        }
+    }
+
+    /**
+     * Destroying a resource can retire others (ie. bindless slots of a released model) : flushed until empty.
+     * @brief destroy all retired resources. Device must be idle.
+     */
+    void flush_all() {
+        bool empty = false;
+        while (!empty) {
+            for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
+                flush((frameIndex + 1 + i) % FRAME_OVERLAP);
+            }
+
+            std::scoped_lock<std::mutex> lock(mutex);
+            empty = std::all_of(std::begin(deletors), std::end(deletors), [](const auto& deletor) { return deletor.empty(); });
+        }
+    }
+};
 
-inline FrameData g_frames[FRAME_OVERLAP];
\ No newline at end of file
+inline FrameDeletionQueue g_deletionQueue;
\ No newline at end of file
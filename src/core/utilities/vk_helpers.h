@@ -12,6 +12,8 @@
 #include <fstream>
 #include <vector>
 #include <cstdint>
+#include <functional>
+#include <string>
 
 #define VK_CHECK(x) \
     do \
@@ -28,4 +30,24 @@ class Device;
 namespace helper {
     std::vector<uint32_t> read_file(const char* filePath);
     size_t pad_uniform_buffer_size(const Device& device, size_t originalSize);
+
+    /**
+     * @brief mix the hash of a value into a seed
+     * @param seed hash to combine with
+     * @param v value to hash
+     */
+    template<typename T>
+    inline void hash_combine(size_t& seed, const T& v) {
+        seed ^= std::hash<T>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    /**
+     * @brief append the raw bytes of a trivial value to a key
+     * @param key byte string
+     * @param v value to append
+     */
+    template<typename T>
+    inline void append_key(std::string& key, const T& v) {
+        key.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
 }
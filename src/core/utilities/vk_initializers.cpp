@@ -275,6 +275,24 @@ VkCommandBufferBeginInfo vkinit::command_buffer_begin_info(VkCommandBufferUsageF
     return info;
 }
 
+/**
+ * Render pass state continued by a secondary command buffer. The framebuffer is optional.
+ * @brief Initialize command buffer inheritance info
+ * @param renderPass render pass the secondary command buffer is executed in
+ * @param subpass subpass index
+ * @param frameBuffer framebuffer, VK_NULL_HANDLE if unknown
+ * @return inheritance specification
+ */
+VkCommandBufferInheritanceInfo vkinit::command_buffer_inheritance_info(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer frameBuffer) {
+    VkCommandBufferInheritanceInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    info.pNext = nullptr;
+    info.renderPass = renderPass;
+    info.subpass = subpass;
+    info.framebuffer = frameBuffer;
+    return info;
+}
+
 /**
  * Specify queue submit operation informations.
  * Number of semaphores upon which to wait or to signal before executing the command buffer,
@@ -28,6 +28,7 @@ namespace vkinit {
     VkDescriptorSetLayoutBinding descriptor_set_layout_binding(VkDescriptorType type, VkShaderStageFlags flags, uint32_t binding);
     VkWriteDescriptorSet write_descriptor_set(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo* binfo, uint32_t binding);
     VkCommandBufferBeginInfo command_buffer_begin_info(VkCommandBufferUsageFlags flags = 0);
+    VkCommandBufferInheritanceInfo command_buffer_inheritance_info(VkRenderPass renderPass, uint32_t subpass = 0, VkFramebuffer frameBuffer = VK_NULL_HANDLE);
     VkSubmitInfo submit_info(VkCommandBuffer* cmd);
     VkSamplerCreateInfo sampler_create_info(VkFilter filters, VkSamplerAddressMode samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
     VkWriteDescriptorSet write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo* imageInfo, uint32_t binding);
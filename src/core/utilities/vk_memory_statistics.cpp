@@ -0,0 +1,180 @@
+/*
+*  H2Vk - Memory statistics
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_memory_statistics.h"
+#include "core/vk_device.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+std::mutex MemoryStatistics::_mutex;
+std::unordered_map<VmaAllocation, std::pair<MemoryCategory, VkDeviceSize>> MemoryStatistics::_allocations;
+std::array<std::atomic<int64_t>, static_cast<size_t>(ObjectCategory::COUNT)> MemoryStatistics::_objects {};
+
+const char* MemoryStatistics::category_names[] = {"meshes", "textures", "ibl", "shadows", "staging", "uniforms", "other"};
+const char* MemoryStatistics::object_names[] = {"pipelines", "descriptor_pools", "samplers"};
+
+/**
+ * Attribute an allocation to an engine category
+ * @param allocator memory allocator which created the allocation
+ * @param allocation allocation to attribute
+ * @param category engine category
+ */
+void MemoryStatistics::track(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category) {
+    if (allocation == nullptr) {
+        return;
+    }
+
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _allocations[allocation] = std::make_pair(category, info.size);
+}
+
+/**
+ * Remove allocation from attribution. Must be called before allocation is freed (handle might be reused).
+ * @param allocation allocation about to be freed
+ */
+void MemoryStatistics::untrack(VmaAllocation allocation) {
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _allocations.erase(allocation);
+}
+
+void MemoryStatistics::created(ObjectCategory object, int64_t count) {
+    _objects[static_cast<size_t>(object)] += count;
+}
+
+void MemoryStatistics::destroyed(ObjectCategory object, int64_t count) {
+    _objects[static_cast<size_t>(object)] -= count;
+}
+
+/**
+ * Gather heap budgets, allocator statistics, category attribution and live objects.
+ * @brief memory report
+ * @note vmaCalculateStatistics iterates over all blocks: not meant to be called on every frame of a release build
+ * @param device vulkan device wrapper
+ * @return memory report
+ */
+MemoryStatistics::Report MemoryStatistics::report(const Device& device) {
+    Report report{};
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+    vmaGetMemoryProperties(device._allocator, &memoryProperties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(device._allocator, budgets);
+
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+        Heap heap{};
+        heap.index = i;
+        heap.deviceLocal = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        for (uint32_t t = 0; t < memoryProperties->memoryTypeCount; t++) {
+            const VkMemoryType& type = memoryProperties->memoryTypes[t];
+            if (type.heapIndex == i && (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+                heap.hostVisible = true;
+            }
+        }
+        heap.usage = budgets[i].usage;
+        heap.budget = budgets[i].budget;
+        heap.blockBytes = budgets[i].statistics.blockBytes;
+        heap.allocationBytes = budgets[i].statistics.allocationBytes;
+        heap.blockCount = budgets[i].statistics.blockCount;
+        heap.allocationCount = budgets[i].statistics.allocationCount;
+        report.heaps.push_back(heap);
+    }
+
+    VmaTotalStatistics stats{};
+    vmaCalculateStatistics(device._allocator, &stats);
+    report.blockCount = stats.total.statistics.blockCount;
+    report.allocationCount = stats.total.statistics.allocationCount;
+    report.blockBytes = stats.total.statistics.blockBytes;
+    report.allocationBytes = stats.total.statistics.allocationBytes;
+    report.unusedRangeCount = stats.total.unusedRangeCount;
+
+    const VkDeviceSize unusedBytes = report.blockBytes - report.allocationBytes;
+    report.fragmentation = (unusedBytes > 0 && report.unusedRangeCount > 0) ?
+            1.0f - static_cast<float>(stats.total.unusedRangeSizeMax) / static_cast<float>(unusedBytes) : 0.0f;
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        for (const auto& it : _allocations) {
+            Category& category = report.categories[static_cast<size_t>(it.second.first)];
+            category.bytes += it.second.second;
+            category.count++;
+        }
+    }
+
+    for (size_t i = 0; i < report.objects.size(); i++) {
+        report.objects[i] = _objects[i].load();
+    }
+
+    return report;
+}
+
+/**
+ * @brief serialize memory report
+ * @param report memory report
+ * @return JSON string
+ */
+std::string MemoryStatistics::to_json(const Report& report) {
+    std::ostringstream out;
+    out << "{\n  \"heaps\": [\n";
+    for (size_t i = 0; i < report.heaps.size(); i++) {
+        const Heap& heap = report.heaps[i];
+        out << "    {\"index\": " << heap.index
+            << ", \"device_local\": " << (heap.deviceLocal ? "true" : "false")
+            << ", \"host_visible\": " << (heap.hostVisible ? "true" : "false")
+            << ", \"usage\": " << heap.usage
+            << ", \"budget\": " << heap.budget
+            << ", \"block_bytes\": " << heap.blockBytes
+            << ", \"allocation_bytes\": " << heap.allocationBytes
+            << ", \"block_count\": " << heap.blockCount
+            << ", \"allocation_count\": " << heap.allocationCount << "}"
+            << (i + 1 < report.heaps.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n  \"categories\": {\n";
+    for (size_t i = 0; i < report.categories.size(); i++) {
+        out << "    \"" << category_names[i] << "\": {\"bytes\": " << report.categories[i].bytes
+            << ", \"count\": " << report.categories[i].count << "}"
+            << (i + 1 < report.categories.size() ? ",\n" : "\n");
+    }
+    out << "  },\n  \"objects\": {\n";
+    for (size_t i = 0; i < report.objects.size(); i++) {
+        out << "    \"" << object_names[i] << "\": " << report.objects[i]
+            << (i + 1 < report.objects.size() ? ",\n" : "\n");
+    }
+    out << "  },\n"
+        << "  \"block_count\": " << report.blockCount << ",\n"
+        << "  \"allocation_count\": " << report.allocationCount << ",\n"
+        << "  \"block_bytes\": " << report.blockBytes << ",\n"
+        << "  \"allocation_bytes\": " << report.allocationBytes << ",\n"
+        << "  \"unused_range_count\": " << report.unusedRangeCount << ",\n"
+        << "  \"fragmentation\": " << report.fragmentation << "\n"
+        << "}\n";
+
+    return out.str();
+}
+
+/**
+ * Write memory report to a JSON file
+ * @param device vulkan device wrapper
+ * @param filePath output file
+ * @return true if file written
+ */
+bool MemoryStatistics::dump(const Device& device, const char* filePath) {
+    std::ofstream file(filePath, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write memory statistics " << filePath << std::endl;
+        return false;
+    }
+
+    file << to_json(report(device));
+    return true;
+}
@@ -0,0 +1,102 @@
+/*
+*  H2Vk - Memory statistics
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include "vk_mem_alloc.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Device;
+
+/** @brief Engine usage of an allocation */
+enum class MemoryCategory : uint32_t {
+    MESH = 0,
+    TEXTURE = 1,
+    IBL = 2,
+    SHADOW = 3,
+    STAGING = 4,
+    UNIFORM = 5,
+    OTHER = 6,
+    COUNT = 7,
+};
+
+/** @brief Vulkan objects without memory allocation, counted while alive */
+enum class ObjectCategory : uint32_t {
+    PIPELINE = 0,
+    DESCRIPTOR_POOL = 1,
+    SAMPLER = 2,
+    COUNT = 3,
+};
+
+/**
+ * Memory instrumentation built on top of VMA budget and statistics.
+ * Allocations are attributed to a category when created (buffers, images), objects are counted while alive.
+ * @brief GPU memory budget and allocation statistics
+ */
+class MemoryStatistics final {
+public:
+    /** @brief memory heap usage reported by VMA budget */
+    struct Heap {
+        uint32_t index;
+        bool deviceLocal;
+        bool hostVisible;
+        /** @brief estimated memory used by the process in the heap (bytes) */
+        VkDeviceSize usage;
+        /** @brief estimated memory available to the process (bytes) */
+        VkDeviceSize budget;
+        /** @brief memory allocated in VkDeviceMemory blocks (bytes) */
+        VkDeviceSize blockBytes;
+        /** @brief memory occupied by allocations (bytes) */
+        VkDeviceSize allocationBytes;
+        uint32_t blockCount;
+        uint32_t allocationCount;
+    };
+
+    /** @brief Allocations attributed to an engine category */
+    struct Category {
+        VkDeviceSize bytes = 0;
+        uint32_t count = 0;
+    };
+
+    struct Report {
+        std::vector<Heap> heaps;
+        std::array<Category, static_cast<size_t>(MemoryCategory::COUNT)> categories {};
+        std::array<int64_t, static_cast<size_t>(ObjectCategory::COUNT)> objects {};
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize allocationBytes = 0;
+        uint32_t unusedRangeCount = 0;
+        /** @brief 0 when free memory is contiguous, close to 1 when scattered in small ranges */
+        float fragmentation = 0.0f;
+    };
+
+    static const char* category_names[static_cast<size_t>(MemoryCategory::COUNT)];
+    static const char* object_names[static_cast<size_t>(ObjectCategory::COUNT)];
+
+    static void track(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category);
+    static void untrack(VmaAllocation allocation);
+    static void created(ObjectCategory object, int64_t count = 1);
+    static void destroyed(ObjectCategory object, int64_t count = 1);
+
+    static Report report(const Device& device);
+    static std::string to_json(const Report& report);
+    static bool dump(const Device& device, const char* filePath);
+
+private:
+    static std::mutex _mutex;
+    /** @brief live allocations : category and size */
+    static std::unordered_map<VmaAllocation, std::pair<MemoryCategory, VkDeviceSize>> _allocations;
+    static std::array<std::atomic<int64_t>, static_cast<size_t>(ObjectCategory::COUNT)> _objects;
+};
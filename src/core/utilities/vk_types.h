@@ -11,6 +11,7 @@
 #include "glm/glm.hpp"
 #include "core/vk_shaders.h"
 #include "core/vk_buffer.h"
+#include "core/vk_frame_allocator.h"
 #include "core/vk_query_pool.h"
 
 #include <deque>
@@ -30,14 +31,53 @@ struct GPUEnabledFeaturesData{
     alignas(bool) bool atmosphere;
 };
 
+/** @brief object entry of the object buffer (std140) */
 struct GPUObjectData {
+    static constexpr uint32_t NO_MATERIAL = 0xFFFFFFFF;
+
     glm::mat4 model;
+    /** @brief bindless material slot overriding the primitive materials, NO_MATERIAL if none */
+    uint32_t materialIndex = NO_MATERIAL;
+    uint32_t padding[3];
+};
+
+/** @brief material entry of the bindless material buffer (std430) */
+struct GPUMaterialData {
+    glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    float alphaCutoff = 1.0f;
+    /** @brief slot indices in the bindless texture array */
+    uint32_t baseColorTexture = 0;
+    uint32_t normalTexture = 0;
+    uint32_t metallicRoughnessTexture = 0;
+    uint32_t aoTexture = 0;
+    uint32_t emissiveTexture = 0;
+};
+
+/** @brief primitive drawn by the GPU-driven path, culled by the compute shader (std430) */
+struct GPUDrawData {
+    /** @brief object transformation times node transformation */
+    glm::mat4 model;
+    /** @brief world space bounding sphere : center, radius */
+    glm::vec4 boundingSphere;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    /** @brief slot in the bindless material buffer */
+    uint32_t materialIndex;
+    /** @brief draw count slot of the batch */
+    uint32_t batch;
+    /** @brief first indirect command of the batch */
+    uint32_t commandOffset;
+    uint32_t padding[3];
 };
 
 struct RenderObject {
     std::shared_ptr<Model> model;
     std::shared_ptr<Material> material;
     glm::mat4 transformMatrix;
+    /** @brief model material (index in Model::_materials) overriding the primitive materials, -1 if none */
+    int32_t materialIndex = -1;
 };
 
 typedef std::vector<RenderObject> Renderables;
@@ -57,12 +97,26 @@ struct FrameData {
     AllocatedBuffer enabledFeaturesBuffer;
 
     AllocatedBuffer cameraBuffer;
-    AllocatedBuffer lightingBuffer;
     VkDescriptorSet environmentDescriptor;
 
+    /** @brief per-frame uniform arena. Lighting and cascades slices bound with environment dynamic offsets */
+    FrameAllocator uniformArena;
+    uint32_t lightingOffset = 0;
+    uint32_t cascadedOffset = 0;
+
     AllocatedBuffer objectBuffer;
+    /** @brief scene version the object buffers were written for, rewritten once the frame is no longer in flight */
+    uint32_t sceneVersion = 0;
+    /** @brief object index of each instance of the render queue draws */
+    AllocatedBuffer instanceBuffer;
     VkDescriptorSet objectDescriptor;
 
+    /** @brief GPU-driven path : primitives, culled indirect commands and draw count per batch */
+    AllocatedBuffer drawBuffer;
+    AllocatedBuffer indirectBuffer;
+    AllocatedBuffer countBuffer;
+    VkDescriptorSet cullingDescriptor;
+
     AllocatedBuffer offscreenBuffer;
     VkDescriptorSet offscreenDescriptor;
 
@@ -72,6 +126,9 @@ struct FrameData {
     VkDescriptorSet debugDescriptor;
 
     VkDescriptorSet atmosphereDescriptor;
+
+    /** @brief bindless material buffer and texture array, shared by all frames */
+    VkDescriptorSet materialDescriptor;
 };
 
 /**
@@ -0,0 +1,318 @@
+/*
+*  H2Vk - BindlessTable class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_bindless_table.h"
+#include "core/vk_device.h"
+#include "core/vk_pipeline_layout_cache.h"
+#include "core/utilities/vk_global.h"
+#include "core/utilities/vk_memory_statistics.h"
+#include "core/utilities/vk_helpers.h"
+
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * Create descriptor layout, pool and set holding the material buffer and the texture array.
+ * Texture array size is limited by the device update-after-bind limits.
+ * @brief default constructor
+ * @param device vulkan device wrapper
+ * @param uploadContext upload context used to load the default texture
+ */
+BindlessTable::BindlessTable(const Device& device, const UploadContext& uploadContext) : _device(device) {
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(_device._physicalDevice, &properties2);
+    _textureCapacity = std::min({MAX_TEXTURES, properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages});
+
+    // === Layout ===
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount = _textureCapacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Texture slots are written while the set is bound by in-flight frames. Unused slots stay unwritten.
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags = {
+            0,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    flagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &flagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(_device._logicalDevice, &layoutInfo, nullptr, &_setLayout));
+
+    // === Pool and set ===
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _textureCapacity}
+    }};
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    VK_CHECK(vkCreateDescriptorPool(_device._logicalDevice, &poolInfo, nullptr, &_pool));
+    MemoryStatistics::created(ObjectCategory::DESCRIPTOR_POOL);
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+    countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    countInfo.descriptorSetCount = 1;
+    countInfo.pDescriptorCounts = &_textureCapacity;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = &countInfo;
+    allocInfo.descriptorPool = _pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_setLayout;
+    VK_CHECK(vkAllocateDescriptorSets(_device._logicalDevice, &allocInfo, &_descriptorSet));
+
+    _textureRefs.resize(_textureCapacity, 0);
+    _textureKeys.resize(_textureCapacity);
+    _materialRefs.resize(MAX_MATERIALS, 0);
+    _materialKeys.resize(MAX_MATERIALS);
+
+    // === Material buffer ===
+    Buffer::create_buffer(_device, &_materialBuffer, sizeof(GPUMaterialData) * MAX_MATERIALS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = _materialBuffer._buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(_device._logicalDevice, 1, &write, 0, nullptr);
+
+    // === Default slot ===
+    unsigned char pixels[] = {255, 255, 255, 255};
+    _defaultTexture.load_image_from_buffer(_device, uploadContext, pixels, 4, VK_FORMAT_R8G8B8A8_UNORM, 1, 1);
+    _defaultTexture._name = "Empty";
+    _defaultTexture._uri = "Unknown";
+    register_texture(_defaultTexture._descriptor);
+    register_material(GPUMaterialData{});
+}
+
+/**
+ * @brief default destructor
+ * Device must be idle.
+ */
+BindlessTable::~BindlessTable() {
+    _defaultTexture.destroy(_device);
+    _materialBuffer.destroy();
+
+    vkDestroyDescriptorPool(_device._logicalDevice, _pool, nullptr);
+    MemoryStatistics::destroyed(ObjectCategory::DESCRIPTOR_POOL);
+    _device._pipelineLayoutCache->evict(_setLayout);
+    vkDestroyDescriptorSetLayout(_device._logicalDevice, _setLayout, nullptr);
+}
+
+/**
+ * Write the texture descriptor into a free slot of the texture array.
+ * A texture already registered (same sampler, view and layout) shares its slot.
+ * @brief register a texture
+ * @param imageInfo texture descriptor (sampler, view, layout)
+ * @return texture slot index
+ */
+uint32_t BindlessTable::register_texture(const VkDescriptorImageInfo& imageInfo) {
+    std::scoped_lock<std::mutex> lock(_mutex);
+    const TextureKey key{imageInfo.sampler, imageInfo.imageView, imageInfo.imageLayout};
+    auto it = _textureSlots.find(key);
+    if (it != _textureSlots.end()) {
+        _textureRefs[it->second]++;
+        return it->second;
+    }
+
+    uint32_t index = acquire_slot(_freeTextures, _textureCount, _textureCapacity);
+    _textureSlots.emplace(key, index);
+    _textureKeys[index] = key;
+    _textureRefs[index] = 1;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _descriptorSet;
+    write.dstBinding = 1;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(_device._logicalDevice, 1, &write, 0, nullptr);
+
+    return index;
+}
+
+/**
+ * Copy material into a free slot of the material buffer. Slots in use by in-flight frames are never overwritten.
+ * A material already registered with the same content shares its slot.
+ * @brief register a material
+ * @param material material factors and texture slot indices
+ * @return material slot index
+ */
+uint32_t BindlessTable::register_material(const GPUMaterialData& material) {
+    std::scoped_lock<std::mutex> lock(_mutex);
+    auto it = _materialSlots.find(material);
+    if (it != _materialSlots.end()) {
+        _materialRefs[it->second]++;
+        return it->second;
+    }
+
+    uint32_t index = acquire_slot(_freeMaterials, _materialCount, MAX_MATERIALS);
+    _materialSlots.emplace(material, index);
+    _materialKeys[index] = material;
+    _materialRefs[index] = 1;
+
+    std::memcpy(static_cast<GPUMaterialData*>(_materialBuffer._data) + index, &material, sizeof(GPUMaterialData));
+
+    return index;
+}
+
+/**
+ * The slot is recycled once released by every owner and in-flight frames have been completed.
+ * @brief release a texture slot
+ * @param index texture slot index
+ */
+void BindlessTable::release_texture(uint32_t index) {
+    if (index == DEFAULT_INDEX) {
+        return;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (--_textureRefs[index] > 0) {
+            return;
+        }
+        _textureSlots.erase(_textureKeys[index]);
+    }
+
+    g_deletionQueue.push_function([this, index]() {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _freeTextures.push_back(index);
+    });
+}
+
+/**
+ * The slot is recycled once released by every owner and in-flight frames have been completed.
+ * @brief release a material slot
+ * @param index material slot index
+ */
+void BindlessTable::release_material(uint32_t index) {
+    if (index == DEFAULT_INDEX) {
+        return;
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (--_materialRefs[index] > 0) {
+            return;
+        }
+        _materialSlots.erase(_materialKeys[index]);
+    }
+
+    g_deletionQueue.push_function([this, index]() {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        _freeMaterials.push_back(index);
+    });
+}
+
+/**
+ * @brief number of slots in use and of registrations sharing an existing slot
+ * @return statistics
+ */
+BindlessTable::Statistics BindlessTable::statistics() {
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    Statistics stats{};
+    stats.textures = static_cast<uint32_t>(_textureSlots.size());
+    stats.materials = static_cast<uint32_t>(_materialSlots.size());
+    for (auto& it : _textureSlots) {
+        stats.sharedTextures += _textureRefs[it.second] - 1;
+    }
+    for (auto& it : _materialSlots) {
+        stats.sharedMaterials += _materialRefs[it.second] - 1;
+    }
+    return stats;
+}
+
+/**
+ * @brief get a recycled slot or the next unused slot
+ * @param freeSlots recycled slots
+ * @param count number of slots used so far
+ * @param capacity maximum number of slots
+ * @return slot index
+ */
+uint32_t BindlessTable::acquire_slot(std::vector<uint32_t>& freeSlots, uint32_t& count, uint32_t capacity) {
+    if (!freeSlots.empty()) {
+        uint32_t index = freeSlots.back();
+        freeSlots.pop_back();
+        return index;
+    }
+
+    if (count >= capacity) {
+        throw std::runtime_error("Bindless table capacity exceeded");
+    }
+
+    return count++;
+}
+
+bool BindlessTable::TextureKey::operator==(const TextureKey& other) const {
+    return sampler == other.sampler && imageView == other.imageView && imageLayout == other.imageLayout;
+}
+
+std::size_t BindlessTable::TextureKeyHash::operator()(const TextureKey& k) const {
+    size_t result = std::hash<uint64_t>()(reinterpret_cast<uint64_t>(k.sampler));
+    helper::hash_combine(result, reinterpret_cast<uint64_t>(k.imageView));
+    helper::hash_combine(result, static_cast<uint32_t>(k.imageLayout));
+    return result;
+}
+
+std::size_t BindlessTable::MaterialHash::operator()(const GPUMaterialData& k) const {
+    size_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        helper::hash_combine(result, k.baseColorFactor[i]);
+    }
+    helper::hash_combine(result, k.metallicFactor);
+    helper::hash_combine(result, k.roughnessFactor);
+    helper::hash_combine(result, k.alphaCutoff);
+    helper::hash_combine(result, k.baseColorTexture);
+    helper::hash_combine(result, k.normalTexture);
+    helper::hash_combine(result, k.metallicRoughnessTexture);
+    helper::hash_combine(result, k.aoTexture);
+    helper::hash_combine(result, k.emissiveTexture);
+    return result;
+}
+
+bool BindlessTable::MaterialEqual::operator()(const GPUMaterialData& a, const GPUMaterialData& b) const {
+    return a.baseColorFactor == b.baseColorFactor && a.metallicFactor == b.metallicFactor && a.roughnessFactor == b.roughnessFactor &&
+           a.alphaCutoff == b.alphaCutoff && a.baseColorTexture == b.baseColorTexture && a.normalTexture == b.normalTexture &&
+           a.metallicRoughnessTexture == b.metallicRoughnessTexture && a.aoTexture == b.aoTexture && a.emissiveTexture == b.emissiveTexture;
+}
@@ -0,0 +1,107 @@
+/*
+*  H2Vk - BindlessTable class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+#include "core/vk_buffer.h"
+#include "core/vk_texture.h"
+#include "core/utilities/vk_types.h"
+
+class Device;
+
+/**
+ * Single descriptor set shared by every mesh pipeline (set 2), using descriptor indexing (Vulkan 1.2).
+ * - binding 0 : storage buffer of materials (factors + texture indices)
+ * - binding 1 : variable size array of combined image samplers, partially bound and updated after bind
+ * Textures and materials are referenced by their slot index. Slot 0 holds a white texture and a default material.
+ * Registrations are deduplicated : textures by sampler, image view and layout, materials by content. Slots are
+ * reference counted and recycled once released by every owner and in-flight frames have been completed.
+ * @brief bindless textures and materials
+ */
+class BindlessTable final {
+public:
+    /** @brief maximum number of textures, lowered to device limits */
+    static constexpr uint32_t MAX_TEXTURES = 4096;
+    /** @brief maximum number of materials */
+    static constexpr uint32_t MAX_MATERIALS = 4096;
+    /** @brief default texture and material slot */
+    static constexpr uint32_t DEFAULT_INDEX = 0;
+
+    /** @brief slots in use and registrations served by an existing slot */
+    struct Statistics {
+        uint32_t textures = 0;
+        uint32_t materials = 0;
+        uint32_t sharedTextures = 0;
+        uint32_t sharedMaterials = 0;
+    };
+
+    VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+    VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+
+    BindlessTable(const Device& device, const UploadContext& uploadContext);
+    ~BindlessTable();
+
+    uint32_t register_texture(const VkDescriptorImageInfo& imageInfo);
+    uint32_t register_material(const GPUMaterialData& material);
+    void release_texture(uint32_t index);
+    void release_material(uint32_t index);
+    Statistics statistics();
+
+private:
+    /** @brief texture identity : sampler, image view and layout */
+    struct TextureKey {
+        VkSampler sampler;
+        VkImageView imageView;
+        VkImageLayout imageLayout;
+        bool operator==(const TextureKey& other) const;
+    };
+
+    struct TextureKeyHash {
+        std::size_t operator()(const TextureKey& k) const;
+    };
+
+    struct MaterialHash {
+        std::size_t operator()(const GPUMaterialData& k) const;
+    };
+
+    struct MaterialEqual {
+        bool operator()(const GPUMaterialData& a, const GPUMaterialData& b) const;
+    };
+
+    const class Device& _device;
+    std::mutex _mutex;
+
+    VkDescriptorPool _pool = VK_NULL_HANDLE;
+    /** @brief persistently mapped material storage buffer */
+    AllocatedBuffer _materialBuffer;
+    /** @brief white texture bound to slot 0 */
+    Texture _defaultTexture;
+
+    uint32_t _textureCapacity = MAX_TEXTURES;
+    uint32_t _textureCount = 0;
+    uint32_t _materialCount = 0;
+    std::vector<uint32_t> _freeTextures;
+    std::vector<uint32_t> _freeMaterials;
+
+    /** @brief slot of each registered texture */
+    std::unordered_map<TextureKey, uint32_t, TextureKeyHash> _textureSlots;
+    /** @brief slot of each registered material */
+    std::unordered_map<GPUMaterialData, uint32_t, MaterialHash, MaterialEqual> _materialSlots;
+    /** @brief number of owners per slot */
+    std::vector<uint32_t> _textureRefs;
+    std::vector<uint32_t> _materialRefs;
+    /** @brief key of each slot, used to forget released slots */
+    std::vector<TextureKey> _textureKeys;
+    std::vector<GPUMaterialData> _materialKeys;
+
+    static uint32_t acquire_slot(std::vector<uint32_t>& freeSlots, uint32_t& count, uint32_t capacity);
+};
@@ -7,6 +7,7 @@
 */
 
 #include "vk_buffer.h"
+#include "core/utilities/vk_memory_statistics.h"
 
 /** @brief  Used for debugging */
 std::set<AllocatedBuffer*> Buffer::_bufferTracker;
@@ -19,8 +20,9 @@ std::set<AllocatedBuffer*> Buffer::_bufferTracker;
  * @param allocSize size in bytes of the buffer to be created
  * @param usage  bitmask specifying allowed usages of the buffer
  * @param memoryUsage memory requirements
+ * @param flags allocation flags. VMA_ALLOCATION_CREATE_MAPPED_BIT keeps the buffer persistently mapped.
  */
-void Buffer::create_buffer(const Device& device, AllocatedBuffer* buffer, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
+void Buffer::create_buffer(const Device& device, AllocatedBuffer* buffer, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags) {
     // Parameters of a newly created buffer object
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -31,27 +33,84 @@ void Buffer::create_buffer(const Device& device, AllocatedBuffer* buffer, size_t
 
     // Parameters of new VmaAllocation.
     VmaAllocationCreateInfo vmaallocInfo = {};
-    vmaallocInfo.usage = memoryUsage;
-    vmaallocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    vmaallocInfo.flags = flags;
+    Buffer::memory_policy(memoryUsage, vmaallocInfo);
 
     // Creates a new VkBuffer
+    VmaAllocationInfo allocationInfo = {};
     buffer->_allocator = device._allocator;
     VK_CHECK(vmaCreateBuffer(device._allocator,
                              &bufferInfo,
                              &vmaallocInfo,
                              &buffer->_buffer,
                              &buffer->_allocation,
-                             nullptr));
+                             &allocationInfo));
 
-    Buffer:_bufferTracker.insert(buffer);
+    if (flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) {
+        buffer->_data = allocationInfo.pMappedData;
+        buffer->_persistent = true;
+    }
+
+    Buffer::_bufferTracker.insert(buffer);
+    MemoryStatistics::track(device._allocator, buffer->_allocation, Buffer::memory_category(usage));
+}
+
+/**
+ * @brief engine category of a buffer, deduced from its usage
+ * @param usage bitmask specifying allowed usages of the buffer
+ * @return memory category
+ */
+MemoryCategory Buffer::memory_category(VkBufferUsageFlags usage) {
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+        return MemoryCategory::MESH;
+    }
+    if (usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)) {
+        return MemoryCategory::UNIFORM;
+    }
+    if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+        return MemoryCategory::STAGING;
+    }
+    return MemoryCategory::OTHER;
+}
+
+/**
+ * Memory properties associated to a memory usage.
+ * GPU only resources stay in device local memory, host accessed resources are host visible and coherent.
+ * CPU to GPU resources prefer device local memory when it is host visible (ex. resizable BAR).
+ * @brief memory type selection policy
+ * @param memoryUsage memory requirements
+ * @param allocInfo allocation parameters to be completed
+ */
+void Buffer::memory_policy(VmaMemoryUsage memoryUsage, VmaAllocationCreateInfo& allocInfo) {
+    allocInfo.usage = memoryUsage;
+
+    switch (memoryUsage) {
+        case VMA_MEMORY_USAGE_GPU_ONLY:
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case VMA_MEMORY_USAGE_CPU_TO_GPU:
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case VMA_MEMORY_USAGE_GPU_TO_CPU:
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            allocInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        default:
+            allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+    }
 }
 
 VkResult AllocatedBuffer::map() {
+    if (_persistent) {
+        return VK_SUCCESS;
+    }
     return vmaMapMemory(_allocator, _allocation, &_data);
 }
 
 void AllocatedBuffer::unmap() {
-    if (_data) {
+    if (_data && !_persistent) {
         vmaUnmapMemory(_allocator, _allocation);
     }
 }
@@ -68,8 +127,11 @@ void AllocatedBuffer::copyFrom(void* source, size_t size) {
  */
 void AllocatedBuffer::destroy() {
     if (_allocator) {
+        MemoryStatistics::untrack(_allocation);
         vmaDestroyBuffer(_allocator, _buffer, _allocation);
         _allocator = nullptr;
+        _data = nullptr;
+        _persistent = false;
         Buffer::_bufferTracker.erase(this);
     }
 }
\ No newline at end of file
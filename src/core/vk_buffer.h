@@ -9,6 +9,7 @@
 #pragma once
 
 #include "core/utilities/vk_resources.h"
+#include "core/utilities/vk_memory_statistics.h"
 #include <algorithm>
 #include <set>
 
@@ -27,7 +28,9 @@ public:
     /** @brief Represent linear arrays of data, used by binding them to a graphics or compute pipeline  */
     VkBuffer _buffer = VK_NULL_HANDLE;
     /** memory address */
-    void* _data;
+    void* _data = nullptr;
+    /** @brief Memory mapped for the whole buffer lifetime. map/unmap become no-op */
+    bool _persistent = false;
 
     AllocatedBuffer() = default;
     ~AllocatedBuffer() {
@@ -52,5 +55,7 @@ public:
 class Buffer final {
 public:
     static std::set<AllocatedBuffer*> _bufferTracker;
-    static void create_buffer(const Device& device, AllocatedBuffer* buffer, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+    static void create_buffer(const Device& device, AllocatedBuffer* buffer, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags flags = 0);
+    static void memory_policy(VmaMemoryUsage memoryUsage, VmaAllocationCreateInfo& allocInfo);
+    static MemoryCategory memory_category(VkBufferUsageFlags usage);
 };
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "vk_command_buffer.h"
 #include "vk_command_pool.h"
 #include "vk_fence.h"
+#include "vk_semaphore.h"
 #include "core/utilities/vk_initializers.h"
 
 /**
@@ -92,3 +93,98 @@ void CommandBuffer::immediate_submit(const Device& device, const UploadContext&
     // Recycles the resources from the command buffers allocated from the command pool back to the command pool.
     vkResetCommandPool(device._logicalDevice, ctx._commandPool->_commandPool, 0);
 }
+
+
+/**
+ * Records upload commands and submit them to the transfer queue.
+ * When device exposes a dedicated transfer queue family, resources ownership is released by the transfer queue
+ * then acquired by the graphics queue, both submissions being chained with a semaphore. Otherwise a single command buffer
+ * is submitted to the graphics queue.
+ * Only the calling thread waits for completion: rendering thread keeps submitting frames while uploads are processed.
+ * @brief records and submit upload commands on transfer queue
+ * @param device vulkan device wrapper
+ * @param ctx executing command buffers, semaphore and fence
+ * @param dstStage pipeline stages consuming the uploaded resources
+ * @param bufferBarriers final buffer barriers (access masks after upload). Queue families are filled by the function.
+ * @param imageBarriers final image barriers (layouts, access masks after upload). Queue families are filled by the function.
+ * @param function lambda recording copy commands
+ */
+void CommandBuffer::transfer_submit(const Device& device, const UploadContext& ctx, VkPipelineStageFlags dstStage,
+                                    std::vector<VkBufferMemoryBarrier> bufferBarriers, std::vector<VkImageMemoryBarrier> imageBarriers,
+                                    std::function<void(VkCommandBuffer cmd)>&& function) {
+    if (!device.has_dedicated_transfer() || ctx._transferBuffer == nullptr) {
+        immediate_submit(device, ctx, [&](VkCommandBuffer cmd) {
+            function(cmd);
+            for (auto& barrier : bufferBarriers) {
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            }
+            for (auto& barrier : imageBarriers) {
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            }
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr,
+                                 static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                                 static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        });
+        return;
+    }
+
+    const uint32_t transferFamily = device.get_transfer_queue_family();
+    const uint32_t graphicsFamily = device.get_graphics_queue_family();
+
+    // Release: make transfer writes available, destination access is ignored by the releasing queue
+    std::vector<VkBufferMemoryBarrier> releaseBuffers = bufferBarriers;
+    for (auto& barrier : releaseBuffers) {
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+    }
+    std::vector<VkImageMemoryBarrier> releaseImages = imageBarriers;
+    for (auto& barrier : releaseImages) {
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+    }
+
+    // Acquire: same layout transition and queue families, source access is ignored by the acquiring queue
+    for (auto& barrier : bufferBarriers) {
+        barrier.srcAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+    }
+    for (auto& barrier : imageBarriers) {
+        barrier.srcAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+    }
+
+    VkCommandBuffer transferCmd = ctx._transferBuffer->_commandBuffer;
+    VkCommandBuffer graphicsCmd = ctx._commandBuffer->_commandBuffer;
+    VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    std::scoped_lock<std::mutex, std::mutex> lock(ctx._transferBuffer->_mutex, ctx._commandBuffer->_mutex);
+
+    VK_CHECK(vkBeginCommandBuffer(transferCmd, &cmdBeginInfo));
+    function(transferCmd);
+    vkCmdPipelineBarrier(transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(releaseBuffers.size()), releaseBuffers.data(),
+                         static_cast<uint32_t>(releaseImages.size()), releaseImages.data());
+    VK_CHECK(vkEndCommandBuffer(transferCmd));
+
+    VK_CHECK(vkBeginCommandBuffer(graphicsCmd, &cmdBeginInfo));
+    vkCmdPipelineBarrier(graphicsCmd, dstStage, dstStage, 0, 0, nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    VK_CHECK(vkEndCommandBuffer(graphicsCmd));
+
+    // Semaphore wait stage matches acquire barrier source stage so both dependencies chain
+    device._transferQueue->queue_submit(0, {}, {ctx._transferSemaphore->_semaphore}, {transferCmd}, VK_NULL_HANDLE);
+    device._queue->queue_submit(dstStage, {ctx._transferSemaphore->_semaphore}, {}, {graphicsCmd}, ctx._uploadFence->_fence);
+
+    vkWaitForFences(device._logicalDevice, 1, &ctx._uploadFence->_fence, true, 9999999999);
+    vkResetFences(device._logicalDevice, 1, &ctx._uploadFence->_fence);
+
+    vkResetCommandPool(device._logicalDevice, ctx._transferPool->_commandPool, 0);
+    vkResetCommandPool(device._logicalDevice, ctx._commandPool->_commandPool, 0);
+}
\ No newline at end of file
@@ -15,6 +15,7 @@
 class CommandPool;
 class Device;
 class Fence;
+class Semaphore;
 class CommandBuffer;
 
 /** @brief command buffer recording environment */
@@ -25,6 +26,12 @@ struct UploadContext {
     CommandPool* _commandPool;
     /** @brief command buffer wrapper */
     CommandBuffer* _commandBuffer;
+    /** @brief command pool wrapper allocated from transfer queue family */
+    CommandPool* _transferPool = nullptr;
+    /** @brief command buffer wrapper submitted to transfer queue */
+    CommandBuffer* _transferBuffer = nullptr;
+    /** @brief signaled by transfer queue, waited by graphics queue before acquiring resources ownership */
+    Semaphore* _transferSemaphore = nullptr;
 };
 
 /**
@@ -46,6 +53,9 @@ public:
     void record(std::function<void(VkCommandBuffer cmd)>&& function);
 
     static void immediate_submit(const Device& device, const UploadContext& ctx, std::function<void(VkCommandBuffer cmd)>&& function);
+    static void transfer_submit(const Device& device, const UploadContext& ctx, VkPipelineStageFlags dstStage,
+                                std::vector<VkBufferMemoryBarrier> bufferBarriers, std::vector<VkImageMemoryBarrier> imageBarriers,
+                                std::function<void(VkCommandBuffer cmd)>&& function);
 
 private:
     /** @brief vulkan device wrapper */
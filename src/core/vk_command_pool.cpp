@@ -14,11 +14,18 @@
  * Commands are typically drawing operation, data transfers, etc. and need to go through command buffers.
  * @param device
  */
-CommandPool::CommandPool(const Device& device) : _device(device) {
+CommandPool::CommandPool(const Device& device) : CommandPool(device, device.get_graphics_queue_family()) {}
+
+/**
+ * Command pool dedicated to a queue family. Command buffers allocated from it can only be submitted to this family queues.
+ * @param device
+ * @param queueFamily queue family index (ex. graphics or transfer)
+ */
+CommandPool::CommandPool(const Device& device, uint32_t queueFamily) : _device(device) {
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // usage behavior for the pool
-    poolInfo.queueFamilyIndex = device.get_graphics_queue_family(); // todo - allow choice of graphics queue
+    poolInfo.queueFamilyIndex = queueFamily;
     poolInfo.pNext = nullptr;
 
     VK_CHECK(vkCreateCommandPool(device._logicalDevice, &poolInfo, nullptr, &_commandPool));
@@ -23,6 +23,7 @@ public:
     VkCommandPool _commandPool;
 
     explicit CommandPool(const Device& device);
+    CommandPool(const Device& device, uint32_t queueFamily);
     ~CommandPool();
 
 private:
@@ -7,7 +7,24 @@
 */
 
 #include "vk_descriptor_allocator.h"
+#include "core/utilities/vk_global.h"
+#include "core/utilities/vk_memory_statistics.h"
+#include "core/utilities/vk_helpers.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+/** @brief source of allocator identifiers. Identifiers are never reused. */
+static std::atomic<uint64_t> s_allocatorCounter{0};
+
+/**
+ * @brief default constructor
+ * @param device vulkan device wrapper
+ * @param flags bitmask specifying supported operations of the descriptor pools
+ */
+DescriptorAllocator::DescriptorAllocator(const Device &device, VkDescriptorPoolCreateFlags flags) :
+    _device(device), _id(++s_allocatorCounter), _flags(flags) {}
 
 /**
  * @brief default destructor
@@ -21,126 +38,286 @@ DescriptorAllocator::~DescriptorAllocator() {
  * Destroy descriptor pools, implicitly free and invalidate descriptor sets allocated from the pools
  */
 void DescriptorAllocator::destroyPools() {
-    for (auto p : _freePools) {
-        vkDestroyDescriptorPool(_device._logicalDevice, p, nullptr);
+    clearSets();
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    int64_t count = 0;
+    for (auto& threadPools : _threadPools) {
+        for (auto& it : threadPools->families) {
+            PoolFamily& family = it.second;
+            family.usedPools.insert(family.usedPools.end(), family.freePools.begin(), family.freePools.end());
+            if (family.currentPool != VK_NULL_HANDLE) {
+                family.usedPools.push_back(family.currentPool);
+            }
+            for (auto p : family.usedPools) {
+                vkDestroyDescriptorPool(_device._logicalDevice, p, nullptr);
+            }
+            count += static_cast<int64_t>(family.usedPools.size());
+        }
+        threadPools->families.clear();
     }
-    for (auto p : _usedPools) {
-        vkDestroyDescriptorPool(_device._logicalDevice, p, nullptr);
+    MemoryStatistics::destroyed(ObjectCategory::DESCRIPTOR_POOL, count);
+}
+
+/**
+ * Hand over descriptor pools to the frame deletion queue. Descriptor sets allocated from the pools remain valid
+ * until in-flight frames using them have been completed.
+ * @brief deferred destruction of descriptor pools
+ */
+void DescriptorAllocator::retirePools() {
+    clearSets();
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    std::vector<VkDescriptorPool> pools;
+    for (auto& threadPools : _threadPools) {
+        for (auto& it : threadPools->families) {
+            PoolFamily& family = it.second;
+            pools.insert(pools.end(), family.usedPools.begin(), family.usedPools.end());
+            pools.insert(pools.end(), family.freePools.begin(), family.freePools.end());
+            if (family.currentPool != VK_NULL_HANDLE) {
+                pools.push_back(family.currentPool);
+            }
+        }
+        threadPools->families.clear();
     }
 
-    _freePools.clear();
-    _usedPools.clear();
+    VkDevice device = _device._logicalDevice;
+    g_deletionQueue.push_function([device, pools]() {
+        for (auto p : pools) {
+            vkDestroyDescriptorPool(device, p, nullptr);
+        }
+        MemoryStatistics::destroyed(ObjectCategory::DESCRIPTOR_POOL, static_cast<int64_t>(pools.size()));
+    });
 }
 
 /**
  * Recycles resources from the descriptor sets allocated from the used pools back to the free pools.
- * Descriptor sets are implicitly freed.
+ * Descriptor sets are implicitly freed. Pools are kept by their family, so following allocations do not create pools.
  * @brief reset descriptor pools
  */
 void DescriptorAllocator::clearPools() {
-    for (auto p : _freePools) {
-        vkResetDescriptorPool(_device._logicalDevice, p, 0);
-    }
+    clearSets();
+    std::scoped_lock<std::mutex> lock(_mutex);
 
-    for (auto p : _usedPools) {
-        vkResetDescriptorPool(_device._logicalDevice, p, 0);
-        _freePools.push_back(p);
+    for (auto& threadPools : _threadPools) {
+        for (auto& it : threadPools->families) {
+            PoolFamily& family = it.second;
+            if (family.currentPool != VK_NULL_HANDLE) {
+                family.usedPools.push_back(family.currentPool);
+                family.currentPool = VK_NULL_HANDLE;
+            }
+            for (auto p : family.usedPools) {
+                vkResetDescriptorPool(_device._logicalDevice, p, 0);
+                family.freePools.push_back(p);
+            }
+            family.usedPools.clear();
+            family.allocatedSets = 0;
+            family.sharedSets = 0;
+        }
     }
-
-    _usedPools.clear();
-    _freePools.shrink_to_fit();
-    _currentPool = VK_NULL_HANDLE;
 }
 
 /**
  * Allocate a descriptor set.
- * Get an unused descriptor pool or create a new one. Allocate a single descriptor set from the descriptor pool.
- * Try to re-allocate one time if allocation fail the first time.
+ * Select the pool family of the calling thread matching the requested sizes, allocate a single descriptor set
+ * from its current pool. When the pool is exhausted, it is set aside and the allocation is retried once from
+ * another pool of the family.
  *
  * @brief allocate descriptor set
  * @param descriptor pointer to descriptor set
  * @param setLayout pointer to descriptor layout
- * @param sizes collection of descriptor pool sizes
+ * @param sizes collection of descriptor pool sizes required by a single set
  * @return true if descriptor set allocated successfully
  */
 bool DescriptorAllocator::allocate(VkDescriptorSet* descriptor, VkDescriptorSetLayout* setLayout, std::vector<VkDescriptorPoolSize> sizes) {
-    std::scoped_lock<std::mutex> lock(_mutex);
-
-    // if (_currentPool == VK_NULL_HANDLE){ // if no pool selected
-    _currentPool = getPool(sizes, 0, MAX_SETS);  // todo clean up descriptorPool choice and size
-        // _usedPools.push_back(_currentPool);
-    // }
+    PoolFamily& family = getFamily(sizes);
+    if (family.currentPool == VK_NULL_HANDLE) {
+        family.currentPool = getPool(family);
+    }
 
     VkDescriptorSetAllocateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     info.pNext = nullptr;
-    info.descriptorPool = _currentPool; // allocated from this descriptor pool
+    info.descriptorPool = family.currentPool; // allocated from this descriptor pool
     info.descriptorSetCount = 1; // one descriptor set
     info.pSetLayouts = setLayout; // using this layout
 
     VkResult result = vkAllocateDescriptorSets(_device._logicalDevice, &info, descriptor);
-    if (result == VK_SUCCESS) {
-        _freePools.push_back(_currentPool);
-        return true;
-    } else if (result == VK_ERROR_FRAGMENTED_POOL || result == VK_ERROR_OUT_OF_POOL_MEMORY) {
-        _usedPools.push_back(_currentPool);
-        _currentPool = getPool(sizes, 0, MAX_SETS);
-        info.descriptorPool = _currentPool;
-        VK_CHECK(vkAllocateDescriptorSets(_device._logicalDevice, &info, descriptor));
-        std::cout << "reallocate success" << std::endl;
-
-        _freePools.push_back(_currentPool);
-        return true;
+    if (result == VK_ERROR_FRAGMENTED_POOL || result == VK_ERROR_OUT_OF_POOL_MEMORY) {
+        family.usedPools.push_back(family.currentPool);
+        family.currentPool = getPool(family);
+        info.descriptorPool = family.currentPool;
+        result = vkAllocateDescriptorSets(_device._logicalDevice, &info, descriptor);
+    }
+
+    if (result != VK_SUCCESS) {
+        std::cout << "Failed to allocate descriptor set : " << result << std::endl;
+        return false;
+    }
+
+    family.allocatedSets++;
+    return true;
+}
+
+/**
+ * @brief get a cached descriptor set with the same layout and bound resources
+ * @param key layout and bound resources
+ * @param sizes collection of descriptor pool sizes required by a single set, used to account the saved allocation
+ * @param descriptor pointer to descriptor set, updated when found
+ * @return true if a cached descriptor set has been found
+ */
+bool DescriptorAllocator::findSet(const SetKey& key, const std::vector<VkDescriptorPoolSize>& sizes, VkDescriptorSet* descriptor) {
+    {
+        std::shared_lock<std::shared_mutex> lock(_setsMutex);
+        auto it = _sets.find(key);
+        if (it == _sets.end()) {
+            return false;
+        }
+        *descriptor = it->second;
+    }
+
+    getFamily(sizes).sharedSets++;
+    return true;
+}
+
+/**
+ * Descriptor set must have been allocated from this allocator and fully written.
+ * @brief add a descriptor set to the shared set cache
+ * @param key layout and bound resources
+ * @param descriptor descriptor set
+ */
+void DescriptorAllocator::cacheSet(SetKey key, VkDescriptorSet descriptor) {
+    std::unique_lock<std::shared_mutex> lock(_setsMutex);
+    _sets.emplace(std::move(key), descriptor);
+}
+
+/**
+ * Saved pools are estimated per family, from the number of pools required by the allocated sets
+ * with and without the shared ones.
+ * @brief shared set cache statistics since the pools were reset
+ * @return statistics
+ */
+DescriptorAllocator::Statistics DescriptorAllocator::statistics() {
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    Statistics stats{};
+    for (auto& threadPools : _threadPools) {
+        for (auto& it : threadPools->families) {
+            const uint32_t allocated = it.second.allocatedSets;
+            const uint32_t shared = it.second.sharedSets;
+            stats.allocatedSets += allocated;
+            stats.sharedSets += shared;
+            stats.savedPools += getPoolCount(allocated + shared) - getPoolCount(allocated);
+        }
+    }
+    return stats;
+}
+
+/**
+ * @brief empty the shared set cache
+ */
+void DescriptorAllocator::clearSets() {
+    std::unique_lock<std::shared_mutex> lock(_setsMutex);
+    _sets.clear();
+}
+
+/**
+ * Pool families are only accessed by the thread owning them. The calling thread find its own families through a
+ * thread local map, the mutex is only locked to register a new thread.
+ * @brief get pool families of the calling thread
+ * @return pool families
+ */
+DescriptorAllocator::ThreadPools& DescriptorAllocator::getThreadPools() {
+    thread_local std::unordered_map<uint64_t, ThreadPools*> threadLocalPools;
+
+    auto it = threadLocalPools.find(_id);
+    if (it != threadLocalPools.end()) {
+        return *it->second;
+    }
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _threadPools.push_back(std::make_unique<ThreadPools>());
+    threadLocalPools[_id] = _threadPools.back().get();
+    return *_threadPools.back();
+}
+
+/**
+ * Families are only modified by the thread owning them, but iterated by statistics from any thread : the mutex is
+ * locked while a family is inserted. Set counters are atomic and updated without lock.
+ * @brief get the pool family of the calling thread matching a size class, create it if needed
+ * @param sizes collection of descriptor pool sizes required by a single set
+ * @return pool family
+ */
+DescriptorAllocator::PoolFamily& DescriptorAllocator::getFamily(const std::vector<VkDescriptorPoolSize>& sizes) {
+    ThreadPools& threadPools = getThreadPools();
+    SizeClass sizeClass = getSizeClass(sizes);
+
+    auto it = threadPools.families.find(sizeClass);
+    if (it != threadPools.families.end()) {
+        return it->second;
     }
 
-//    bool reallocate = false;
-//    switch (result) {
-//        case VK_SUCCESS:
-//            return true;
-//        case VK_ERROR_FRAGMENTED_POOL:
-//        case VK_ERROR_OUT_OF_POOL_MEMORY:
-//            reallocate = true;
-//            break;
-//        default:
-//            return false;
-//    }
-//
-//    if (reallocate) {
-//        _currentPool = getPool(sizes, 0, MAX_SETS);
-//        info.descriptorPool = _currentPool;
-//        _usedPools.push_back(_currentPool);
-//        result = vkAllocateDescriptorSets(_device._logicalDevice, &info, descriptor);
-//        if (result == VK_SUCCESS){
-//            std::cout << "reallocate success" << std::endl;
-//            return true;
-//        }
-//        std::cout << "reallocate fail" << std::endl;
-//    }
-
-    return false;
+    std::scoped_lock<std::mutex> lock(_mutex);
+    PoolFamily& family = threadPools.families.try_emplace(std::move(sizeClass)).first->second;
+    family.sizes = sizes;
+    return family;
 }
 
 /**
  * Get a descriptor pool from which descriptor sets will be allocated.
- * Manage a list of free and used descriptor pools. This abstraction allows to allocate descriptor set easily without
- * worrying about the management of descriptor pools.
+ * Reset pools of the family are reused first. Otherwise, a new pool is created, twice larger than the previous one.
 
  * @brief get a free pool or return a new descriptor pool
- * @note todo - to be fixed - No comparison are made between the existing pool and the parameters provided.
- * @note todo - Free pool returned might not corresponds. Currently only one descriptor set is allocated per pool.
- * @param poolSizes how many descriptor of each type allocated from the pool (ie. uniform buffer, combined image, etc.)
- * @param flags bitmask specifying supported operations of the descriptor pool
- * @param count maximum number of sets allocated from the pool
+ * @param family pool family of a size class
  * @return an existing or new descriptor pool
  */
-VkDescriptorPool DescriptorAllocator::getPool(std::vector<VkDescriptorPoolSize> poolSizes, VkDescriptorPoolCreateFlags flags, uint32_t count) {
-    if (_freePools.size() > 0) {
-        VkDescriptorPool pool = _freePools.back();
-        _freePools.pop_back();
+VkDescriptorPool DescriptorAllocator::getPool(PoolFamily& family) {
+    if (!family.freePools.empty()) {
+        VkDescriptorPool pool = family.freePools.back();
+        family.freePools.pop_back();
         return pool;
     }
 
-    return createPool(poolSizes, flags, count);
+    VkDescriptorPool pool = createPool(family.sizes, _flags, family.setsPerPool);
+    family.setsPerPool = std::min(family.setsPerPool * 2, MAX_SETS_PER_POOL);
+    return pool;
+}
+
+/**
+ * Descriptor pool sizes provided by different callers for the same set requirements may be ordered differently
+ * or split the same type in several entries.
+ * @brief size class of a descriptor set
+ * @param sizes collection of descriptor pool sizes required by a single set
+ * @return descriptor count per type, sorted by type
+ */
+DescriptorAllocator::SizeClass DescriptorAllocator::getSizeClass(const std::vector<VkDescriptorPoolSize>& sizes) {
+    SizeClass sizeClass;
+    for (auto& sz : sizes) {
+        auto it = std::find_if(sizeClass.begin(), sizeClass.end(), [&](const auto& s) { return s.first == sz.type; });
+        if (it != sizeClass.end()) {
+            it->second += sz.descriptorCount;
+        } else {
+            sizeClass.emplace_back(sz.type, sz.descriptorCount);
+        }
+    }
+    std::sort(sizeClass.begin(), sizeClass.end());
+    return sizeClass;
+}
+
+/**
+ * @brief number of pools of a family required to allocate sets, following the pool size growth
+ * @param setCount number of sets
+ * @return number of pools
+ */
+uint32_t DescriptorAllocator::getPoolCount(uint32_t setCount) {
+    uint32_t count = 0;
+    uint32_t setsPerPool = SETS_PER_POOL;
+    while (setCount > 0) {
+        setCount -= std::min(setCount, setsPerPool);
+        setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+        count++;
+    }
+    return count;
 }
 
 /**
@@ -168,6 +345,28 @@ VkDescriptorPool DescriptorAllocator::createPool(std::vector<VkDescriptorPoolSiz
 
     VkDescriptorPool descriptorPool;
     vkCreateDescriptorPool(_device._logicalDevice, &info, nullptr, &descriptorPool);
+    MemoryStatistics::created(ObjectCategory::DESCRIPTOR_POOL);
 
     return descriptorPool;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief overload SetKey operator ==
+ * @param other
+ * @return true if same layout and bound resources
+ */
+bool DescriptorAllocator::SetKey::operator==(const SetKey& other) const {
+    return layout == other.layout && resources == other.resources;
+}
+
+/**
+ * @brief shared descriptor set key hash function
+ * @return hash
+ */
+size_t DescriptorAllocator::SetKey::hash() const {
+    size_t result = std::hash<uint64_t>()(reinterpret_cast<uint64_t>(layout));
+    for (uint64_t resource : resources) {
+        helper::hash_combine(result, resource);
+    }
+    return result;
+}
@@ -9,6 +9,11 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <shared_mutex>
 
 #include "core/utilities/vk_resources.h"
 
@@ -16,36 +21,106 @@ class Device;
 
 /**
  * DescriptorAllocator
- * This might not be the most optimal solution.
- * - Maximal number of sets per pool is abstract. Pool size fixed by descriptor layout.
- * - Descriptor pools are created when pool size does not suits the best (which depends on descriptor layout)
- * while a single descriptor pool with large range of pool sizes might work instead.
- * todo - Look for a proper solution?
+ * Descriptor pools are grouped in families, one family per size class (descriptor types and counts required by a set).
+ * A family allocates from its current pool until exhausted, then moves to a reset pool or creates a larger one.
+ * Each thread allocating from the allocator owns its families: the mutex is only taken when a thread creates a family,
+ * so scene loading in a job thread does not contend with the render thread.
+ * Pools are reset all together (ie. transient per-frame sets) or destroyed all together.
+ * Descriptor sets built as shared are cached by layout and bound resources : an identical build returns the cached set.
+ * The cache is emptied with the pools.
+ * @brief descriptor set allocator
+ * @note clearPools, destroyPools and retirePools must not run concurrently with allocate.
  */
 class DescriptorAllocator final {
 public:
     /** @brief vulkan wrapper device */
     const class Device& _device;
-    /** @brief Number of sets per pools (kind of abstract so far) */
-    const unsigned int MAX_SETS = 10;
+    /** @brief Number of sets of the first pool of a family */
+    static constexpr uint32_t SETS_PER_POOL = 64;
+    /** @brief Number of sets per pool is doubled for each new pool of a family, up to this limit */
+    static constexpr uint32_t MAX_SETS_PER_POOL = 1024;
     /** @brief mutex */
     std::mutex _mutex;
 
-    explicit DescriptorAllocator(const Device &device) : _device(device) {};
+    /** @brief shared descriptor set identity : layout and handles of the bound resources */
+    struct SetKey {
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        /** @brief binding, type and resource handles of each write */
+        std::vector<uint64_t> resources;
+        bool operator==(const SetKey& other) const;
+        size_t hash() const;
+    };
+
+    /** @brief descriptor sets allocated and saved by the shared set cache */
+    struct Statistics {
+        uint32_t allocatedSets = 0;
+        uint32_t sharedSets = 0;
+        uint32_t savedPools = 0;
+    };
+
+    explicit DescriptorAllocator(const Device &device, VkDescriptorPoolCreateFlags flags = 0);
     ~DescriptorAllocator();
 
     bool allocate(VkDescriptorSet* descriptor, VkDescriptorSetLayout* setLayout, std::vector<VkDescriptorPoolSize> sizes);
 
     void destroyPools();
     void clearPools();
-    VkDescriptorPool getPool(std::vector<VkDescriptorPoolSize> sizes, VkDescriptorPoolCreateFlags flags, uint32_t count);
+    void retirePools();
     VkDescriptorPool createPool(std::vector<VkDescriptorPoolSize> sizes, VkDescriptorPoolCreateFlags flags, uint32_t count);
 
+    bool findSet(const SetKey& key, const std::vector<VkDescriptorPoolSize>& sizes, VkDescriptorSet* descriptor);
+    void cacheSet(SetKey key, VkDescriptorSet descriptor);
+    Statistics statistics();
+
 private:
-    /** @brief pool set as main allocation pool */
-    VkDescriptorPool _currentPool{VK_NULL_HANDLE};
-    /** @brief collection of used descriptor pools */
-    std::vector<VkDescriptorPool> _usedPools;
-    /** @brief collection of free descriptor pools. Can be used for descriptor set allocation. */
-    std::vector<VkDescriptorPool> _freePools;
-};
\ No newline at end of file
+    /** @brief size class : descriptor count per type, sorted by type */
+    typedef std::vector<std::pair<VkDescriptorType, uint32_t>> SizeClass;
+
+    /** @brief descriptor pools sharing a size class */
+    struct PoolFamily {
+        /** @brief descriptor count per type required by a single set */
+        std::vector<VkDescriptorPoolSize> sizes;
+        /** @brief pool set as main allocation pool */
+        VkDescriptorPool currentPool{VK_NULL_HANDLE};
+        /** @brief collection of exhausted descriptor pools */
+        std::vector<VkDescriptorPool> usedPools;
+        /** @brief collection of reset descriptor pools. Can be used for descriptor set allocation. */
+        std::vector<VkDescriptorPool> freePools;
+        /** @brief maximum number of sets of the next pool created */
+        uint32_t setsPerPool = SETS_PER_POOL;
+        /** @brief number of sets allocated since the pools were reset */
+        std::atomic<uint32_t> allocatedSets{0};
+        /** @brief number of builds served by a cached set since the pools were reset */
+        std::atomic<uint32_t> sharedSets{0};
+    };
+
+    /** @brief pool families owned by a single thread */
+    struct ThreadPools {
+        std::map<SizeClass, PoolFamily> families;
+    };
+
+    /** @brief unique allocator identifier, used to find thread pools of the calling thread */
+    const uint64_t _id;
+    /** @brief bitmask specifying supported operations of the descriptor pools */
+    const VkDescriptorPoolCreateFlags _flags;
+    /** @brief pool families of every thread which allocated from this allocator */
+    std::vector<std::unique_ptr<ThreadPools>> _threadPools;
+
+    struct SetKeyHash {
+        std::size_t operator()(const SetKey& k) const {
+            return k.hash();
+        }
+    };
+
+    /** @brief readers / writer lock of the shared set cache */
+    std::shared_mutex _setsMutex;
+    /** @brief shared descriptor sets */
+    std::unordered_map<SetKey, VkDescriptorSet, SetKeyHash> _sets;
+
+    ThreadPools& getThreadPools();
+    PoolFamily& getFamily(const std::vector<VkDescriptorPoolSize>& sizes);
+    VkDescriptorPool getPool(PoolFamily& family);
+    void clearSets();
+    static SizeClass getSizeClass(const std::vector<VkDescriptorPoolSize>& sizes);
+    static uint32_t getPoolCount(uint32_t setCount);
+};
@@ -10,6 +10,7 @@
 #include "vk_descriptor_allocator.h"
 #include "vk_descriptor_cache.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/vk_device.h"
 
 /**
  * Initialize DescriptorBuilder with caching and allocation systems.
@@ -22,6 +23,19 @@ DescriptorBuilder DescriptorBuilder::begin(DescriptorLayoutCache& layoutCache, D
     DescriptorBuilder builder;
     builder._cache = &layoutCache;
     builder._alloc = &allocator;
+    builder._device = &allocator._device;
+    return builder;
+}
+
+/**
+ * Initialize DescriptorBuilder without caching nor allocation systems : descriptors can only be pushed.
+ * @brief constructor
+ * @param device vulkan device wrapper
+ * @return descriptor builder
+ */
+DescriptorBuilder DescriptorBuilder::begin(const Device& device) {
+    DescriptorBuilder builder;
+    builder._device = &device;
     return builder;
 }
 
@@ -78,13 +92,14 @@ DescriptorBuilder& DescriptorBuilder::bind_none(VkDescriptorType type, VkShaderS
 /**
  * create + cache or get cached layout (using class attributes), then update descriptor set layout by reference
  * @param setLayout descriptor set layout to update by reference
+ * @param flags layout creation flags (ie. push descriptor layout)
  * @return reference to DescriptorBuilder instance
  */
-DescriptorBuilder& DescriptorBuilder::layout(VkDescriptorSetLayout& setLayout) {
+DescriptorBuilder& DescriptorBuilder::layout(VkDescriptorSetLayout& setLayout, VkDescriptorSetLayoutCreateFlags flags) {
     VkDescriptorSetLayoutCreateInfo setInfo{};
     setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     setInfo.pNext = nullptr;
-    setInfo.flags = 0;
+    setInfo.flags = flags;
     setInfo.bindingCount = static_cast<uint32_t>(_bindings.size());
     setInfo.pBindings = _bindings.data();
 
@@ -93,8 +108,21 @@ DescriptorBuilder& DescriptorBuilder::layout(VkDescriptorSetLayout& setLayout) {
     return *this;
 }
 
+/**
+ * The built descriptor set may be shared with identical builds (same layout and bound resources) from the same allocator.
+ * Shared descriptor sets must not be updated afterwards. Bound resources must outlive the allocator pools.
+ * @brief share descriptor set
+ * @return reference to DescriptorBuilder instance
+ */
+DescriptorBuilder& DescriptorBuilder::shared() {
+    _shared = true;
+
+    return *this;
+}
+
 /**
  * Update content of a referenced descriptor set object based on previously set layout and binding.
+ * Shared descriptor sets are only allocated and written when no identical set has been built.
  * @brief update descriptor set
  * @param set descriptor set, set of pointers into resources (ie. buffer, images).
  * @param setLayout layout of the descriptor set, structure of the binding resources
@@ -102,6 +130,29 @@ DescriptorBuilder& DescriptorBuilder::layout(VkDescriptorSetLayout& setLayout) {
  * @return true if descriptor set successfully updated
  */
 bool DescriptorBuilder::build(VkDescriptorSet& set, VkDescriptorSetLayout& setLayout, std::vector<VkDescriptorPoolSize> sizes) {
+    // Sets with reserved bindings (bind_none) are written later, they can't be shared
+    const bool shareable = _shared && _writes.size() == _bindings.size();
+    DescriptorAllocator::SetKey key{setLayout, {}};
+    if (shareable) {
+        for (const VkWriteDescriptorSet& w : _writes) {
+            key.resources.push_back(w.dstBinding);
+            key.resources.push_back(w.descriptorType);
+            if (w.pBufferInfo) {
+                key.resources.push_back(reinterpret_cast<uint64_t>(w.pBufferInfo->buffer));
+                key.resources.push_back(w.pBufferInfo->offset);
+                key.resources.push_back(w.pBufferInfo->range);
+            } else if (w.pImageInfo) {
+                key.resources.push_back(reinterpret_cast<uint64_t>(w.pImageInfo->sampler));
+                key.resources.push_back(reinterpret_cast<uint64_t>(w.pImageInfo->imageView));
+                key.resources.push_back(w.pImageInfo->imageLayout);
+            }
+        }
+
+        if (_alloc->findSet(key, sizes, &set)) {
+            return true;
+        }
+    }
+
     bool success = _alloc->allocate(&set, &setLayout, sizes);
     if (!success) {
         return false;
@@ -114,5 +165,67 @@ bool DescriptorBuilder::build(VkDescriptorSet& set, VkDescriptorSetLayout& setLa
     // possible before bounded for first time (or command buffer submitted).
     vkUpdateDescriptorSets(_alloc->_device._logicalDevice, _writes.size(), _writes.data(), 0, nullptr);
 
+    if (shareable) {
+        _alloc->cacheSet(std::move(key), set);
+    }
+
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * Update content of a referenced descriptor set through a cached update template.
+ * Descriptors are packed in a single array read by the template, no write descriptor set is built.
+ * @brief update descriptor set with template
+ * @param set descriptor set, set of pointers into resources (ie. buffer, images).
+ * @param setLayout layout of the descriptor set, structure of the binding resources
+ * @param sizes
+ * @return true if descriptor set successfully updated
+ */
+bool DescriptorBuilder::build_with_template(VkDescriptorSet& set, VkDescriptorSetLayout& setLayout, std::vector<VkDescriptorPoolSize> sizes) {
+    bool success = _alloc->allocate(&set, &setLayout, sizes);
+    if (!success) {
+        return false;
+    }
+
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    std::vector<DescriptorData> data;
+    entries.reserve(_writes.size());
+    data.reserve(_writes.size());
+
+    for (const VkWriteDescriptorSet& w : _writes) {
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding = w.dstBinding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = 1;
+        entry.descriptorType = w.descriptorType;
+        entry.offset = data.size() * sizeof(DescriptorData);
+        entry.stride = sizeof(DescriptorData);
+        entries.push_back(entry);
+
+        DescriptorData descriptor{};
+        if (w.pBufferInfo) {
+            descriptor.buffer = *w.pBufferInfo;
+        } else {
+            descriptor.image = *w.pImageInfo;
+        }
+        data.push_back(descriptor);
+    }
+
+    VkDescriptorUpdateTemplate updateTemplate = _cache->createUpdateTemplate(setLayout, entries);
+    vkUpdateDescriptorSetWithTemplate(_device->_logicalDevice, set, updateTemplate, data.data());
+
+    return true;
+}
+
+/**
+ * Record descriptors into the command buffer, no descriptor set is allocated.
+ * Set layout must have been created with the push descriptor flag.
+ * @brief push descriptors (VK_KHR_push_descriptor)
+ * @param cmd command buffer
+ * @param bindPoint pipeline bind point
+ * @param pipelineLayout pipeline layout using the push descriptor set layout
+ * @param set index of the pushed set in the pipeline layout
+ */
+void DescriptorBuilder::push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set) {
+    _device->_vkCmdPushDescriptorSet(cmd, bindPoint, pipelineLayout, set, static_cast<uint32_t>(_writes.size()), _writes.data());
+}
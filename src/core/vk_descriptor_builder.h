@@ -14,32 +14,48 @@
 struct DescriptorLayoutCache;
 
 class DescriptorAllocator;
+class Device;
 
 /**
  * DescriptorBuilder is a set of tools to bind different resources (ie. buffer, images), generate a descriptor layout
  * and create descriptor set which will be used in different shader stages.
  * Number of descriptor sets which can be bound is limited (ie. 8 for Mac)
+ * Descriptors can be written through vkUpdateDescriptorSets, an update template, or pushed into a command buffer
+ * (VK_KHR_push_descriptor) for bindings changing every frame.
  * @brief descriptor set builder
  * @note each method return a reference to the instance in a functional fashion.
  */
 class DescriptorBuilder final {
 public:
     static DescriptorBuilder begin(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator);
+    static DescriptorBuilder begin(const Device& device);
 
     DescriptorBuilder& bind_buffer(VkDescriptorBufferInfo& bufferInfo, VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
     DescriptorBuilder& bind_image(VkDescriptorImageInfo& iInfo, VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
     DescriptorBuilder& bind_none(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
-    DescriptorBuilder& layout(VkDescriptorSetLayout& setLayout);
+    DescriptorBuilder& layout(VkDescriptorSetLayout& setLayout, VkDescriptorSetLayoutCreateFlags flags = 0);
+    DescriptorBuilder& shared();
 
     bool build(VkDescriptorSet& set, VkDescriptorSetLayout& layout, std::vector<VkDescriptorPoolSize> sizes);
+    bool build_with_template(VkDescriptorSet& set, VkDescriptorSetLayout& layout, std::vector<VkDescriptorPoolSize> sizes);
+    void push(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set);
 
 private:
+    /** @brief raw descriptor read by update templates */
+    union DescriptorData {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+    };
+
     /** @brief collection of write operation descriptions (ie. destination set, binding, pointer to image, buffer...)*/
     std::vector<VkWriteDescriptorSet> _writes;
     /** @brief collection of bindings used to create a descriptor set */
     std::vector<VkDescriptorSetLayoutBinding> _bindings;
+    /** @brief reuse an identical descriptor set of the allocator */
+    bool _shared = false;
 
     /** @brief descriptor set layout wrapper + caching */
-    DescriptorLayoutCache* _cache;
-    DescriptorAllocator* _alloc;
+    DescriptorLayoutCache* _cache = nullptr;
+    DescriptorAllocator* _alloc = nullptr;
+    const class Device* _device = nullptr;
 };
\ No newline at end of file
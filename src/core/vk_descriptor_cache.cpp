@@ -7,15 +7,28 @@
 */
 
 #include "vk_descriptor_cache.h"
+#include "core/vk_pipeline_layout_cache.h"
+#include "core/vk_pipeline_library.h"
+#include "core/utilities/vk_helpers.h"
 
 #include <algorithm>
+#include <mutex>
 
 /**
- * Delete every descriptor set layout.
+ * Delete every descriptor set layout. Pipeline layouts built from them are evicted from the pipeline layout cache,
+ * and the pipeline library parts built with these layouts from the library.
  * @brief default destructor
  */
 DescriptorLayoutCache::~DescriptorLayoutCache() {
+    for (auto& updateTemplate : templates) {
+        vkDestroyDescriptorUpdateTemplate(_device._logicalDevice, updateTemplate.second, nullptr);
+    }
     for (auto setLayout : cache) {
+        for (auto layout : _device._pipelineLayoutCache->evict(setLayout.second)) {
+            if (_device._pipelineLibrary) {
+                _device._pipelineLibrary->evict(layout);
+            }
+        }
         vkDestroyDescriptorSetLayout(_device._logicalDevice, setLayout.second, nullptr);
     }
 }
@@ -24,12 +37,14 @@ DescriptorLayoutCache::~DescriptorLayoutCache() {
  * Create descriptor set layout from list of bindings provided.
  * Each individual descriptor binding is specified by a descriptor type, number of
  * descriptors in the binding, a set of shader stages that can access the binding.
+ * Thread safe.
  * @brief create & cache or return cached descriptor set layout
  * @param info parameters of a newly created descriptor set layout. Contains list of bindings.
  * @return descriptor set layout
  */
 VkDescriptorSetLayout DescriptorLayoutCache::createDescriptorLayout(VkDescriptorSetLayoutCreateInfo& info) {
     DescriptorLayoutInfo layoutInfo;
+    layoutInfo._flags = info.flags;
     bool sorted = true;
     int lastBinding = -1;
 
@@ -50,26 +65,74 @@ VkDescriptorSetLayout DescriptorLayoutCache::createDescriptorLayout(VkDescriptor
         });
     }
 
-    auto it = cache.find(layoutInfo); // use overload operator () with hash
-    if (it != cache.end()){
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = cache.find(layoutInfo); // use overload operator () with hash
+        if (it != cache.end()) {
+            return (*it).second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    auto it = cache.find(layoutInfo); // created by another thread in between
+    if (it != cache.end()) {
+        return (*it).second;
+    }
+
+    VkDescriptorSetLayout setLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(_device._logicalDevice, &info, nullptr, &setLayout));
+    cache.emplace(std::move(layoutInfo), setLayout);
+    return setLayout;
+}
+
+/**
+ * Descriptor update template describes how to read descriptors from raw memory, so a descriptor set
+ * can be updated without building write descriptor structures.
+ * Thread safe.
+ * @brief create & cache or return cached descriptor update template
+ * @param setLayout descriptor set layout of the updated sets
+ * @param entries update template entries
+ * @return descriptor update template
+ */
+VkDescriptorUpdateTemplate DescriptorLayoutCache::createUpdateTemplate(VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries) {
+    UpdateTemplateInfo templateInfo{setLayout, entries};
+
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = templates.find(templateInfo);
+        if (it != templates.end()) {
+            return (*it).second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    auto it = templates.find(templateInfo);
+    if (it != templates.end()) {
         return (*it).second;
-    } else {
-        VkDescriptorSetLayout setLayout;
-        vkCreateDescriptorSetLayout(_device._logicalDevice, &info, nullptr, &setLayout);
-        cache[layoutInfo] = setLayout;
-        return setLayout;
     }
+
+    VkDescriptorUpdateTemplateCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    info.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    info.pDescriptorUpdateEntries = entries.data();
+    info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    info.descriptorSetLayout = setLayout;
+
+    VkDescriptorUpdateTemplate updateTemplate;
+    VK_CHECK(vkCreateDescriptorUpdateTemplate(_device._logicalDevice, &info, nullptr, &updateTemplate));
+    templates.emplace(std::move(templateInfo), updateTemplate);
+    return updateTemplate;
 }
 
 /**
- * Determine descriptor set layout equality based on number of bindings, binding index, type of resource,
+ * Determine descriptor set layout equality based on creation flags, number of bindings, binding index, type of resource,
  * number of descriptors and pipeline shader stages with access to this binding.
  * @brief overload DescriptorLayoutInfo operator ==
  * @param other
  * @return
  */
 bool DescriptorLayoutCache::DescriptorLayoutInfo::operator==(DescriptorLayoutCache::DescriptorLayoutInfo const& other) const {
-    if (other._bindings.size() != _bindings.size()){
+    if (other._flags != _flags || other._bindings.size() != _bindings.size()){
         return false;
     } else {
         for (int i = 0; i < _bindings.size(); i++) {
@@ -91,19 +154,59 @@ bool DescriptorLayoutCache::DescriptorLayoutInfo::operator==(DescriptorLayoutCac
 }
 
 /**
- * Hash made from binding, descriptor type, count and stage flags.
+ * Hash made from creation flags, binding, descriptor type, count and stage flags.
+ * Every field is combined in order, bindings don't cancel each other out and large counts are not truncated.
  * @brief Descriptor layout info hash function
  * @return hash
  */
 size_t DescriptorLayoutCache::DescriptorLayoutInfo::hash() const{
-    using std::size_t;
-    using std::hash;
-    size_t result = hash<size_t>()(_bindings.size());
+    size_t result = std::hash<size_t>()(_bindings.size());
+    helper::hash_combine(result, _flags);
 
     for (const VkDescriptorSetLayoutBinding& b : _bindings) {
-        size_t binding_hash = b.binding | b.descriptorType << 8 | b.descriptorCount << 16 | b.stageFlags << 24;
-        result ^= hash<size_t>()(binding_hash);
+        helper::hash_combine(result, b.binding);
+        helper::hash_combine(result, static_cast<uint32_t>(b.descriptorType));
+        helper::hash_combine(result, b.descriptorCount);
+        helper::hash_combine(result, b.stageFlags);
+    }
+
+    return result;
+}
+
+/**
+ * @brief overload UpdateTemplateInfo operator ==
+ * @param other
+ * @return true if same layout and entries
+ */
+bool DescriptorLayoutCache::UpdateTemplateInfo::operator==(const UpdateTemplateInfo& other) const {
+    if (other._setLayout != _setLayout || other._entries.size() != _entries.size()) {
+        return false;
     }
+    for (size_t i = 0; i < _entries.size(); i++) {
+        const VkDescriptorUpdateTemplateEntry& a = _entries[i];
+        const VkDescriptorUpdateTemplateEntry& b = other._entries[i];
+        if (a.dstBinding != b.dstBinding || a.dstArrayElement != b.dstArrayElement || a.descriptorCount != b.descriptorCount ||
+            a.descriptorType != b.descriptorType || a.offset != b.offset || a.stride != b.stride) {
+            return false;
+        }
+    }
+    return true;
+}
 
+/**
+ * Hash made from layout handle and entries.
+ * @brief Update template info hash function
+ * @return hash
+ */
+size_t DescriptorLayoutCache::UpdateTemplateInfo::hash() const {
+    size_t result = std::hash<uint64_t>()(reinterpret_cast<uint64_t>(_setLayout));
+    for (const VkDescriptorUpdateTemplateEntry& e : _entries) {
+        helper::hash_combine(result, e.dstBinding);
+        helper::hash_combine(result, e.dstArrayElement);
+        helper::hash_combine(result, e.descriptorCount);
+        helper::hash_combine(result, static_cast<uint32_t>(e.descriptorType));
+        helper::hash_combine(result, e.offset);
+        helper::hash_combine(result, e.stride);
+    }
     return result;
 }
@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <shared_mutex>
 
 #include "core/utilities/vk_resources.h"
 
@@ -19,6 +20,9 @@ class Device;
  *
  * Descriptor set layout object is defined by an array of zero or more descriptor bindings.
  * Layout is the structure of the descriptor (ie. 2 buffers and 1 image)
+ * Update templates are derived from layouts, they are cached and destroyed with them.
+ * The cache can be shared between threads : lookups take a shared lock, the cache is only locked
+ * exclusively when a new layout has to be created.
  *
  * @brief Descriptor layout wrapper + caching
  */
@@ -28,13 +32,25 @@ public:
     struct DescriptorLayoutInfo {
         /** @brief collection of descriptor set layout bindings */
         std::vector<VkDescriptorSetLayoutBinding> _bindings;
+        /** @brief descriptor set layout creation flags */
+        VkDescriptorSetLayoutCreateFlags _flags = 0;
         bool operator==(const DescriptorLayoutInfo& other) const;
         size_t hash() const;
     };
 
+    /** @brief descriptor update template description */
+    struct UpdateTemplateInfo {
+        VkDescriptorSetLayout _setLayout;
+        /** @brief collection of descriptor update template entries (binding, type, offset into the raw data) */
+        std::vector<VkDescriptorUpdateTemplateEntry> _entries;
+        bool operator==(const UpdateTemplateInfo& other) const;
+        size_t hash() const;
+    };
+
     explicit DescriptorLayoutCache(const Device &device) : _device(device) {};
     ~DescriptorLayoutCache();
     VkDescriptorSetLayout createDescriptorLayout(VkDescriptorSetLayoutCreateInfo& info);
+    VkDescriptorUpdateTemplate createUpdateTemplate(VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries);
 
 private:
     /** @brief hash structure used for descriptor layout caching */
@@ -44,6 +60,15 @@ private:
         }
     };
 
+    struct UpdateTemplateHash {
+        std::size_t operator()(const UpdateTemplateInfo& k) const {
+            return k.hash();
+        }
+    };
+
     const class Device& _device;
+    /** @brief readers / writer lock, layouts are mostly looked up */
+    std::shared_mutex _mutex;
     std::unordered_map<DescriptorLayoutInfo, VkDescriptorSetLayout, DescriptorLayoutHash> cache;
+    std::unordered_map<UpdateTemplateInfo, VkDescriptorUpdateTemplate, UpdateTemplateHash> templates;
 };
\ No newline at end of file
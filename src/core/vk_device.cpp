@@ -12,7 +12,12 @@
 
 #include "vk_device.h"
 #include "vk_window.h"
+#include "vk_pipeline_layout_cache.h"
+#include "vk_pipeline_cache.h"
+#include "vk_pipeline_library.h"
+#include "vk_shader_module_cache.h"
 #include <iostream>
+#include <algorithm>
 
 /**
  * Default Device constructor
@@ -49,16 +54,28 @@ Device::Device(Window& window) {
     VkPhysicalDeviceFeatures required_features {};
     required_features.depthClamp = VK_TRUE;
     required_features.samplerAnisotropy = VK_TRUE;
+    required_features.multiDrawIndirect = VK_TRUE; // indirect draw : several commands per batch
+    required_features.drawIndirectFirstInstance = VK_TRUE; // indirect draw : draw index passed as first instance
 
     // Enable Vulkan features
     VkPhysicalDeviceVulkan11Features features11 = {};
     features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
     features11.shaderDrawParameters = VK_TRUE;
+    features11.multiview = VK_TRUE; // single pass cascaded shadow map
     features11.pNext = nullptr;
 
     VkPhysicalDeviceVulkan12Features features12 = {};
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.hostQueryReset = VK_TRUE;
+    // Descriptor indexing : bindless texture array
+    features12.descriptorIndexing = VK_TRUE;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    // Indirect draw : draw count written by the culling pass
+    features12.drawIndirectCount = VK_TRUE;
     features12.pNext = nullptr;
 
     vkb::PhysicalDevice physicalDevice = selector
@@ -69,13 +86,62 @@ Device::Device(Window& window) {
 //            .add_desired_extension(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME)
 //            .add_desired_extension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
             .add_desired_extension(VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME)
+            .add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+            .add_desired_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)
+            .add_desired_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
+            .add_desired_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)
+            .add_desired_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)
+            .add_desired_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)
             .set_required_features(required_features)
             .set_required_features_11(features11) // Enable selected Vulkan 1.1 features
             .set_required_features_12(features12) // Enable selected Vulkan 1.2 features
             .select(vkb::DeviceSelectionMode::partially_and_fully_suitable)
             .value();
 
+    const std::vector<std::string> extensions = physicalDevice.get_extensions();
+    auto has_extension = [&extensions](const char* name) {
+        return std::find(extensions.begin(), extensions.end(), name) != extensions.end();
+    };
+
+    // Graphics pipeline library : materials link precompiled pipeline parts instead of compiling full pipelines
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures = {};
+    libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    libraryFeatures.pNext = nullptr;
+    if (has_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) && has_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &libraryFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &features2);
+    }
+
+    // Extended dynamic state : rasterization and depth state set per draw, pipeline variants collapse
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures = {};
+    dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    dynamicStateFeatures.pNext = nullptr;
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamicState2Features = {};
+    dynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+    dynamicState2Features.pNext = nullptr;
+    if (has_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) && has_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+        dynamicStateFeatures.pNext = &dynamicState2Features;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &dynamicStateFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &features2);
+        dynamicStateFeatures.pNext = nullptr;
+    }
+    const bool extendedDynamicState = dynamicStateFeatures.extendedDynamicState == VK_TRUE && dynamicState2Features.extendedDynamicState2 == VK_TRUE;
+
     vkb::DeviceBuilder deviceBuilder{ physicalDevice };
+    if (libraryFeatures.graphicsPipelineLibrary == VK_TRUE) {
+        deviceBuilder.add_pNext(&libraryFeatures);
+    }
+    if (extendedDynamicState) {
+        // Only the features used by the engine are enabled
+        dynamicState2Features.extendedDynamicState2LogicOp = VK_FALSE;
+        dynamicState2Features.extendedDynamicState2PatchControlPoints = VK_FALSE;
+        deviceBuilder.add_pNext(&dynamicStateFeatures);
+        deviceBuilder.add_pNext(&dynamicState2Features);
+    }
 
     vkb::Device vkbDevice = deviceBuilder.build().value();
 
@@ -95,12 +161,63 @@ Device::Device(Window& window) {
 //    _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 //    _graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+    // Prefer a transfer-only family (DMA engine), then any non-graphics transfer family, else share the graphics queue.
+    auto transferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+    auto transferIndex = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer);
+    if (!transferQueue || !transferIndex) {
+        transferQueue = vkbDevice.get_queue(vkb::QueueType::transfer);
+        transferIndex = vkbDevice.get_queue_index(vkb::QueueType::transfer);
+    }
+
+    // Texture copies must be allowed at texel granularity, otherwise uploads stay on the graphics queue.
+    bool granularity = false;
+    if (transferQueue && transferIndex) {
+        VkExtent3D extent = vkbDevice.queue_families[transferIndex.value()].minImageTransferGranularity;
+        granularity = (extent.width == 1 && extent.height == 1 && extent.depth == 1);
+    }
+
+    if (granularity && transferIndex.value() != _queue->get_queue_family()) {
+        _transferQueue = std::make_shared<Queue>(transferQueue.value(), transferIndex.value());
+    } else {
+        _transferQueue = _queue;
+    }
+
+    std::cout << "Transfer queue family : " << _transferQueue->get_queue_family() << (has_dedicated_transfer() ? " (dedicated)" : " (graphics)") << std::endl;
+
+    // Push descriptors : per-frame bindings written straight into command buffers
+    _pushDescriptors = has_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+    if (_pushDescriptors) {
+        _vkCmdPushDescriptorSet = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdPushDescriptorSetKHR"));
+        _pushDescriptors = _vkCmdPushDescriptorSet != nullptr;
+    }
+
+    if (extendedDynamicState) {
+        _vkCmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdSetCullModeEXT"));
+        _vkCmdSetFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdSetFrontFaceEXT"));
+        _vkCmdSetDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdSetDepthTestEnableEXT"));
+        _vkCmdSetDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdSetDepthWriteEnableEXT"));
+        _vkCmdSetDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdSetDepthCompareOpEXT"));
+        _vkCmdSetDepthBiasEnable = reinterpret_cast<PFN_vkCmdSetDepthBiasEnableEXT>(vkGetDeviceProcAddr(_logicalDevice, "vkCmdSetDepthBiasEnableEXT"));
+        _extendedDynamicState = _vkCmdSetCullMode && _vkCmdSetFrontFace && _vkCmdSetDepthTestEnable && _vkCmdSetDepthWriteEnable && _vkCmdSetDepthCompareOp && _vkCmdSetDepthBiasEnable;
+    }
+
     // Initialize memory allocator
     VmaAllocatorCreateInfo allocatorInfo = {};
     allocatorInfo.physicalDevice = _physicalDevice;
     allocatorInfo.device = _logicalDevice;
     allocatorInfo.instance = _instance;
+    if (has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT; // heap budget queried from the driver
+    }
     vmaCreateAllocator(&allocatorInfo, &_allocator);
+
+    _pipelineLayoutCache = std::make_unique<PipelineLayoutCache>(_logicalDevice);
+    _pipelineCache = std::make_unique<PipelineCache>(_logicalDevice, _gpuProperties, "pipeline_cache.bin");
+    _shaderModuleCache = std::make_unique<ShaderModuleCache>(_logicalDevice);
+    if (libraryFeatures.graphicsPipelineLibrary == VK_TRUE) {
+        _pipelineLibrary = std::make_unique<PipelineLibrary>(_logicalDevice);
+    }
+    std::cout << "Graphics pipeline library : " << (_pipelineLibrary ? "enabled" : "not supported, monolithic pipelines") << std::endl;
 }
 
 Device::~Device() {
@@ -128,4 +245,20 @@ VkQueue Device::get_graphics_queue() const {
 uint32_t Device::get_graphics_queue_family() const {
     // return _graphicsQueueFamily;
     return _queue->get_queue_family();
+}
+
+/**
+ * Get transfer queue index
+ * @return transfer queue family, equal to graphics queue family when no dedicated transfer queue is available
+ */
+uint32_t Device::get_transfer_queue_family() const {
+    return _transferQueue->get_queue_family();
+}
+
+/**
+ * Uploads submitted to a dedicated transfer queue need a queue family ownership transfer
+ * @return true if transfer queue family differs from graphics queue family
+ */
+bool Device::has_dedicated_transfer() const {
+    return _transferQueue->get_queue_family() != _queue->get_queue_family();
 }
\ No newline at end of file
@@ -13,6 +13,10 @@
 #include <memory>
 
 class Window;
+class PipelineLayoutCache;
+class PipelineCache;
+class PipelineLibrary;
+class ShaderModuleCache;
 
 /**
  * Class wrapping Vulkan physical and logical device representations
@@ -38,12 +42,37 @@ public:
     VmaAllocator _allocator;
     /** @brief Device queue */
     std::shared_ptr<Queue> _queue;
+    /** @brief Transfer queue used for uploads. Alias of graphics queue when no dedicated transfer family exists */
+    std::shared_ptr<Queue> _transferQueue;
+    /** @brief VK_KHR_push_descriptor enabled : descriptors can be pushed into command buffers */
+    bool _pushDescriptors = false;
+    /** @brief push descriptor command, null when push descriptors are not supported */
+    PFN_vkCmdPushDescriptorSetKHR _vkCmdPushDescriptorSet = nullptr;
+    /** @brief VK_EXT_extended_dynamic_state and _state2 enabled : cull mode, front face, depth and depth bias states can be dynamic */
+    bool _extendedDynamicState = false;
+    /** @brief extended dynamic state commands, null when extended dynamic state is not supported */
+    PFN_vkCmdSetCullModeEXT _vkCmdSetCullMode = nullptr;
+    PFN_vkCmdSetFrontFaceEXT _vkCmdSetFrontFace = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT _vkCmdSetDepthTestEnable = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT _vkCmdSetDepthWriteEnable = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT _vkCmdSetDepthCompareOp = nullptr;
+    PFN_vkCmdSetDepthBiasEnableEXT _vkCmdSetDepthBiasEnable = nullptr;
+    /** @brief Pipeline layouts shared by every pipeline */
+    std::unique_ptr<PipelineLayoutCache> _pipelineLayoutCache;
+    /** @brief Pipeline cache shared by every pipeline, persisted on disk */
+    std::unique_ptr<PipelineCache> _pipelineCache;
+    /** @brief Graphics pipeline parts linked into materials, null when VK_EXT_graphics_pipeline_library is not supported */
+    std::unique_ptr<PipelineLibrary> _pipelineLibrary;
+    /** @brief Shader modules shared by every pipeline */
+    std::unique_ptr<ShaderModuleCache> _shaderModuleCache;
 
     explicit Device(Window& _window);
     ~Device();
 
     VkQueue get_graphics_queue() const;
     uint32_t get_graphics_queue_family() const;
+    uint32_t get_transfer_queue_family() const;
+    bool has_dedicated_transfer() const;
 
 private:
 
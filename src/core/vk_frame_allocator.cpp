@@ -0,0 +1,56 @@
+/*
+*  H2Vk - FrameAllocator class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_frame_allocator.h"
+#include <cstring>
+#include <stdexcept>
+
+/**
+ * Allocate persistently mapped buffer used by the arena
+ * @param device vulkan device wrapper
+ * @param capacity buffer size in bytes
+ * @param usage buffer usage (uniform buffer by default)
+ */
+void FrameAllocator::init(const Device& device, VkDeviceSize capacity, VkBufferUsageFlags usage) {
+    _alignment = std::max<VkDeviceSize>(device._gpuProperties.limits.minUniformBufferOffsetAlignment, 1);
+    _capacity = capacity;
+    _offset = 0;
+
+    Buffer::create_buffer(device, &_buffer, capacity, usage, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+}
+
+/**
+ * Bump allocate an aligned slice and copy data into it
+ * @param data source
+ * @param size number of bytes to copy
+ * @return offset of the slice, to be used as dynamic offset
+ */
+uint32_t FrameAllocator::push(const void* data, size_t size) {
+    VkDeviceSize offset = (_offset + _alignment - 1) & ~(_alignment - 1);
+    if (offset + size > _capacity) {
+        throw std::runtime_error("Frame allocator capacity exceeded");
+    }
+
+    std::memcpy(static_cast<char*>(_buffer._data) + offset, data, size);
+    _offset = offset + size;
+
+    return static_cast<uint32_t>(offset);
+}
+
+/**
+ * @brief release all slices. Only call once GPU finished reading the frame.
+ */
+void FrameAllocator::reset() {
+    _offset = 0;
+}
+
+void FrameAllocator::destroy() {
+    _buffer.destroy();
+    _offset = 0;
+    _capacity = 0;
+}
@@ -0,0 +1,50 @@
+/*
+*  H2Vk - FrameAllocator class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include "core/vk_buffer.h"
+
+class Device;
+
+/**
+ * Linear allocator over a persistently mapped uniform buffer, one per frame in flight.
+ * Data are written at aligned offsets then bound with dynamic descriptor offsets.
+ * Allocator is reset once the frame fence has been signaled.
+ * @brief per-frame uniform arena
+ */
+class FrameAllocator final {
+public:
+    /** @brief default arena capacity in bytes */
+    static const VkDeviceSize CAPACITY = 64 * 1024;
+
+    /** @brief persistently mapped uniform buffer */
+    AllocatedBuffer _buffer;
+
+    void init(const Device& device, VkDeviceSize capacity = CAPACITY, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    uint32_t push(const void* data, size_t size);
+    void reset();
+    void destroy();
+
+    /**
+     * @brief copy structure into the arena
+     * @return offset of the written slice
+     */
+    template<typename T>
+    uint32_t push(const T& data) {
+        return push(&data, sizeof(T));
+    }
+
+private:
+    /** @brief minimum alignment of slices (minUniformBufferOffsetAlignment) */
+    VkDeviceSize _alignment = 256;
+    /** @brief buffer size in bytes */
+    VkDeviceSize _capacity = 0;
+    /** @brief next free byte */
+    VkDeviceSize _offset = 0;
+};
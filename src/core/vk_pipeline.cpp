@@ -8,13 +8,22 @@
 
 
 #include <iostream>
+#include <chrono>
+#include <array>
+#include <map>
+#include <algorithm>
 
 #include "vk_pipeline.h"
 #include "vk_device.h"
+#include "vk_pipeline_layout_cache.h"
+#include "vk_pipeline_cache.h"
+#include "vk_pipeline_library.h"
+#include "vk_shader_module_cache.h"
 #include "vk_renderpass.h"
 #include "components/model/vk_model.h"
 #include "core/utilities/vk_helpers.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/utilities/vk_memory_statistics.h"
 
 /**
  * Build objects required to generate a pipeline layout (information about the shader inputs of the pipeline).
@@ -39,12 +48,74 @@ std::shared_ptr<ShaderEffect> PipelineBuilder::build_effect(std::vector<VkDescri
             std::cout << "Error when building the shader module" << std::string(second) << std::endl;
         }
 
-        effect->shaderStages.push_back(ShaderEffect::ShaderStage{first, shader, third});
+        effect->shaderStages.push_back(ShaderEffect::ShaderStage{first, shader, third, second});
     }
 
+    this->reflect_layout(*effect);
+
     return effect;
 }
 
+/**
+ * Push constant ranges are merged into one range per stage, covering both the declared ranges and the block read by
+ * the stage SPIR-V, and sorted by stage : equivalent layouts written differently by callers share the same cached
+ * pipeline layout. Declared ranges are kept as a whole, recorded push constant updates stay valid.
+ * Descriptor bindings read by the shaders are checked against the declared set layouts.
+ * @brief canonicalize the pipeline layout of an effect from the shader reflection
+ * @param effect shader effect, push constant ranges are replaced
+ */
+void PipelineBuilder::reflect_layout(ShaderEffect& effect) const {
+    std::map<VkShaderStageFlags, std::pair<uint32_t, uint32_t>> ranges; // stage : begin, end
+    auto merge = [&ranges](VkShaderStageFlags stages, uint32_t begin, uint32_t end) {
+        for (VkShaderStageFlags bit = 1; bit <= stages; bit <<= 1u) {
+            if ((stages & bit) == 0) {
+                continue;
+            }
+            auto it = ranges.find(bit);
+            if (it == ranges.end()) {
+                ranges.emplace(bit, std::make_pair(begin, end));
+            } else {
+                it->second.first = std::min(it->second.first, begin);
+                it->second.second = std::max(it->second.second, end);
+            }
+        }
+    };
+
+    for (const auto& range : effect.pushConstants) {
+        merge(range.stageFlags, range.offset, range.offset + range.size);
+    }
+
+    for (const auto& stage : effect.shaderStages) {
+        const ShaderReflection* reflection = _device._shaderModuleCache->reflection(stage.shaderModule);
+        if (reflection == nullptr) {
+            continue;
+        }
+        if (reflection->_pushConstants) {
+            merge(stage.flags, reflection->_pushOffset, reflection->_pushOffset + reflection->_pushSize);
+        }
+        for (const auto& binding : reflection->_bindings) {
+            if (binding.set >= effect.setLayouts.size() || effect.setLayouts.at(binding.set) == VK_NULL_HANDLE) {
+                std::cout << "Shader " << stage.source << " reads binding " << binding.binding << " of set " << binding.set << " missing from the pipeline layout" << std::endl;
+            }
+        }
+    }
+
+    // Stages sharing the same range are declared once
+    std::vector<VkPushConstantRange> pushConstants;
+    for (const auto& [stage, range] : ranges) {
+        auto same = std::find_if(pushConstants.begin(), pushConstants.end(), [&range = range](const VkPushConstantRange& r) {
+            return r.offset == range.first && r.offset + r.size == range.second;
+        });
+        if (same != pushConstants.end()) {
+            same->stageFlags |= stage;
+        } else {
+            pushConstants.push_back(VkPushConstantRange{stage, range.first, range.second - range.first});
+        }
+    }
+
+    effect.pushConstants = pushConstants;
+}
+
 /**
  * Build the pipeline
  * @brief Build specialized pipeline
@@ -58,34 +129,50 @@ std::shared_ptr<ShaderPass> PipelineBuilder::build_pass(std::shared_ptr<ShaderEf
     pass->_device = _device._logicalDevice;
 
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages{}; // create pipeline shader stage information
+    std::vector<std::string> stageKeys{};
     for (auto& stage : pass->effect->shaderStages) {
         shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(stage.flags, stage.shaderModule, &stage.specializationConstants));
+        stageKeys.push_back(stage_key(stage));
     }
 
-    pass->pipeline =  this->build_pipeline(pass->pipelineLayout, shaderStages);
+    pass->pipeline =  this->build_pipeline(pass->pipelineLayout, shaderStages, stageKeys);
+    pass->dynamicRaster = this->raster_state(pass->rasterState);
 
     return pass;
 }
 
+/**
+ * A stage is identified by its source and specialization, stable across runs unlike module handles.
+ * @brief shader stage key
+ * @param stage shader stage
+ * @return shader stage as a byte string
+ */
+std::string PipelineBuilder::stage_key(const ShaderEffect::ShaderStage& stage) {
+    std::string key;
+    helper::append_key(key, stage.flags);
+    key.append(stage.source).push_back('\0');
+    const VkSpecializationInfo& specialization = stage.specializationConstants;
+    for (uint32_t i = 0; i < specialization.mapEntryCount; i++) {
+        helper::append_key(key, specialization.pMapEntries[i]);
+    }
+    if (specialization.dataSize > 0) {
+        key.append(static_cast<const char*>(specialization.pData), specialization.dataSize);
+    }
+
+    return key;
+}
+
 /**
  * The pipeline layout contains information about the shader inputs of the pipeline.
  * It represents sequence of descriptor sets and push constants used.
+ * Layouts are shared through the device pipeline layout cache.
  * @brief build pipeline layout
  * @param setLayouts
  * @param pushConstants
  * @return return the pipeline layout
  */
 VkPipelineLayout PipelineBuilder::build_layout(std::vector<VkDescriptorSetLayout> &setLayouts, std::vector<VkPushConstantRange> &pushConstants) const {
-    VkPipelineLayout layout{};
-    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
-    layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
-    layoutInfo.pSetLayouts = setLayouts.empty() ? nullptr : setLayouts.data(); // descriptor set layouts
-    layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
-    layoutInfo.pPushConstantRanges = pushConstants.empty() ? nullptr : pushConstants.data(); // push constants
-
-    VK_CHECK(vkCreatePipelineLayout(_device._logicalDevice, &layoutInfo, nullptr, &layout));
-
-    return layout;
+    return _device._pipelineLayoutCache->createPipelineLayout(setLayouts, pushConstants);
 }
 
 /**
@@ -113,32 +200,61 @@ GraphicPipeline::GraphicPipeline(const Device& device, RenderPass& renderPass) :
 }
 
 
+/**
+ * Viewport and scissor are dynamic : only their count is part of the pipeline.
+ * @brief viewport state shared by every graphics pipeline
+ */
+static VkPipelineViewportStateCreateInfo viewport_state() {
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.pNext = nullptr;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = nullptr; //&_viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = nullptr;//&_scissor;
+    return viewportState;
+}
+
 /**
  * Set up remaining structures required to build a graphics pipeline.
  * These structures (out of constructor) did not require any changes in other part of the engine.
+ * Pipelines are linked from library parts when supported, built as a whole otherwise.
  * @brief create graphics pipeline
  * @param pipelineLayout represents sequence of descriptor sets and push constants
  * @param shaderStages collection of information for each pipeline shader stages (ie. code, entry point)
+ * @param stageKeys identity of each shader stage, used to find pipeline library parts
+ * @return graphics pipeline
+ */
+VkPipeline GraphicPipeline::build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys) {
+    if (_device._pipelineLibrary) {
+        VkPipeline pipeline = build_linked(pipelineLayout, shaderStages, stageKeys);
+        if (pipeline != VK_NULL_HANDLE) {
+            return pipeline;
+        }
+        std::cout << "Failed to link graphics pipeline, fallback to a monolithic pipeline\n";
+    }
+
+    return build_monolithic(pipelineLayout, shaderStages);
+}
+
+/**
+ * @brief create graphics pipeline with every state and shader compiled together
+ * @param pipelineLayout represents sequence of descriptor sets and push constants
+ * @param shaderStages collection of information for each pipeline shader stages (ie. code, entry point)
  * @return graphics pipeline
  */
-VkPipeline GraphicPipeline::build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) {
+VkPipeline GraphicPipeline::build_monolithic(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) {
 
     VkPipeline pipeline;
 
+    VkPipelineViewportStateCreateInfo viewportState = viewport_state();
 
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.pNext = nullptr;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = nullptr; //&_viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = nullptr;//&_scissor;
-
+    const std::vector<VkDynamicState> dynamicStates = dynamic_states();
     VkPipelineDynamicStateCreateInfo dynamicState{};
     dynamicState.pNext = nullptr;
     dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = _dynamicStateEnables.size();
-    dynamicState.pDynamicStates = _dynamicStateEnables.data();
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
     dynamicState.flags = 0;
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
@@ -159,21 +275,343 @@ VkPipeline GraphicPipeline::build_pipeline(VkPipelineLayout& pipelineLayout, std
     pipelineInfo.renderPass = _renderPass._renderPass;
     pipelineInfo.subpass = 0; // index of sub-pass in the render pass where pipeline is used (single sub-pass so far)
 
-    if (vkCreateGraphicsPipelines(_device._logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (vkCreateGraphicsPipelines(_device._logicalDevice, _device._pipelineCache->_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         std::cout << "Failed to create graphics pipeline\n";
         return VK_NULL_HANDLE;
     }
+    _device._pipelineCache->record(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    MemoryStatistics::created(ObjectCategory::PIPELINE);
+
+    return pipeline;
+}
+
+/**
+ * Vertex input and fragment output parts only depend on fixed-function state and are shared by most materials.
+ * Shader parts are shared by materials using the same shaders, layout and state. Missing parts are compiled,
+ * then parts are linked without link time optimization : linking is fast compared to a full compilation.
+ * @brief create graphics pipeline from pipeline library parts
+ * @param pipelineLayout represents sequence of descriptor sets and push constants
+ * @param shaderStages collection of information for each pipeline shader stages (ie. code, entry point)
+ * @param stageKeys identity of each shader stage
+ * @return graphics pipeline, VK_NULL_HANDLE if a part could not be compiled or linked
+ */
+VkPipeline GraphicPipeline::build_linked(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys) {
+    PipelineLibrary& library = *_device._pipelineLibrary;
+
+    VkPipelineViewportStateCreateInfo viewportState = viewport_state();
+
+    const std::vector<VkDynamicState> dynamicStates = dynamic_states();
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.pNext = nullptr;
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+    dynamicState.flags = 0;
+
+    std::string dynamicKey;
+    for (auto state : dynamicStates) {
+        helper::append_key(dynamicKey, state);
+    }
+
+    // Fragment stage goes to the fragment shader part, every other stage to the pre-rasterization part
+    std::vector<VkPipelineShaderStageCreateInfo> preRasterizationStages;
+    std::vector<VkPipelineShaderStageCreateInfo> fragmentStages;
+    std::string preRasterizationKey = pre_rasterization_key() + dynamicKey;
+    std::string fragmentKey = fragment_shader_key() + dynamicKey;
+    helper::append_key(preRasterizationKey, pipelineLayout);
+    helper::append_key(fragmentKey, pipelineLayout);
+    for (size_t i = 0; i < shaderStages.size(); i++) {
+        if (shaderStages[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+            fragmentStages.push_back(shaderStages[i]);
+            fragmentKey.append(stageKeys[i]);
+        } else {
+            preRasterizationStages.push_back(shaderStages[i]);
+            preRasterizationKey.append(stageKeys[i]);
+        }
+    }
+
+    VkGraphicsPipelineCreateInfo partInfo{};
+    partInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    partInfo.pDynamicState = &dynamicState;
+    partInfo.renderPass = _renderPass._renderPass;
+    partInfo.subpass = 0;
+
+    std::array<VkPipeline, 4> parts{};
+    parts[0] = library.get_part(vertex_input_key() + dynamicKey, [&]() {
+        VkGraphicsPipelineCreateInfo info = partInfo;
+        info.pVertexInputState = &_vertexInputInfo;
+        info.pInputAssemblyState = &_inputAssembly;
+        return build_part(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, info);
+    });
+    parts[1] = library.get_part(preRasterizationKey, [&]() {
+        VkGraphicsPipelineCreateInfo info = partInfo;
+        info.stageCount = static_cast<uint32_t>(preRasterizationStages.size());
+        info.pStages = preRasterizationStages.data();
+        info.pViewportState = &viewportState;
+        info.pRasterizationState = &_rasterizer;
+        info.layout = pipelineLayout;
+        return build_part(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, info);
+    }, pipelineLayout, _renderPass._renderPass);
+    parts[2] = library.get_part(fragmentKey, [&]() {
+        VkGraphicsPipelineCreateInfo info = partInfo;
+        info.stageCount = static_cast<uint32_t>(fragmentStages.size());
+        info.pStages = fragmentStages.empty() ? nullptr : fragmentStages.data();
+        info.pDepthStencilState = &_depthStencil;
+        info.pMultisampleState = &_multisampling;
+        info.layout = pipelineLayout;
+        return build_part(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, info);
+    }, pipelineLayout, _renderPass._renderPass);
+    parts[3] = library.get_part(fragment_output_key() + dynamicKey, [&]() {
+        VkGraphicsPipelineCreateInfo info = partInfo;
+        info.pColorBlendState = &_colorBlending;
+        info.pMultisampleState = &_multisampling;
+        return build_part(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, info);
+    }, VK_NULL_HANDLE, _renderPass._renderPass);
+
+    for (auto part : parts) {
+        if (part == VK_NULL_HANDLE) {
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    VkPipelineLibraryCreateInfoKHR linkInfo{};
+    linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    linkInfo.pNext = nullptr;
+    linkInfo.libraryCount = static_cast<uint32_t>(parts.size());
+    linkInfo.pLibraries = parts.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &linkInfo;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = _renderPass._renderPass;
+    pipelineInfo.subpass = 0;
+
+    VkPipeline pipeline;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (vkCreateGraphicsPipelines(_device._logicalDevice, _device._pipelineCache->_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        std::cout << "Failed to link graphics pipeline\n";
+        return VK_NULL_HANDLE;
+    }
+    _device._pipelineCache->record(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    MemoryStatistics::created(ObjectCategory::PIPELINE);
+    library.linked();
+
+    return pipeline;
+}
+
+/**
+ * @brief compile a single pipeline library part
+ * @param part graphics pipeline library part flag
+ * @param pipelineInfo states and shaders of the part
+ * @return pipeline library part
+ */
+VkPipeline GraphicPipeline::build_part(VkGraphicsPipelineLibraryFlagsEXT part, VkGraphicsPipelineCreateInfo pipelineInfo) const {
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    libraryInfo.pNext = nullptr;
+    libraryInfo.flags = part;
+
+    pipelineInfo.pNext = &libraryInfo;
+    pipelineInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+
+    VkPipeline pipeline;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (vkCreateGraphicsPipelines(_device._logicalDevice, _device._pipelineCache->_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create graphics pipeline library part\n";
+        return VK_NULL_HANDLE;
+    }
+    _device._pipelineCache->record(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    MemoryStatistics::created(ObjectCategory::PIPELINE);
 
     return pipeline;
 }
 
+/**
+ * With dynamic rasterization, extended dynamic states are added to the states set by _dynamicStateEnables.
+ * @brief dynamic states of the built pipelines
+ * @return collection of dynamic states
+ */
+std::vector<VkDynamicState> GraphicPipeline::dynamic_states() const {
+    std::vector<VkDynamicState> states = _dynamicStateEnables;
+    if (_dynamicRaster && _device._extendedDynamicState) {
+        states.insert(states.end(), {
+            VK_DYNAMIC_STATE_CULL_MODE_EXT,
+            VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT,
+            VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_BIAS
+        });
+    }
+
+    return states;
+}
+
+/**
+ * @brief rasterization and depth state set per draw
+ * @param state filled with the current rasterizer and depth stencil state
+ * @return true if the built pipelines use extended dynamic state
+ */
+bool GraphicPipeline::raster_state(DynamicRasterState& state) const {
+    if (!_dynamicRaster || !_device._extendedDynamicState) {
+        return false;
+    }
+
+    state.cullMode = _rasterizer.cullMode;
+    state.frontFace = _rasterizer.frontFace;
+    state.depthTestEnable = _depthStencil.depthTestEnable;
+    state.depthWriteEnable = _depthStencil.depthWriteEnable;
+    state.depthCompareOp = _depthStencil.depthCompareOp;
+    state.depthBiasEnable = _rasterizer.depthBiasEnable;
+    state.depthBiasConstantFactor = _rasterizer.depthBiasConstantFactor;
+    state.depthBiasClamp = _rasterizer.depthBiasClamp;
+    state.depthBiasSlopeFactor = _rasterizer.depthBiasSlopeFactor;
+    return true;
+}
+
+/**
+ * Must follow vkCmdBindPipeline. Does nothing for passes built without dynamic rasterization.
+ * @brief set rasterization and depth state of a material
+ * @param device vulkan device wrapper
+ * @param cmd command buffer
+ * @param pass bound material
+ */
+void GraphicPipeline::set_raster_state(const Device& device, VkCommandBuffer cmd, const ShaderPass& pass) {
+    if (!pass.dynamicRaster) {
+        return;
+    }
+
+    const DynamicRasterState& state = pass.rasterState;
+    device._vkCmdSetCullMode(cmd, state.cullMode);
+    device._vkCmdSetFrontFace(cmd, state.frontFace);
+    device._vkCmdSetDepthTestEnable(cmd, state.depthTestEnable);
+    device._vkCmdSetDepthWriteEnable(cmd, state.depthWriteEnable);
+    device._vkCmdSetDepthCompareOp(cmd, state.depthCompareOp);
+    device._vkCmdSetDepthBiasEnable(cmd, state.depthBiasEnable);
+    vkCmdSetDepthBias(cmd, state.depthBiasConstantFactor, state.depthBiasClamp, state.depthBiasSlopeFactor);
+}
+
+/**
+ * Every field read by build_pipeline, except the pipeline layout and shader stages.
+ * Pipelines built with equal state keys, layouts and shaders are identical.
+ * Dynamic rasterization and depth states are excluded : pipelines differing only by them are shared.
+ * @brief fixed-function state key
+ * @return graphics pipeline state as a byte string
+ */
+std::string GraphicPipeline::state_key() const {
+    std::string key = "graphics";
+    key.append(vertex_input_key());
+    key.append(pre_rasterization_key());
+    key.append(fragment_shader_key());
+    key.append(fragment_output_key());
+
+    for (auto state : dynamic_states()) {
+        helper::append_key(key, state);
+    }
+
+    return key;
+}
+
+/**
+ * @brief vertex input interface state key
+ * @return vertex input and input assembly states as a byte string
+ */
+std::string GraphicPipeline::vertex_input_key() const {
+    std::string key = "vertex input";
+    helper::append_key(key, _inputAssembly.topology);
+    helper::append_key(key, _inputAssembly.primitiveRestartEnable);
+
+    for (uint32_t i = 0; i < _vertexInputInfo.vertexBindingDescriptionCount; i++) {
+        helper::append_key(key, _vertexInputInfo.pVertexBindingDescriptions[i]);
+    }
+    for (uint32_t i = 0; i < _vertexInputInfo.vertexAttributeDescriptionCount; i++) {
+        helper::append_key(key, _vertexInputInfo.pVertexAttributeDescriptions[i]);
+    }
+
+    return key;
+}
+
+/**
+ * @brief pre-rasterization state key, shaders and dynamic states excluded
+ * @return render pass and rasterization state as a byte string
+ */
+std::string GraphicPipeline::pre_rasterization_key() const {
+    std::string key = "pre-rasterization";
+    helper::append_key(key, _renderPass._renderPass);
+    helper::append_key(key, _rasterizer.depthClampEnable);
+    helper::append_key(key, _rasterizer.rasterizerDiscardEnable);
+    helper::append_key(key, _rasterizer.polygonMode);
+    helper::append_key(key, _rasterizer.lineWidth);
+    if (!_dynamicRaster || !_device._extendedDynamicState) {
+        helper::append_key(key, _rasterizer.cullMode);
+        helper::append_key(key, _rasterizer.frontFace);
+        helper::append_key(key, _rasterizer.depthBiasEnable);
+        helper::append_key(key, _rasterizer.depthBiasConstantFactor);
+        helper::append_key(key, _rasterizer.depthBiasClamp);
+        helper::append_key(key, _rasterizer.depthBiasSlopeFactor);
+    }
+
+    return key;
+}
+
+/**
+ * @brief fragment shader state key, shaders and dynamic states excluded
+ * @return render pass, depth stencil and multisample states as a byte string
+ */
+std::string GraphicPipeline::fragment_shader_key() const {
+    std::string key = "fragment shader";
+    helper::append_key(key, _renderPass._renderPass);
+    if (!_dynamicRaster || !_device._extendedDynamicState) {
+        helper::append_key(key, _depthStencil.depthTestEnable);
+        helper::append_key(key, _depthStencil.depthWriteEnable);
+        helper::append_key(key, _depthStencil.depthCompareOp);
+    }
+    helper::append_key(key, _depthStencil.depthBoundsTestEnable);
+    helper::append_key(key, _depthStencil.stencilTestEnable);
+    helper::append_key(key, _depthStencil.front);
+    helper::append_key(key, _depthStencil.back);
+    helper::append_key(key, _depthStencil.minDepthBounds);
+    helper::append_key(key, _depthStencil.maxDepthBounds);
+    helper::append_key(key, _multisampling.rasterizationSamples);
+    helper::append_key(key, _multisampling.sampleShadingEnable);
+    helper::append_key(key, _multisampling.minSampleShading);
+
+    return key;
+}
+
+/**
+ * @brief fragment output interface state key
+ * @return render pass, color blend and multisample states as a byte string
+ */
+std::string GraphicPipeline::fragment_output_key() const {
+    std::string key = "fragment output";
+    helper::append_key(key, _renderPass._renderPass);
+    helper::append_key(key, _colorBlending.logicOpEnable);
+    helper::append_key(key, _colorBlending.logicOp);
+    helper::append_key(key, _colorBlending.blendConstants);
+    for (uint32_t i = 0; i < _colorBlending.attachmentCount; i++) {
+        helper::append_key(key, _colorBlending.pAttachments[i]);
+    }
+    helper::append_key(key, _multisampling.rasterizationSamples);
+    helper::append_key(key, _multisampling.sampleShadingEnable);
+    helper::append_key(key, _multisampling.minSampleShading);
+    helper::append_key(key, _multisampling.alphaToCoverageEnable);
+    helper::append_key(key, _multisampling.alphaToOneEnable);
+
+    return key;
+}
+
 /**
  * @brief create compute pipeline
  * @param pipelineLayout represents sequence of descriptor sets and push constants
  * @param shaderStages collection of information for each pipeline shader stages (ie. code, entry point)
+ * @param stageKeys identity of each shader stage, unused
  * @return compute pipeline
  */
-VkPipeline ComputePipeline::build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) {
+VkPipeline ComputePipeline::build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys) {
     VkPipeline pipeline;
     VkComputePipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -182,10 +620,13 @@ VkPipeline ComputePipeline::build_pipeline(VkPipelineLayout& pipelineLayout, std
     pipelineInfo.flags = 0;
     pipelineInfo.stage = shaderStages.front();
 
-    if (vkCreateComputePipelines(_device._logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (vkCreateComputePipelines(_device._logicalDevice, _device._pipelineCache->_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         std::cout << "Failed to create compute pipeline\n";
         return VK_NULL_HANDLE;
     }
+    _device._pipelineCache->record(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    MemoryStatistics::created(ObjectCategory::PIPELINE);
 
     return pipeline;
 }
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <vector>
+#include <string>
 #include <unordered_map>
 
 #include "vk_shaders.h"
@@ -28,6 +29,10 @@ public:
 
     std::shared_ptr<ShaderEffect> build_effect(std::vector<VkDescriptorSetLayout> setLayouts, std::vector<VkPushConstantRange> pushConstants, std::vector<std::tuple<VkShaderStageFlagBits, const char*, VkSpecializationInfo>> shaderModules);
     std::shared_ptr<ShaderPass> build_pass(std::shared_ptr<ShaderEffect> effect);
+    /** @brief fixed-function state of the built pipelines, as a byte string */
+    virtual std::string state_key() const { return {}; };
+    /** @brief rasterization and depth state set per draw, false if the built pipelines do not use it */
+    virtual bool raster_state(DynamicRasterState& state) const { return false; };
 
 protected:
     /** @brief vulkan device wrapper */
@@ -35,10 +40,15 @@ protected:
 
 private:
     VkPipelineLayout build_layout(std::vector<VkDescriptorSetLayout> &setLayouts, std::vector<VkPushConstantRange> &pushConstants) const;
-    virtual VkPipeline build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) { return {}; };
+    virtual VkPipeline build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys) { return {}; };
+    static std::string stage_key(const ShaderEffect::ShaderStage& stage);
+    void reflect_layout(ShaderEffect& effect) const;
 };
 
 /**
+ * When the device supports VK_EXT_graphics_pipeline_library, pipelines are linked from four parts cached in the
+ * device pipeline library : vertex input interface, pre-rasterization shaders, fragment shader and fragment output
+ * interface. Otherwise, or if a part fails to compile, a monolithic pipeline is built.
  * @brief Graphics pipeline wrapper
  */
 class GraphicPipeline final : public PipelineBuilder {
@@ -61,14 +71,30 @@ public:
     std::vector<VkDynamicState> _dynamicStateEnables;
     /** @brief vertex binding and attributes used by VkPipelineVertexInputStateCreateInfo */
     VertexInputDescription _vertexDescription;
+    /** @brief cull mode, front face, depth and depth bias states set per draw, if extended dynamic state is supported */
+    bool _dynamicRaster = false;
 
     GraphicPipeline(const Device& device, RenderPass& renderPass);
 
+    std::string state_key() const override;
+    bool raster_state(DynamicRasterState& state) const override;
+
+    static void set_raster_state(const Device& device, VkCommandBuffer cmd, const ShaderPass& pass);
+
 private:
     /** @brief render pass wrapper object describing the environment in which the pipeline will be used */
     const class RenderPass& _renderPass;
 
-    VkPipeline build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) override;
+    VkPipeline build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys) override;
+    VkPipeline build_monolithic(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages);
+    VkPipeline build_linked(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys);
+    VkPipeline build_part(VkGraphicsPipelineLibraryFlagsEXT part, VkGraphicsPipelineCreateInfo pipelineInfo) const;
+
+    std::vector<VkDynamicState> dynamic_states() const;
+    std::string vertex_input_key() const;
+    std::string pre_rasterization_key() const;
+    std::string fragment_shader_key() const;
+    std::string fragment_output_key() const;
 };
 
 /**
@@ -78,6 +104,8 @@ class ComputePipeline final : public PipelineBuilder {
 public:
     explicit ComputePipeline(const Device& device) : PipelineBuilder(device) {};
 
+    std::string state_key() const override { return "compute"; };
+
 private:
-    VkPipeline build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages) override;
+    VkPipeline build_pipeline(VkPipelineLayout& pipelineLayout, std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, const std::vector<std::string>& stageKeys) override;
 };
\ No newline at end of file
@@ -0,0 +1,127 @@
+/*
+*  H2Vk - PipelineCache class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_pipeline_cache.h"
+#include "core/utilities/vk_helpers.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/**
+ * Create the pipeline cache, initialized from the cache file when valid for this device.
+ * @brief default constructor
+ * @param device logical device
+ * @param properties physical device properties, used to validate the cache file
+ * @param filePath cache file location
+ */
+PipelineCache::PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string filePath) :
+    _device(device), _properties(properties), _filePath(std::move(filePath)) {
+    std::vector<char> data = load();
+    _warm = validate(data);
+    if (!_warm) {
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data.size();
+    info.pInitialData = data.empty() ? nullptr : data.data();
+    VK_CHECK(vkCreatePipelineCache(_device, &info, nullptr, &_cache));
+
+    std::cout << "Pipeline cache : " << (_warm ? "loaded " + std::to_string(data.size()) + " bytes from " + _filePath : "empty") << std::endl;
+}
+
+/**
+ * @brief default destructor
+ */
+PipelineCache::~PipelineCache() {
+    vkDestroyPipelineCache(_device, _cache, nullptr);
+}
+
+/**
+ * @brief write pipeline cache data to disk
+ * @return true if written
+ */
+bool PipelineCache::save() const {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return false;
+    }
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) != VK_SUCCESS) {
+        return false;
+    }
+
+    std::ofstream file(_filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to write pipeline cache : " << _filePath << std::endl;
+        return false;
+    }
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    return true;
+}
+
+/**
+ * @brief account a pipeline creation
+ * @param milliseconds pipeline creation time
+ */
+void PipelineCache::record(double milliseconds) {
+    _pipelineCount++;
+    _creationTime += static_cast<uint64_t>(milliseconds * 1000.0);
+}
+
+/**
+ * @brief pipeline creation statistics since the device creation
+ * @return statistics
+ */
+PipelineCache::Statistics PipelineCache::statistics() const {
+    Statistics stats{};
+    stats.warm = _warm;
+    stats.pipelineCount = _pipelineCount;
+    stats.creationTime = static_cast<double>(_creationTime) / 1000.0;
+    return stats;
+}
+
+/**
+ * @brief read the cache file
+ * @return file content, empty if missing
+ */
+std::vector<char> PipelineCache::load() const {
+    std::ifstream file(_filePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    const std::streamsize size = file.tellg();
+    std::vector<char> data(static_cast<size_t>(size));
+    file.seekg(0);
+    file.read(data.data(), size);
+    return data;
+}
+
+/**
+ * Data created by another device or driver version is rejected by the driver anyway, but some drivers crash on it.
+ * @brief validate the cache header against the physical device
+ * @param data cache file content
+ * @return true if the data has been created by the same vendor, device and driver
+ */
+bool PipelineCache::validate(const std::vector<char>& data) const {
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == _properties.vendorID &&
+           header.deviceID == _properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,56 @@
+/*
+*  H2Vk - PipelineCache class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * Pipeline cache shared by every pipeline builder. Its content is loaded from disk when the device is created
+ * and written back at shutdown, so pipelines compiled once are not compiled again by the following launches.
+ * Saved data is only used when created by the same vendor, device and driver (pipeline cache UUID).
+ * @brief persistent pipeline cache
+ */
+class PipelineCache final {
+public:
+    /** @brief pipeline creation statistics */
+    struct Statistics {
+        /** @brief pipeline cache data loaded from disk */
+        bool warm = false;
+        /** @brief number of pipelines created */
+        uint32_t pipelineCount = 0;
+        /** @brief total pipeline creation time, in milliseconds */
+        double creationTime = 0.0;
+    };
+
+    /** @brief pipeline cache handle, passed to pipeline creation */
+    VkPipelineCache _cache = VK_NULL_HANDLE;
+
+    PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string filePath);
+    ~PipelineCache();
+
+    bool save() const;
+    void record(double milliseconds);
+    Statistics statistics() const;
+
+private:
+    VkDevice _device;
+    const VkPhysicalDeviceProperties _properties;
+    const std::string _filePath;
+    bool _warm = false;
+    std::atomic<uint32_t> _pipelineCount{0};
+    /** @brief total creation time, in microseconds */
+    std::atomic<uint64_t> _creationTime{0};
+
+    std::vector<char> load() const;
+    bool validate(const std::vector<char>& data) const;
+};
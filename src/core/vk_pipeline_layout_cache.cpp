@@ -0,0 +1,122 @@
+/*
+*  H2Vk - PipelineLayoutCache class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_pipeline_layout_cache.h"
+#include "core/utilities/vk_helpers.h"
+#include "core/utilities/vk_initializers.h"
+
+#include <algorithm>
+#include <mutex>
+
+/**
+ * Delete every pipeline layout. Pipelines using them must have been destroyed.
+ * @brief default destructor
+ */
+PipelineLayoutCache::~PipelineLayoutCache() {
+    for (auto& it : _cache) {
+        vkDestroyPipelineLayout(_device, it.second, nullptr);
+    }
+    for (auto layout : _evicted) {
+        vkDestroyPipelineLayout(_device, layout, nullptr);
+    }
+}
+
+/**
+ * @brief create & cache or return cached pipeline layout
+ * @param setLayouts collection of descriptor set layouts
+ * @param pushConstants push constants range description
+ * @return pipeline layout
+ */
+VkPipelineLayout PipelineLayoutCache::createPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants) {
+    PipelineLayoutInfo layoutInfo{setLayouts, pushConstants};
+
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _cache.find(layoutInfo);
+        if (it != _cache.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    auto it = _cache.find(layoutInfo); // created by another thread in between
+    if (it != _cache.end()) {
+        return it->second;
+    }
+
+    VkPipelineLayout layout{};
+    VkPipelineLayoutCreateInfo info = vkinit::pipeline_layout_create_info();
+    info.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    info.pSetLayouts = setLayouts.empty() ? nullptr : setLayouts.data(); // descriptor set layouts
+    info.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+    info.pPushConstantRanges = pushConstants.empty() ? nullptr : pushConstants.data(); // push constants
+    VK_CHECK(vkCreatePipelineLayout(_device, &info, nullptr, &layout));
+
+    _cache.emplace(std::move(layoutInfo), layout);
+    return layout;
+}
+
+/**
+ * Descriptor set layout handles can be reused by the driver once destroyed. Layouts built on top of a destroyed
+ * descriptor set layout are removed from the cache, so they are never returned for a different interface.
+ * @brief evict pipeline layouts using a descriptor set layout
+ * @param setLayout descriptor set layout about to be destroyed
+ * @return evicted pipeline layouts
+ */
+std::vector<VkPipelineLayout> PipelineLayoutCache::evict(VkDescriptorSetLayout setLayout) {
+    std::vector<VkPipelineLayout> evicted;
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    for (auto it = _cache.begin(); it != _cache.end();) {
+        const auto& setLayouts = it->first._setLayouts;
+        if (std::find(setLayouts.begin(), setLayouts.end(), setLayout) != setLayouts.end()) {
+            evicted.push_back(it->second);
+            _evicted.push_back(it->second);
+            it = _cache.erase(it);
+        } else {
+            it++;
+        }
+    }
+    return evicted;
+}
+
+/**
+ * @brief overload PipelineLayoutInfo operator ==
+ * @param other
+ * @return true if same descriptor set layouts and push constant ranges
+ */
+bool PipelineLayoutCache::PipelineLayoutInfo::operator==(const PipelineLayoutInfo& other) const {
+    if (_setLayouts != other._setLayouts || _pushConstants.size() != other._pushConstants.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < _pushConstants.size(); i++) {
+        if (_pushConstants[i].stageFlags != other._pushConstants[i].stageFlags ||
+            _pushConstants[i].offset != other._pushConstants[i].offset ||
+            _pushConstants[i].size != other._pushConstants[i].size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Hash made from ordered descriptor set layout handles and push constant ranges.
+ * @brief Pipeline layout info hash function
+ * @return hash
+ */
+size_t PipelineLayoutCache::PipelineLayoutInfo::hash() const {
+    size_t result = std::hash<size_t>()(_setLayouts.size());
+    for (auto setLayout : _setLayouts) {
+        helper::hash_combine(result, reinterpret_cast<uintptr_t>(setLayout));
+    }
+    for (const auto& range : _pushConstants) {
+        helper::hash_combine(result, range.stageFlags);
+        helper::hash_combine(result, range.offset);
+        helper::hash_combine(result, range.size);
+    }
+    return result;
+}
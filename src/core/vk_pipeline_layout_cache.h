@@ -0,0 +1,52 @@
+/*
+*  H2Vk - PipelineLayoutCache class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * Pipeline layouts are identified by their descriptor set layouts and push constant ranges.
+ * Materials sharing the same shader interface share the same pipeline layout.
+ * Lookups only take a shared lock, the cache is locked exclusively when a new layout is created.
+ * @brief Pipeline layout caching
+ * @note Cached pipeline layouts are owned by the cache. Destroyed with the cache only.
+ */
+class PipelineLayoutCache final {
+public:
+    /** @brief pipeline layout cache key */
+    struct PipelineLayoutInfo {
+        std::vector<VkDescriptorSetLayout> _setLayouts;
+        std::vector<VkPushConstantRange> _pushConstants;
+        bool operator==(const PipelineLayoutInfo& other) const;
+        size_t hash() const;
+    };
+
+    explicit PipelineLayoutCache(VkDevice device) : _device(device) {};
+    ~PipelineLayoutCache();
+
+    VkPipelineLayout createPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+    std::vector<VkPipelineLayout> evict(VkDescriptorSetLayout setLayout);
+
+private:
+    struct PipelineLayoutHash {
+        std::size_t operator()(const PipelineLayoutInfo& k) const {
+            return k.hash();
+        }
+    };
+
+    VkDevice _device;
+    std::shared_mutex _mutex;
+    std::unordered_map<PipelineLayoutInfo, VkPipelineLayout, PipelineLayoutHash> _cache;
+    /** @brief evicted pipeline layouts, possibly still used by pipelines */
+    std::vector<VkPipelineLayout> _evicted;
+};
@@ -0,0 +1,117 @@
+/*
+*  H2Vk - PipelineLibrary class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_pipeline_library.h"
+#include "core/utilities/vk_memory_statistics.h"
+
+#include <mutex>
+
+/**
+ * Delete every pipeline part. Linked pipelines do not depend on their parts once created.
+ * @brief default destructor
+ */
+PipelineLibrary::~PipelineLibrary() {
+    for (auto& it : _parts) {
+        vkDestroyPipeline(_device, it.second.pipeline, nullptr);
+        MemoryStatistics::destroyed(ObjectCategory::PIPELINE);
+    }
+    for (auto part : _evicted) {
+        vkDestroyPipeline(_device, part, nullptr);
+        MemoryStatistics::destroyed(ObjectCategory::PIPELINE);
+    }
+}
+
+/**
+ * Parts are compiled outside of the lock, so threads building different materials do not wait for each other.
+ * If two threads build the same part concurrently, the first one stored is kept.
+ * @brief create & cache or return cached pipeline part
+ * @param key state and shaders the part is built from
+ * @param build compiles the part, returns VK_NULL_HANDLE on failure
+ * @param layout pipeline layout referenced by the key, if any
+ * @param renderPass render pass referenced by the key, if any
+ * @return pipeline library part, VK_NULL_HANDLE if the part could not be compiled
+ */
+VkPipeline PipelineLibrary::get_part(const std::string& key, const std::function<VkPipeline()>& build, VkPipelineLayout layout, VkRenderPass renderPass) {
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _parts.find(key);
+        if (it != _parts.end()) {
+            _reusedParts++;
+            return it->second.pipeline;
+        }
+    }
+
+    VkPipeline part = build();
+    if (part == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    auto [it, inserted] = _parts.emplace(key, Part{part, layout, renderPass});
+    if (!inserted) { // built by another thread in between
+        vkDestroyPipeline(_device, part, nullptr);
+        MemoryStatistics::destroyed(ObjectCategory::PIPELINE);
+        _reusedParts++;
+    }
+
+    return it->second.pipeline;
+}
+
+/**
+ * @brief evict the parts built with a pipeline layout
+ * @param layout pipeline layout evicted from the pipeline layout cache
+ */
+void PipelineLibrary::evict(VkPipelineLayout layout) {
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    for (auto it = _parts.begin(); it != _parts.end();) {
+        if (it->second.layout == layout) {
+            _evicted.push_back(it->second.pipeline);
+            it = _parts.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+/**
+ * @brief evict the parts built for a render pass
+ * @param renderPass render pass about to be destroyed
+ */
+void PipelineLibrary::evict(VkRenderPass renderPass) {
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    for (auto it = _parts.begin(); it != _parts.end();) {
+        if (it->second.renderPass == renderPass) {
+            _evicted.push_back(it->second.pipeline);
+            it = _parts.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+/**
+ * @brief count a pipeline linked from parts
+ */
+void PipelineLibrary::linked() {
+    _links++;
+}
+
+/**
+ * @brief parts and links since the device creation
+ * @return statistics
+ */
+PipelineLibrary::Statistics PipelineLibrary::statistics() const {
+    Statistics stats;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        stats.parts = static_cast<uint32_t>(_parts.size());
+    }
+    stats.reusedParts = _reusedParts.load();
+    stats.links = _links.load();
+    return stats;
+}
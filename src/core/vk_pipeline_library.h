@@ -0,0 +1,63 @@
+/*
+*  H2Vk - PipelineLibrary class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <shared_mutex>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * Graphics pipeline parts (VK_EXT_graphics_pipeline_library) : vertex input interface, pre-rasterization shaders,
+ * fragment shader and fragment output interface. Parts are identified by the state and shaders they were built from,
+ * a material only compiles its missing parts and links them into a complete pipeline.
+ * Lookups only take a shared lock, the library is locked exclusively when a new part is stored.
+ * Keys embed the pipeline layout and render pass handles a part was built with : parts are evicted when these are
+ * destroyed, since the driver can hand the same handle value out again for a different object.
+ * @brief pipeline library parts caching
+ * @note Parts are owned by the library. Destroyed with the library only, evicted parts included.
+ */
+class PipelineLibrary final {
+public:
+    /** @brief parts compiled, parts served from the library and linked pipelines */
+    struct Statistics {
+        uint32_t parts = 0;
+        uint32_t reusedParts = 0;
+        uint32_t links = 0;
+    };
+
+    explicit PipelineLibrary(VkDevice device) : _device(device) {};
+    ~PipelineLibrary();
+
+    VkPipeline get_part(const std::string& key, const std::function<VkPipeline()>& build, VkPipelineLayout layout = VK_NULL_HANDLE, VkRenderPass renderPass = VK_NULL_HANDLE);
+    void evict(VkPipelineLayout layout);
+    void evict(VkRenderPass renderPass);
+    void linked();
+    Statistics statistics() const;
+
+private:
+    VkDevice _device;
+    mutable std::shared_mutex _mutex;
+    /** @brief cached part and the handles its key refers to */
+    struct Part {
+        VkPipeline pipeline;
+        VkPipelineLayout layout;
+        VkRenderPass renderPass;
+    };
+
+    std::unordered_map<std::string, Part> _parts;
+    /** @brief evicted parts, possibly being linked by another thread */
+    std::vector<VkPipeline> _evicted;
+    std::atomic<uint32_t> _reusedParts{0};
+    std::atomic<uint32_t> _links{0};
+};
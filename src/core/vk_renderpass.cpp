@@ -8,6 +8,7 @@
 
 #include "vk_renderpass.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/vk_pipeline_library.h"
 
 /**
  * Initialize a render pass from a collection of attachments, dependencies and sub-pass descriptions.
@@ -15,8 +16,9 @@
  * @param attachments collection of attachment descriptions
  * @param dependencies collection of sub-pass dependencies
  * @param subpasses collection of sub-pass descriptions
+ * @param viewMask multiview : views broadcast by every sub-pass (one per attachment layer), correlated with each other. 0 disables multiview
  */
-void RenderPass::init(std::vector<VkAttachmentDescription> attachments, std::vector<VkSubpassDependency> dependencies, std::vector<VkSubpassDescription> subpasses) {
+void RenderPass::init(std::vector<VkAttachmentDescription> attachments, std::vector<VkSubpassDependency> dependencies, std::vector<VkSubpassDescription> subpasses, uint32_t viewMask) {
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
@@ -26,6 +28,17 @@ void RenderPass::init(std::vector<VkAttachmentDescription> attachments, std::vec
     renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
     renderPassInfo.pDependencies = dependencies.data();
 
+    std::vector<uint32_t> viewMasks(subpasses.size(), viewMask);
+    VkRenderPassMultiviewCreateInfo multiviewInfo{};
+    if (viewMask != 0) {
+        multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+        multiviewInfo.subpassCount = static_cast<uint32_t>(viewMasks.size());
+        multiviewInfo.pViewMasks = viewMasks.data();
+        multiviewInfo.correlationMaskCount = 1;
+        multiviewInfo.pCorrelationMasks = &viewMask;
+        renderPassInfo.pNext = &multiviewInfo;
+    }
+
     VK_CHECK(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_renderPass));
 }
 
@@ -33,7 +46,13 @@ void RenderPass::init(std::vector<VkAttachmentDescription> attachments, std::vec
  * @brief Destroy render pass
  */
 void RenderPass::destroy() {
-    vkDestroyRenderPass(_device, _renderPass, nullptr);
+    if (_renderPass != VK_NULL_HANDLE) {
+        if (_library != nullptr) {
+            _library->evict(_renderPass); // the handle value can be reused by the next render pass
+        }
+        vkDestroyRenderPass(_device, _renderPass, nullptr);
+        _renderPass = VK_NULL_HANDLE; // destroyed once, destructor included
+    }
 }
 
 /**
@@ -47,7 +47,10 @@ public:
     /** @brief render pass object, collection of attachments, subpasses, dependencies, etc. */
     VkRenderPass _renderPass = VK_NULL_HANDLE;
 
-    explicit RenderPass(Device& device) : _device(device._logicalDevice) {}
+    /** @brief device pipeline library, its parts built for this render pass are evicted when destroyed. Null if unsupported */
+    PipelineLibrary* _library = nullptr;
+
+    explicit RenderPass(Device& device) : _device(device._logicalDevice), _library(device._pipelineLibrary.get()) {}
     ~RenderPass() {
         destroy();
     }
@@ -57,12 +60,13 @@ public:
         if (this != &other) { // copy-and-swap idiom
             _renderPass = other._renderPass;
             _device = other._device;
+            _library = other._library;
         }
 
         return *this;
     }
 
-    void init(std::vector<VkAttachmentDescription> attachments, std::vector<VkSubpassDependency> dependencies, std::vector<VkSubpassDescription> subpasses);
+    void init(std::vector<VkAttachmentDescription> attachments, std::vector<VkSubpassDependency> dependencies, std::vector<VkSubpassDescription> subpasses, uint32_t viewMask = 0);
     void destroy();
 
     // Helpers
@@ -0,0 +1,165 @@
+/*
+*  H2Vk - SecondaryRecorder class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_secondary_recorder.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <memory>
+
+#include "core/vk_device.h"
+#include "core/vk_command_pool.h"
+#include "core/utilities/vk_initializers.h"
+#include "core/manager/vk_job_manager.h"
+
+/**
+ * One recording slot per hardware thread, enough for every job system worker.
+ * @param device
+ */
+SecondaryRecorder::SecondaryRecorder(const Device& device) : _device(device) {
+    const uint32_t slotCount = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_SLOTS);
+
+    for (auto& slots : _slots) {
+        slots.resize(slotCount);
+        for (Slot& slot : slots) {
+            slot.pool = new CommandPool(device);
+        }
+    }
+}
+
+/**
+ * @brief default destructor
+ * Destroying the pools frees their command buffers.
+ */
+SecondaryRecorder::~SecondaryRecorder() {
+    for (auto& slots : _slots) {
+        for (Slot& slot : slots) {
+            delete slot.pool;
+        }
+    }
+}
+
+/**
+ * Must be called once the frame fence is signaled : command buffers of the frame are no longer in use by the GPU.
+ * @brief reset command pools of a frame
+ * @param frameIndex frame in flight index
+ */
+void SecondaryRecorder::reset(uint32_t frameIndex) {
+    for (Slot& slot : _slots[frameIndex]) {
+        if (slot.used > 0) {
+            VK_CHECK(vkResetCommandPool(_device._logicalDevice, slot.pool->_commandPool, 0));
+        }
+        slot.used = 0;
+    }
+
+    _lastStatistics = _statistics;
+    _statistics = {};
+}
+
+/**
+ * @brief get the next free secondary command buffer of a slot, allocate it if needed
+ * @param slot recording slot
+ * @return secondary command buffer
+ */
+VkCommandBuffer SecondaryRecorder::allocate(Slot& slot) {
+    if (slot.used == slot.commandBuffers.size()) {
+        VkCommandBufferAllocateInfo allocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = slot.pool->_commandPool;
+        allocateInfo.commandBufferCount = 1;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocateInfo.pNext = nullptr;
+
+        VkCommandBuffer commandBuffer;
+        VK_CHECK(vkAllocateCommandBuffers(_device._logicalDevice, &allocateInfo, &commandBuffer));
+        slot.commandBuffers.push_back(commandBuffer);
+    }
+
+    return slot.commandBuffers[slot.used++];
+}
+
+/**
+ * Ranges are spread over the recording slots, slot s records ranges s, s + slots, etc. Slots are claimed by the calling
+ * thread and by helper jobs : the calling thread records slots itself instead of waiting behind other jobs of the queue
+ * (scene or material loading), helpers claiming no slot return at once. Returns once every range is recorded.
+ * @brief record ranges of a render pass into secondary command buffers
+ * @param frameIndex frame in flight index
+ * @param inheritance render pass continued by the command buffers
+ * @param count number of ranges
+ * @param job records a range into a command buffer, called from worker threads
+ * @param commandBuffers command buffers of the ranges, appended in range order
+ */
+void SecondaryRecorder::record(uint32_t frameIndex, const Inheritance& inheritance, uint32_t count, const std::function<void(VkCommandBuffer, uint32_t)>& job, std::vector<VkCommandBuffer>& commandBuffers) {
+    if (count == 0) {
+        return;
+    }
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<Slot>& slots = _slots[frameIndex];
+    const uint32_t slotCount = static_cast<uint32_t>(slots.size());
+    const size_t first = commandBuffers.size();
+    commandBuffers.resize(first + count);
+
+    const VkCommandBufferInheritanceInfo inheritanceInfo = vkinit::command_buffer_inheritance_info(inheritance.renderPass, 0, inheritance.frameBuffer);
+    VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    auto record_slot = [&](uint32_t s) {
+        Slot& slot = slots[s];
+        for (uint32_t range = s; range < count; range += slotCount) {
+            VkCommandBuffer commandBuffer = allocate(slot);
+            VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+            vkCmdSetViewport(commandBuffer, 0, 1, &inheritance.viewport);
+            vkCmdSetScissor(commandBuffer, 0, 1, &inheritance.scissor);
+            job(commandBuffer, range);
+            VK_CHECK(vkEndCommandBuffer(commandBuffer));
+            commandBuffers[first + range] = commandBuffer;
+        }
+    };
+
+    const uint32_t jobCount = std::min(count, slotCount);
+    if (jobCount > 1) {
+        // Helpers may run after the recording is over : claim state outlives the call
+        struct Claims {
+            std::atomic<uint32_t> next {0};
+            std::atomic<uint32_t> finished {0};
+            /** @brief threads which claimed at least one slot */
+            std::atomic<uint32_t> threads {0};
+        };
+        auto claims = std::make_shared<Claims>();
+        auto record_claimed = [&record_slot, jobCount](Claims& c) {
+            uint32_t s = c.next.fetch_add(1);
+            if (s < jobCount) {
+                c.threads.fetch_add(1);
+            }
+            for (; s < jobCount; s = c.next.fetch_add(1)) {
+                record_slot(s);
+                c.finished.fetch_add(1);
+            }
+        };
+
+        JobManager::dispatch(jobCount - 1, 1, [claims, record_claimed](JobDispatchData) {
+            record_claimed(*claims);
+        });
+        record_claimed(*claims);
+
+        // Every slot is claimed : wait for the slots still recorded by helpers only
+        while (claims->finished.load() < jobCount) {
+            std::this_thread::yield();
+        }
+        _statistics.threads = std::max(_statistics.threads, claims->threads.load());
+    } else {
+        record_slot(0);
+        _statistics.threads = std::max(_statistics.threads, 1u);
+    }
+
+    _statistics.commandBuffers += count;
+    _statistics.time += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
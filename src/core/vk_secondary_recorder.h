@@ -0,0 +1,77 @@
+/*
+*  H2Vk - SecondaryRecorder class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <functional>
+
+#include "core/utilities/vk_resources.h"
+#include "core/utilities/vk_global.h"
+
+class Device;
+class CommandPool;
+
+/**
+ * Render pass contents are split into ranges, each range is recorded into a secondary command buffer on the job system,
+ * then the primary command buffer executes them in order. Recording slots own one command pool per frame in flight :
+ * a slot records on a single thread at a time, so pools are never shared between threads.
+ * @brief Parallel recording of secondary command buffers
+ */
+class SecondaryRecorder final {
+public:
+    /** @brief Render pass state continued by the secondary command buffers */
+    struct Inheritance {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+        /** @brief dynamic states are not inherited : set at the beginning of every secondary command buffer */
+        VkViewport viewport {};
+        VkRect2D scissor {};
+    };
+
+    struct Statistics {
+        /** @brief secondary command buffers recorded this frame */
+        uint32_t commandBuffers = 0;
+        /** @brief most threads recording ranges of a single render pass this frame */
+        uint32_t threads = 0;
+        /** @brief recording time of the frame (ms) */
+        float time = 0.0f;
+    };
+
+    /** @brief Record render passes through secondary command buffers, inline in the primary command buffer otherwise */
+    bool _enabled = true;
+    /** @brief Upper bound of recording slots */
+    static constexpr uint32_t MAX_SLOTS = 16;
+
+    explicit SecondaryRecorder(const Device& device);
+    ~SecondaryRecorder();
+
+    void reset(uint32_t frameIndex);
+    void record(uint32_t frameIndex, const Inheritance& inheritance, uint32_t count, const std::function<void(VkCommandBuffer, uint32_t)>& job, std::vector<VkCommandBuffer>& commandBuffers);
+
+    /** @brief number of ranges worth recording in parallel */
+    uint32_t slot_count() const { return static_cast<uint32_t>(_slots[0].size()); };
+    Statistics statistics() const { return _lastStatistics; };
+
+private:
+    struct Slot {
+        CommandPool* pool = nullptr;
+        /** @brief secondary command buffers allocated from the pool, reused across frames */
+        std::vector<VkCommandBuffer> commandBuffers;
+        /** @brief command buffers in use this frame */
+        uint32_t used = 0;
+    };
+
+    const class Device& _device;
+    std::array<std::vector<Slot>, FRAME_OVERLAP> _slots;
+    Statistics _statistics;
+    Statistics _lastStatistics;
+
+    VkCommandBuffer allocate(Slot& slot);
+};
@@ -0,0 +1,166 @@
+/*
+*  H2Vk - ShaderModuleCache class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_shader_module_cache.h"
+#include "core/utilities/vk_helpers.h"
+#include "core/utilities/vk_embedded_shaders.h"
+
+#include <mutex>
+#include <cstring>
+
+/**
+ * Delete every shader module. Pipelines do not depend on their modules once created.
+ * @brief default destructor
+ */
+ShaderModuleCache::~ShaderModuleCache() {
+    for (auto& it : _modules) {
+        vkDestroyShaderModule(_device, it.second.module, nullptr);
+    }
+}
+
+/**
+ * The path is resolved once : embedded SPIR-V is looked up first, the file is read if the shader is not embedded.
+ * @brief create & cache or return cached shader module of a SPIR-V file
+ * @param filePath path to file containing shader code
+ * @return shader module, VK_NULL_HANDLE if the module could not be created
+ */
+VkShaderModule ShaderModuleCache::get_module(const char* filePath) {
+    _requests++;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _paths.find(filePath);
+        if (it != _paths.end()) {
+            return it->second;
+        }
+    }
+
+    VkShaderModule module;
+    const EmbeddedShader* embedded = EmbeddedShaders::find(filePath);
+    if (embedded != nullptr) {
+        module = find_or_create(embedded->code, embedded->wordCount);
+    } else {
+        const std::vector<uint32_t> code = helper::read_file(filePath);
+        _fileReads++;
+        module = find_or_create(code.data(), code.size());
+    }
+
+    if (module != VK_NULL_HANDLE) {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _paths.emplace(filePath, module);
+    }
+
+    return module;
+}
+
+/**
+ * @brief create & cache or return cached shader module of SPIR-V code
+ * @param code SPIR-V words
+ * @param wordCount number of SPIR-V words
+ * @return shader module, VK_NULL_HANDLE if the module could not be created
+ */
+VkShaderModule ShaderModuleCache::get_module(const uint32_t* code, size_t wordCount) {
+    _requests++;
+    return find_or_create(code, wordCount);
+}
+
+/**
+ * Requests are counted by the callers : a path lookup falling back to its code is a single request.
+ * @brief return the cached module of SPIR-V code, create it if needed
+ * @param code SPIR-V words
+ * @param wordCount number of SPIR-V words
+ * @return shader module, VK_NULL_HANDLE if the module could not be created
+ */
+VkShaderModule ShaderModuleCache::find_or_create(const uint32_t* code, size_t wordCount) {
+    const uint64_t key = hash(code, wordCount);
+    auto find = [&]() -> VkShaderModule {
+        auto [first, last] = _modules.equal_range(key);
+        for (auto it = first; it != last; it++) {
+            const std::vector<uint32_t>& cached = it->second.code;
+            if (cached.size() == wordCount && std::memcmp(cached.data(), code, wordCount * sizeof(uint32_t)) == 0) {
+                return it->second.module;
+            }
+        }
+        return VK_NULL_HANDLE;
+    };
+
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        VkShaderModule module = find();
+        if (module != VK_NULL_HANDLE) {
+            return module;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    VkShaderModule cached = find(); // created by another thread in between
+    if (cached != VK_NULL_HANDLE) {
+        return cached;
+    }
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.codeSize = wordCount * sizeof(uint32_t);
+    createInfo.pCode = code;
+
+    VkShaderModule module;
+    if (vkCreateShaderModule(_device, &createInfo, nullptr, &module) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+
+    _modules.emplace(key, Module{module, std::vector<uint32_t>(code, code + wordCount)});
+
+    ShaderReflection reflection;
+    if (ShaderReflection::reflect(code, wordCount, reflection)) {
+        _reflections.emplace(module, std::move(reflection));
+    }
+
+    return module;
+}
+
+/**
+ * Reflections are never erased before the cache is destroyed, the returned pointer stays valid.
+ * @brief resource interface of a cached shader module
+ * @param module shader module created by the cache
+ * @return reflected interface, nullptr if the module is unknown or its SPIR-V could not be reflected
+ */
+const ShaderReflection* ShaderModuleCache::reflection(VkShaderModule module) const {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    auto it = _reflections.find(module);
+    return it != _reflections.end() ? &it->second : nullptr;
+}
+
+/**
+ * @brief shader modules created and requested since the device creation
+ * @return statistics
+ */
+ShaderModuleCache::Statistics ShaderModuleCache::statistics() const {
+    Statistics stats;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        stats.modules = static_cast<uint32_t>(_modules.size());
+    }
+    stats.requests = _requests.load();
+    stats.fileReads = _fileReads.load();
+    return stats;
+}
+
+/**
+ * @brief FNV-1a hash of SPIR-V code
+ * @param code SPIR-V words
+ * @param wordCount number of SPIR-V words
+ * @return 64 bits hash
+ */
+uint64_t ShaderModuleCache::hash(const uint32_t* code, size_t wordCount) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < wordCount; i++) {
+        h ^= code[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
@@ -0,0 +1,68 @@
+/*
+*  H2Vk - ShaderModuleCache class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <shared_mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "vk_shader_reflection.h"
+
+/**
+ * Shader modules are identified by a hash of their SPIR-V code : a shader requested by several materials, or
+ * under several paths, is created once. SPIR-V is taken from the shaders embedded in the executable when built
+ * with H2VK_EMBED_SHADERS, read from disk otherwise, and each path is only resolved once.
+ * Each module is reflected once when created, its resource interface is then available to pipeline builders.
+ * Lookups only take a shared lock, the cache is locked exclusively when a new module is created.
+ * @brief shader module caching
+ * @note Cached shader modules are owned by the cache. Destroyed with the cache only.
+ */
+class ShaderModuleCache final {
+public:
+    /** @brief modules created, module requests and SPIR-V files read from disk */
+    struct Statistics {
+        uint32_t modules = 0;
+        uint32_t requests = 0;
+        uint32_t fileReads = 0;
+    };
+
+    explicit ShaderModuleCache(VkDevice device) : _device(device) {};
+    ~ShaderModuleCache();
+
+    VkShaderModule get_module(const char* filePath);
+    VkShaderModule get_module(const uint32_t* code, size_t wordCount);
+    const ShaderReflection* reflection(VkShaderModule module) const;
+    Statistics statistics() const;
+
+    static uint64_t hash(const uint32_t* code, size_t wordCount);
+
+private:
+    /** @brief cached module and its code, compared on hash match */
+    struct Module {
+        VkShaderModule module;
+        std::vector<uint32_t> code;
+    };
+
+    VkDevice _device;
+    mutable std::shared_mutex _mutex;
+    /** @brief modules by SPIR-V hash */
+    std::unordered_multimap<uint64_t, Module> _modules;
+    /** @brief modules by requested path */
+    std::unordered_map<std::string, VkShaderModule> _paths;
+    /** @brief reflected interface of each module, absent if the SPIR-V could not be parsed */
+    std::unordered_map<VkShaderModule, ShaderReflection> _reflections;
+    std::atomic<uint32_t> _requests{0};
+    std::atomic<uint32_t> _fileReads{0};
+
+    VkShaderModule find_or_create(const uint32_t* code, size_t wordCount);
+};
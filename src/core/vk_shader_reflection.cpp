@@ -0,0 +1,332 @@
+/*
+*  H2Vk - ShaderReflection class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_shader_reflection.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+
+namespace {
+    /** @brief SPIR-V opcodes, decorations and enumerants used by the reflection */
+    namespace spv {
+        constexpr uint32_t MAGIC = 0x07230203;
+        constexpr uint32_t HEADER_SIZE = 5;
+
+        constexpr uint32_t OpDecorate = 71;
+        constexpr uint32_t OpMemberDecorate = 72;
+        constexpr uint32_t OpTypeInt = 21;
+        constexpr uint32_t OpTypeFloat = 22;
+        constexpr uint32_t OpTypeVector = 23;
+        constexpr uint32_t OpTypeMatrix = 24;
+        constexpr uint32_t OpTypeImage = 25;
+        constexpr uint32_t OpTypeSampler = 26;
+        constexpr uint32_t OpTypeSampledImage = 27;
+        constexpr uint32_t OpTypeArray = 28;
+        constexpr uint32_t OpTypeRuntimeArray = 29;
+        constexpr uint32_t OpTypeStruct = 30;
+        constexpr uint32_t OpTypePointer = 32;
+        constexpr uint32_t OpConstant = 43;
+        constexpr uint32_t OpVariable = 59;
+        constexpr uint32_t OpTypeAccelerationStructure = 5341;
+
+        constexpr uint32_t DecorationSpecId = 1;
+        constexpr uint32_t DecorationBlock = 2;
+        constexpr uint32_t DecorationBufferBlock = 3;
+        constexpr uint32_t DecorationArrayStride = 6;
+        constexpr uint32_t DecorationMatrixStride = 7;
+        constexpr uint32_t DecorationBinding = 33;
+        constexpr uint32_t DecorationDescriptorSet = 34;
+        constexpr uint32_t DecorationOffset = 35;
+
+        constexpr uint32_t StorageClassUniformConstant = 0;
+        constexpr uint32_t StorageClassUniform = 2;
+        constexpr uint32_t StorageClassPushConstant = 9;
+        constexpr uint32_t StorageClassStorageBuffer = 12;
+
+        constexpr uint32_t DimBuffer = 5;
+        constexpr uint32_t DimSubpassData = 6;
+    }
+
+    /** @brief type, decoration and variable declarations of a module */
+    struct Module {
+        struct Type {
+            uint32_t opcode = 0;
+            std::vector<uint32_t> operands;
+        };
+        struct Decorations {
+            uint32_t set = 0;
+            uint32_t binding = 0;
+            uint32_t arrayStride = 0;
+            bool hasBinding = false;
+            bool block = false;
+            bool bufferBlock = false;
+        };
+        struct Member {
+            uint32_t offset = 0;
+            uint32_t matrixStride = 0;
+        };
+        struct Variable {
+            uint32_t id;
+            uint32_t pointerType;
+            uint32_t storageClass;
+        };
+
+        std::unordered_map<uint32_t, Type> types;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        std::unordered_map<uint32_t, Decorations> decorations;
+        std::unordered_map<uint32_t, std::vector<Member>> members;
+        std::vector<Variable> variables;
+
+        const Type* type(uint32_t id) const {
+            auto it = types.find(id);
+            return it != types.end() ? &it->second : nullptr;
+        }
+
+        Decorations decoration(uint32_t id) const {
+            auto it = decorations.find(id);
+            return it != decorations.end() ? it->second : Decorations{};
+        }
+
+        Member member(uint32_t structId, uint32_t index) const {
+            auto it = members.find(structId);
+            return (it != members.end() && index < it->second.size()) ? it->second[index] : Member{};
+        }
+
+        /**
+         * @brief size in bytes of a type laid out in a block
+         * @param id type id
+         * @param matrixStride stride of matrix columns, decorated on the struct member
+         */
+        uint32_t size(uint32_t id, uint32_t matrixStride = 0) const {
+            const Type* t = type(id);
+            if (t == nullptr) {
+                return 0;
+            }
+
+            switch (t->opcode) {
+                case spv::OpTypeInt:
+                case spv::OpTypeFloat:
+                    return t->operands[0] / 8;
+                case spv::OpTypeVector:
+                    return t->operands[1] * size(t->operands[0]);
+                case spv::OpTypeMatrix:
+                    return t->operands[1] * (matrixStride > 0 ? matrixStride : size(t->operands[0]));
+                case spv::OpTypeArray: {
+                    auto length = constants.find(t->operands[1]);
+                    const uint32_t count = length != constants.end() ? length->second : 0;
+                    const uint32_t stride = decoration(id).arrayStride;
+                    return count * (stride > 0 ? stride : size(t->operands[0], matrixStride));
+                }
+                case spv::OpTypeStruct: {
+                    uint32_t end = 0;
+                    for (uint32_t i = 0; i < t->operands.size(); i++) {
+                        const Member m = member(id, i);
+                        end = std::max(end, m.offset + size(t->operands[i], m.matrixStride));
+                    }
+                    return end;
+                }
+                default:
+                    return 0;
+            }
+        }
+    };
+
+    /**
+     * @brief descriptor type of a resource variable
+     * @return false if the variable is not a descriptor
+     */
+    bool descriptor_type(const Module& module, uint32_t typeId, uint32_t storageClass, VkDescriptorType& out) {
+        const Module::Type* t = module.type(typeId);
+        if (t == nullptr) {
+            return false;
+        }
+
+        if (storageClass == spv::StorageClassStorageBuffer) {
+            out = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            return true;
+        }
+        if (storageClass == spv::StorageClassUniform) {
+            out = module.decoration(typeId).bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            return true;
+        }
+
+        switch (t->opcode) {
+            case spv::OpTypeSampler:
+                out = VK_DESCRIPTOR_TYPE_SAMPLER;
+                return true;
+            case spv::OpTypeSampledImage:
+                out = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                return true;
+            case spv::OpTypeImage: {
+                const uint32_t dim = t->operands[1];
+                const uint32_t sampled = t->operands[5];
+                if (dim == spv::DimSubpassData) {
+                    out = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                } else if (dim == spv::DimBuffer) {
+                    out = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                } else {
+                    out = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                return true;
+            }
+            case spv::OpTypeAccelerationStructure:
+                out = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+/**
+ * Collect descriptor bindings (set, binding, type, array size) and the extent of the push constant block.
+ * @brief reflect the resource interface of a SPIR-V module
+ * @param code SPIR-V words
+ * @param wordCount number of SPIR-V words
+ * @param out reflected interface
+ * @return false if the code is not valid SPIR-V
+ */
+bool ShaderReflection::reflect(const uint32_t* code, size_t wordCount, ShaderReflection& out) {
+    out = ShaderReflection{};
+    if (code == nullptr || wordCount < spv::HEADER_SIZE || code[0] != spv::MAGIC) {
+        return false;
+    }
+
+    Module module;
+    size_t i = spv::HEADER_SIZE;
+    while (i < wordCount) {
+        const uint32_t opcode = code[i] & 0xFFFFu;
+        const uint32_t count = code[i] >> 16u;
+        if (count == 0 || i + count > wordCount) {
+            return false;
+        }
+        const uint32_t* op = code + i + 1; // operands
+
+        switch (opcode) {
+            case spv::OpDecorate: {
+                Module::Decorations& d = module.decorations[op[0]];
+                const uint32_t decoration = op[1];
+                if (decoration == spv::DecorationDescriptorSet && count > 3) {
+                    d.set = op[2];
+                } else if (decoration == spv::DecorationBinding && count > 3) {
+                    d.binding = op[2];
+                    d.hasBinding = true;
+                } else if (decoration == spv::DecorationArrayStride && count > 3) {
+                    d.arrayStride = op[2];
+                } else if (decoration == spv::DecorationBlock) {
+                    d.block = true;
+                } else if (decoration == spv::DecorationBufferBlock) {
+                    d.bufferBlock = true;
+                } else if (decoration == spv::DecorationSpecId && count > 3) {
+                    out._specializationIds.push_back(op[2]);
+                }
+                break;
+            }
+            case spv::OpMemberDecorate: {
+                if (count > 4) {
+                    std::vector<Module::Member>& members = module.members[op[0]];
+                    if (members.size() <= op[1]) {
+                        members.resize(op[1] + 1);
+                    }
+                    if (op[2] == spv::DecorationOffset) {
+                        members[op[1]].offset = op[3];
+                    } else if (op[2] == spv::DecorationMatrixStride) {
+                        members[op[1]].matrixStride = op[3];
+                    }
+                }
+                break;
+            }
+            case spv::OpTypeInt:
+            case spv::OpTypeFloat:
+            case spv::OpTypeVector:
+            case spv::OpTypeMatrix:
+            case spv::OpTypeImage:
+            case spv::OpTypeSampler:
+            case spv::OpTypeSampledImage:
+            case spv::OpTypeArray:
+            case spv::OpTypeRuntimeArray:
+            case spv::OpTypeStruct:
+            case spv::OpTypePointer:
+            case spv::OpTypeAccelerationStructure:
+                module.types[op[0]] = Module::Type{opcode, std::vector<uint32_t>(op + 1, op + count - 1)};
+                break;
+            case spv::OpConstant:
+                if (count > 3) {
+                    module.constants[op[1]] = op[2];
+                }
+                break;
+            case spv::OpVariable:
+                module.variables.push_back({op[1], op[0], op[2]});
+                break;
+            default:
+                break;
+        }
+
+        i += count;
+    }
+
+    uint32_t pushBegin = std::numeric_limits<uint32_t>::max();
+    uint32_t pushEnd = 0;
+
+    for (const auto& variable : module.variables) {
+        const Module::Type* pointer = module.type(variable.pointerType);
+        if (pointer == nullptr || pointer->opcode != spv::OpTypePointer) {
+            continue;
+        }
+        uint32_t typeId = pointer->operands[1];
+
+        if (variable.storageClass == spv::StorageClassPushConstant) {
+            const Module::Type* block = module.type(typeId);
+            if (block == nullptr || block->opcode != spv::OpTypeStruct) {
+                continue;
+            }
+            for (uint32_t m = 0; m < block->operands.size(); m++) {
+                const Module::Member member = module.member(typeId, m);
+                pushBegin = std::min(pushBegin, member.offset);
+                pushEnd = std::max(pushEnd, member.offset + module.size(block->operands[m], member.matrixStride));
+            }
+            continue;
+        }
+
+        if (variable.storageClass != spv::StorageClassUniformConstant && variable.storageClass != spv::StorageClassUniform &&
+            variable.storageClass != spv::StorageClassStorageBuffer) {
+            continue;
+        }
+
+        const Module::Decorations decorations = module.decoration(variable.id);
+        if (!decorations.hasBinding) {
+            continue;
+        }
+
+        // Arrays of resources : one binding with several descriptors
+        uint32_t descriptorCount = 1;
+        const Module::Type* t = module.type(typeId);
+        if (t != nullptr && t->opcode == spv::OpTypeArray) {
+            auto length = module.constants.find(t->operands[1]);
+            descriptorCount = length != module.constants.end() ? length->second : 1;
+            typeId = t->operands[0];
+        } else if (t != nullptr && t->opcode == spv::OpTypeRuntimeArray) {
+            descriptorCount = 0;
+            typeId = t->operands[0];
+        }
+
+        VkDescriptorType type;
+        if (descriptor_type(module, typeId, variable.storageClass, type)) {
+            out._bindings.push_back({decorations.set, decorations.binding, type, descriptorCount});
+        }
+    }
+
+    if (pushEnd > 0) {
+        out._pushConstants = true;
+        out._pushOffset = pushBegin;
+        out._pushSize = pushEnd - pushBegin;
+    }
+
+    return true;
+}
@@ -0,0 +1,45 @@
+/*
+*  H2Vk - ShaderReflection class
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * Shader interface read from SPIR-V : descriptor bindings, push constant block and specialization constants.
+ * Only the instructions describing resources are parsed (decorations, types, constants, variables).
+ * @brief SPIR-V reflection
+ */
+class ShaderReflection final {
+public:
+    /** @brief descriptor binding declared by a shader */
+    struct Binding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        /** @brief array size, 0 for a runtime array */
+        uint32_t count;
+    };
+
+    /** @brief descriptor bindings, in declaration order */
+    std::vector<Binding> _bindings;
+    /** @brief true if the shader declares a push constant block */
+    bool _pushConstants = false;
+    /** @brief first byte of the push constant block used by the shader */
+    uint32_t _pushOffset = 0;
+    /** @brief size of the push constant block from its first member */
+    uint32_t _pushSize = 0;
+    /** @brief constant ids of the specialization constants declared by the shader */
+    std::vector<uint32_t> _specializationIds;
+
+    static bool reflect(const uint32_t* code, size_t wordCount, ShaderReflection& out);
+};
@@ -8,48 +8,44 @@
 
 #include "vk_shaders.h"
 #include "core/utilities/vk_resources.h"
+#include "core/vk_shader_module_cache.h"
 
-/**
- * Create a shader module.
- * Shader modules contain shader code and one or more entry points.
- * Shaders are selected from a shader module by specifying an entry point as part of pipeline creation.
- *
- * @brief create shader module object
- * @param device vulkan device wrapper
- * @param code shader code content
- * @param out pointer to shader module object being created
- * @return true if shader module creation is successful
- * @return false if shader module creation fail
- */
-bool Shader::create_shader_module(const Device& device, const std::vector<uint32_t>& code, VkShaderModule* out) {
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.pNext = nullptr;
-    createInfo.codeSize = code.size() * sizeof(uint32_t);
-    createInfo.pCode = code.data();
+#include <cstddef>
 
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device._logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-        return false;
-    }
+const std::array<VkSpecializationMapEntry, 5> ShaderVariant::mapEntries = {{
+        {0, offsetof(ShaderVariant, shadowMapping), sizeof(VkBool32)},
+        {1, offsetof(ShaderVariant, skybox), sizeof(VkBool32)},
+        {2, offsetof(ShaderVariant, atmosphere), sizeof(VkBool32)},
+        {3, offsetof(ShaderVariant, cascadeCount), sizeof(uint32_t)},
+        {4, offsetof(ShaderVariant, indirectDraw), sizeof(VkBool32)},
+}};
 
-    *out = shaderModule;
-    return true;
+/**
+ * @brief specialization of the variant constants
+ * @return specialization info referencing this variant, valid as long as the variant
+ */
+VkSpecializationInfo ShaderVariant::specialization() const {
+    VkSpecializationInfo info{};
+    info.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+    info.pMapEntries = mapEntries.data();
+    info.dataSize = sizeof(ShaderVariant);
+    info.pData = this;
+    return info;
 }
 
 /**
- *  Read shader file then create a shader module.
- *  Shader modules contain shader code from the external file.
+ *  Get the shader module of a shader file from the device shader module cache.
+ *  Shader code is embedded in the executable or read from the external file, once per path.
  * @brief load a shader file and create shader module
  * @param device vulkan device wrapper
  * @param filePath path to file containing shader code
- * @param out pointer to shader module object being created
+ * @param out pointer to shader module object, owned by the cache
  * @return true if shader module creation is successful
  * @return false if shader module creation fail
  */
 bool Shader::load_shader_module(const Device& device, const char* filePath, VkShaderModule* out) {
-    const std::vector<uint32_t> code = helper::read_file(filePath);
-    return create_shader_module(device, code, out);
+    *out = device._shaderModuleCache->get_module(filePath);
+    return *out != VK_NULL_HANDLE;
 }
 
 /**
@@ -10,13 +10,17 @@
 
 #include "vulkan/vulkan_core.h"
 #include "core/manager/vk_system_manager.h"
+#include "core/utilities/vk_memory_statistics.h"
 
 #include <vector>
+#include <string>
 #include <iostream>
 #include <memory>
+#include <array>
 
 
 class Device;
+struct MaterialVariants;
 
 /**
  * @brief An enumeration of shader types
@@ -48,6 +52,8 @@ struct ShaderEffect {
         VkShaderStageFlagBits flags;
         VkShaderModule shaderModule;
         VkSpecializationInfo specializationConstants;
+        /** @brief SPIR-V file path, identifies the shader stage in pipeline library keys */
+        std::string source;
     };
 
     std::vector<VkDescriptorSetLayout> setLayouts;
@@ -55,6 +61,51 @@ struct ShaderEffect {
     std::vector<ShaderStage> shaderStages;
 };
 
+/**
+ * Rasterization and depth state set per draw when the pipeline uses extended dynamic state.
+ * @brief dynamic rasterization state
+ */
+struct DynamicRasterState {
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkBool32 depthTestEnable = VK_TRUE;
+    VkBool32 depthWriteEnable = VK_TRUE;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    VkBool32 depthBiasEnable = VK_FALSE;
+    float depthBiasConstantFactor = 0.0f;
+    float depthBiasClamp = 0.0f;
+    float depthBiasSlopeFactor = 0.0f;
+
+    bool operator==(const DynamicRasterState& other) const {
+        return cullMode == other.cullMode && frontFace == other.frontFace && depthTestEnable == other.depthTestEnable &&
+               depthWriteEnable == other.depthWriteEnable && depthCompareOp == other.depthCompareOp && depthBiasEnable == other.depthBiasEnable &&
+               depthBiasConstantFactor == other.depthBiasConstantFactor && depthBiasClamp == other.depthBiasClamp && depthBiasSlopeFactor == other.depthBiasSlopeFactor;
+    }
+};
+
+/**
+ * Engine features compiled into shaders through specialization constants instead of being branched on at runtime.
+ * Constant ids : 0 shadow mapping, 1 skybox, 2 atmosphere, 3 shadow cascade count, 4 GPU-driven indirect draw.
+ * Shaders not declaring a constant ignore its map entry.
+ * @brief shader variant selected by engine features
+ */
+struct ShaderVariant {
+    VkBool32 shadowMapping = VK_FALSE;
+    VkBool32 skybox = VK_FALSE;
+    VkBool32 atmosphere = VK_FALSE;
+    uint32_t cascadeCount = 1;
+    VkBool32 indirectDraw = VK_FALSE;
+
+    /** @brief unique key of the feature combination */
+    uint64_t key() const {
+        return static_cast<uint64_t>(shadowMapping) | static_cast<uint64_t>(skybox) << 1u | static_cast<uint64_t>(atmosphere) << 2u | static_cast<uint64_t>(indirectDraw) << 3u | static_cast<uint64_t>(cascadeCount) << 8u;
+    }
+
+    VkSpecializationInfo specialization() const;
+
+    static const std::array<VkSpecializationMapEntry, 5> mapEntries;
+};
+
 /**
  * Built material composed by shader stages, pipeline and pipeline layout
  * @brief Shader built material
@@ -65,16 +116,22 @@ struct ShaderPass : public Entity {
     VkPipeline pipeline;
     std::shared_ptr<ShaderEffect> effect;
     VkDevice _device;
+    /** @brief true if rasterState must be set after binding the pipeline */
+    bool dynamicRaster = false;
+    /** @brief rasterization and depth state of this material, set per draw */
+    DynamicRasterState rasterState;
+    /** @brief pass owning the pipeline, set when this material is a dynamic state variant of it */
+    std::shared_ptr<ShaderPass> sharedPass;
+    /** @brief description specialized into shader variants, set when the material is an uber-shader without pipeline */
+    std::shared_ptr<MaterialVariants> variants;
 
     ~ShaderPass() {
-        if (pipeline != VK_NULL_HANDLE) {
+        if (pipeline != VK_NULL_HANDLE && !sharedPass) {
             vkDestroyPipeline(_device, pipeline, nullptr);
+            MemoryStatistics::destroyed(ObjectCategory::PIPELINE);
             pipeline = VK_NULL_HANDLE;
         }
-        if (pipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(_device, pipelineLayout, nullptr);
-            pipelineLayout = VK_NULL_HANDLE;
-        }
+        pipelineLayout = VK_NULL_HANDLE; // owned by the pipeline layout cache
     }
 };
 
@@ -83,6 +140,5 @@ typedef ShaderPass Material;
 class Shader final {
 public:
     static bool load_shader_module(const Device& device, const char* filePath, VkShaderModule* out);
-    static bool create_shader_module(const Device& device, const std::vector<uint32_t>& code, VkShaderModule* out);
     static VkShaderStageFlagBits get_shader_stage(ShaderType type);
 };
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "vk_swapchain.h"
 #include "vk_window.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/utilities/vk_memory_statistics.h"
 
 /**
  * Implementation of SwapChain
@@ -82,12 +83,14 @@ SwapChain::SwapChain(Window& window, const Device& device) : _device(device) {
     imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     imageAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     vmaCreateImage(device._allocator, &imageInfo, &imageAllocInfo, &_depthImage, &_depthAllocation, nullptr);
+    MemoryStatistics::track(device._allocator, _depthAllocation, MemoryCategory::OTHER);
 
     VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(_depthFormat, _depthImage, VK_IMAGE_ASPECT_DEPTH_BIT);
     VK_CHECK(vkCreateImageView(device._logicalDevice, &viewInfo, nullptr, &_depthImageView));
 
     _swapChainDeletionQueue.push_function([=]() {
         vkDestroyImageView(device._logicalDevice, _depthImageView, nullptr);
+        MemoryStatistics::untrack(_depthAllocation);
         vmaDestroyImage(device._allocator, _depthImage, _depthAllocation);
         vkDestroySwapchainKHR(device._logicalDevice, _swapchain, nullptr);
     });
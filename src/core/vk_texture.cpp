@@ -14,6 +14,7 @@
 #include "vk_texture.h"
 #include "vk_buffer.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/utilities/vk_memory_statistics.h"
 
 /**
  * Release texture resources.
@@ -26,11 +27,13 @@ void Texture::destroy(const Device& device) {
     }
 
     if (this->_image) {  // destroyImage + vmaFreeMemory
+        MemoryStatistics::untrack(this->_allocation);
         vmaDestroyImage(device._allocator, this->_image, this->_allocation);
     }
 
     if (this->_sampler) {
         vkDestroySampler(device._logicalDevice, this->_sampler, nullptr);
+        MemoryStatistics::destroyed(ObjectCategory::SAMPLER);
     }
 }
 
@@ -75,15 +78,26 @@ bool Texture::load_image_from_file(const Device& device, const UploadContext& ct
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &this->_image, &this->_allocation, nullptr);
-
-    CommandBuffer::immediate_submit(device, ctx, [&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range;
-        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
+    MemoryStatistics::track(device._allocator, this->_allocation, MemoryCategory::TEXTURE);
+
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier imageBarrier_toReadable = {};
+    imageBarrier_toReadable.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier_toReadable.image = this->_image;
+    imageBarrier_toReadable.subresourceRange = range;
+    imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // Copy on transfer queue, readable layout transition is part of the ownership transfer to graphics queue
+    CommandBuffer::transfer_submit(device, ctx, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, {}, {imageBarrier_toReadable}, [&](VkCommandBuffer cmd) {
         VkImageMemoryBarrier imageBarrier_toTransfer = {};
         imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 
@@ -111,22 +125,14 @@ bool Texture::load_image_from_file(const Device& device, const UploadContext& ct
 
         //copy the buffer into the image
         vkCmdCopyBufferToImage(cmd, buffer._buffer, this->_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    });
 
-        VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-        imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+    VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &this->_sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
-        // unrelated to command buffer: can be move outside?
-        VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
-        vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &this->_sampler);
-
-        VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, this->_image, VK_IMAGE_ASPECT_COLOR_BIT);
-        vkCreateImageView(device._logicalDevice, &imageinfo, nullptr, &this->_imageView);
-    });
+    VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, this->_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCreateImageView(device._logicalDevice, &imageinfo, nullptr, &this->_imageView);
 
     // buffer.destroy();
     return true;
@@ -166,15 +172,26 @@ bool Texture::load_image_from_buffer(const Device& device, const UploadContext&
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &this->_image, &this->_allocation, nullptr);
-
-    CommandBuffer::immediate_submit(device, ctx, [&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range;
-        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
+    MemoryStatistics::track(device._allocator, this->_allocation, MemoryCategory::TEXTURE);
+
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier imageBarrier_toReadable = {};
+    imageBarrier_toReadable.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier_toReadable.image = this->_image;
+    imageBarrier_toReadable.subresourceRange = range;
+    imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // Copy on transfer queue, readable layout transition is part of the ownership transfer to graphics queue
+    CommandBuffer::transfer_submit(device, ctx, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, {}, {imageBarrier_toReadable}, [&](VkCommandBuffer cmd) {
         VkImageMemoryBarrier imageBarrier_toTransfer = {};
         imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -195,25 +212,19 @@ bool Texture::load_image_from_buffer(const Device& device, const UploadContext&
         copyRegion.bufferRowLength = 0;
         copyRegion.bufferImageHeight = 0;
         vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, this->_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    });
 
-        // Change texture image layout to shader read after all mip levels have been copied
-        this->_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-        imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+    // Change texture image layout to shader read after all mip levels have been copied
+    this->_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
-        vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &this->_sampler);
+    VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &this->_sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
-        VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, this->_image, VK_IMAGE_ASPECT_COLOR_BIT);
-        vkCreateImageView(device._logicalDevice, &imageinfo, nullptr, &this->_imageView);
+    VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, this->_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCreateImageView(device._logicalDevice, &imageinfo, nullptr, &this->_imageView);
 
-        this->updateDescriptor(); // update descriptor with sample, imageView, imageLayout
-    });
+    this->updateDescriptor(); // update descriptor with sample, imageView, imageLayout
 
     // stagingBuffer.destroy();
 
@@ -254,15 +265,26 @@ bool Texture::load_image_from_buffer(const Device& device, const UploadContext&
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &this->_image, &this->_allocation, nullptr);
-
-    CommandBuffer::immediate_submit(device, ctx, [&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range;
-        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
+    MemoryStatistics::track(device._allocator, this->_allocation, MemoryCategory::TEXTURE);
+
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier imageBarrier_toReadable = {};
+    imageBarrier_toReadable.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier_toReadable.image = this->_image;
+    imageBarrier_toReadable.subresourceRange = range;
+    imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // Copy on transfer queue, readable layout transition is part of the ownership transfer to graphics queue
+    CommandBuffer::transfer_submit(device, ctx, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, {}, {imageBarrier_toReadable}, [&](VkCommandBuffer cmd) {
         VkImageMemoryBarrier imageBarrier_toTransfer = {};
         imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -283,32 +305,25 @@ bool Texture::load_image_from_buffer(const Device& device, const UploadContext&
         copyRegion.bufferRowLength = 0;
         copyRegion.bufferImageHeight = 0;
         vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, this->_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    });
 
-        // Change texture image layout to shader read after all mip levels have been copied
-        this->_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-        imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
-
-        VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
-        samplerInfo.minFilter = sampler.minFilter;
-        samplerInfo.magFilter = sampler.magFilter;
-        samplerInfo.addressModeU = sampler.addressModeU;
-        samplerInfo.addressModeV = sampler.addressModeV;
-        samplerInfo.addressModeW = sampler.addressModeW;
-        vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &this->_sampler);
+    // Change texture image layout to shader read after all mip levels have been copied
+    this->_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, this->_image, VK_IMAGE_ASPECT_COLOR_BIT);
-        imageinfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-        vkCreateImageView(device._logicalDevice, &imageinfo, nullptr, &this->_imageView);
+    VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    samplerInfo.minFilter = sampler.minFilter;
+    samplerInfo.magFilter = sampler.magFilter;
+    samplerInfo.addressModeU = sampler.addressModeU;
+    samplerInfo.addressModeV = sampler.addressModeV;
+    samplerInfo.addressModeW = sampler.addressModeW;
+    vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &this->_sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
-        this->updateDescriptor(); // update descriptor with sample, imageView, imageLayout
+    VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, this->_image, VK_IMAGE_ASPECT_COLOR_BIT);
+    imageinfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+    vkCreateImageView(device._logicalDevice, &imageinfo, nullptr, &this->_imageView);
 
-    });
+    this->updateDescriptor(); // update descriptor with sample, imageView, imageLayout
 
     // stagingBuffer.destroy();
 
@@ -0,0 +1,370 @@
+/*
+*  H2Vk - Render queue
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_render_queue.h"
+
+#include <map>
+#include <array>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#include "components/model/vk_model.h"
+#include "core/vk_pipeline.h"
+#include "core/vk_buffer.h"
+#include "core/utilities/vk_global.h"
+#include "core/vk_bindless_table.h"
+#include "core/manager/vk_material_manager.h"
+#include "techniques/vk_frustum_culling.h"
+
+/**
+ * Primitives are enumerated like Model::draw and FrustumCulling::build. Objects sharing a model and a material add
+ * instances to the packets of the first one. Call when the scene changes.
+ * @brief flatten scene objects into instanced draw packets
+ * @param renderables
+ */
+void RenderQueue::build(const Renderables& renderables) {
+    _packets.clear();
+    _instances.clear();
+    _nodeMatrices.clear();
+    _materials.clear();
+
+    std::vector<const Model*> geometries;
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> firstPackets; // (material, geometry) : first packet
+    std::vector<std::vector<Instance>> packetInstances;
+    uint32_t primitiveIndex = 0;
+
+    for (uint32_t o = 0; o < renderables.size(); o++) {
+        const RenderObject& object = renderables[o];
+        if (!object.model) {
+            continue;
+        }
+
+        auto material = std::find(_materials.begin(), _materials.end(), object.material);
+        if (material == _materials.end()) {
+            material = _materials.insert(_materials.end(), object.material);
+        }
+        auto geometry = std::find(geometries.begin(), geometries.end(), object.model.get());
+        if (geometry == geometries.end()) {
+            geometry = geometries.insert(geometries.end(), object.model.get());
+        }
+
+        DrawPacket packet{};
+        packet.model = object.model.get();
+        packet.material = static_cast<uint32_t>(material - _materials.begin());
+        packet.geometry = static_cast<uint32_t>(geometry - geometries.begin());
+
+        // Instances of a model enumerate the same primitives : their packets follow the first packet in order
+        auto first = firstPackets.find({packet.material, packet.geometry});
+        const bool instanced = first != firstPackets.end();
+        if (!instanced) {
+            first = firstPackets.emplace(std::make_pair(packet.material, packet.geometry), static_cast<uint32_t>(_packets.size())).first;
+        }
+        uint32_t packetIndex = first->second;
+
+        const Model& model = *object.model;
+        std::function<void(const Node*, const glm::mat4&)> add_node = [&](const Node* node, const glm::mat4& parentMatrix) {
+            const glm::mat4 nodeMatrix = parentMatrix * node->matrix;
+            if (!instanced) {
+                packet.node = static_cast<uint32_t>(_nodeMatrices.size());
+                _nodeMatrices.push_back(nodeMatrix);
+            }
+
+            for (const Primitive& primitive : node->mesh.primitives) {
+                Instance instance{};
+                instance.object = o;
+                instance.primitive = primitiveIndex++;
+                if (primitive.indexCount == 0) {
+                    continue;
+                }
+
+                if (!instanced) {
+                    packet.firstIndex = primitive.firstIndex;
+                    packet.indexCount = primitive.indexCount;
+                    packet.materialIndex = BindlessTable::DEFAULT_INDEX;
+                    if (!model._materials.empty() && primitive.materialIndex != -1) {
+                        packet.materialIndex = model._materials[primitive.materialIndex]._bindlessIndex;
+                    }
+                    _packets.push_back(packet);
+                    packetInstances.emplace_back();
+                }
+
+                glm::vec3 min, max;
+                FrustumCulling::transform_bounds(primitive.boundsMin, primitive.boundsMax, object.transformMatrix * nodeMatrix, min, max);
+                instance.center = primitive.boundsMin.x > primitive.boundsMax.x ? glm::vec3(object.transformMatrix[3]) : (min + max) * 0.5f;
+                packetInstances[packetIndex++].push_back(instance);
+            }
+            for (const Node* child : node->children) {
+                add_node(child, nodeMatrix);
+            }
+        };
+
+        // Node matrices are pushed as is : the object transform is applied in the vertex shader
+        for (const Node* node : model._nodes) {
+            add_node(node, glm::mat4(1.0f));
+        }
+    }
+
+    // Instances of a packet are contiguous
+    for (uint32_t i = 0; i < _packets.size(); i++) {
+        _packets[i].firstInstance = static_cast<uint32_t>(_instances.size());
+        _packets[i].instanceCount = static_cast<uint32_t>(packetInstances[i].size());
+        _instances.insert(_instances.end(), packetInstances[i].begin(), packetInstances[i].end());
+    }
+
+    _ranges.resize(_packets.size());
+    _entries.reserve(_packets.size());
+    _scratch.reserve(_packets.size());
+}
+
+/**
+ * Depth is the view space distance, only its float bits are kept : positive floats sort like their bit patterns.
+ * @brief build a draw sort key
+ * @param layout pipeline layout slot
+ * @param pipeline pipeline slot
+ * @param material material slot
+ * @param geometry geometry slot
+ * @param depth view space depth
+ * @return sort key
+ */
+uint64_t RenderQueue::sort_key(uint32_t layout, uint32_t pipeline, uint32_t material, uint32_t geometry, float depth) {
+    uint32_t depthBits;
+    depth = std::max(depth, 0.0f);
+    std::memcpy(&depthBits, &depth, sizeof(float));
+
+    return (static_cast<uint64_t>(layout & 0xFFu) << 56u) |
+           (static_cast<uint64_t>(pipeline & 0xFFFu) << 44u) |
+           (static_cast<uint64_t>(material & 0xFFFu) << 32u) |
+           (static_cast<uint64_t>(geometry & 0xFFFu) << 20u) |
+           static_cast<uint64_t>((depthBits >> 11u) & 0xFFFFFu);
+}
+
+/**
+ * Least significant digit radix sort, 8 bits per pass. Byte histograms are computed in a single read and passes
+ * where every key shares the same byte are skipped. Stable : equal keys keep their packet order.
+ * @brief sort entries by key
+ * @param entries entries to sort, sorted on return
+ * @param scratch temporary storage
+ */
+void RenderQueue::radix_sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+    const size_t count = entries.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+
+    std::array<std::array<uint32_t, 256>, 8> histograms{};
+    for (const SortEntry& entry : entries) {
+        for (uint32_t pass = 0; pass < 8; pass++) {
+            histograms[pass][(entry.key >> (pass * 8u)) & 0xFFu]++;
+        }
+    }
+
+    SortEntry* source = entries.data();
+    SortEntry* destination = scratch.data();
+    for (uint32_t pass = 0; pass < 8; pass++) {
+        std::array<uint32_t, 256>& histogram = histograms[pass];
+        if (histogram[(source[0].key >> (pass * 8u)) & 0xFFu] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram) {
+            const uint32_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; i++) {
+            destination[histogram[(source[i].key >> (pass * 8u)) & 0xFFu]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+
+    if (source != entries.data()) {
+        entries.swap(scratch);
+    }
+}
+
+/**
+ * Object indices of visible instances are written to the frame instance buffer, packet after packet. A packet is
+ * sorted by its nearest visible instance.
+ * @brief resolve material variants, gather visible instances, then key and sort the packets drawn
+ * @param materialManager
+ * @param pipelineBuilder builder used for missing shader variants
+ * @param variant shader variant matching the enabled features
+ * @param culling visibility of the frame
+ * @param view camera view matrix
+ * @param frame frame recorded, owner of the instance buffer
+ */
+void RenderQueue::prepare(MaterialManager& materialManager, PipelineBuilder& pipelineBuilder, const ShaderVariant& variant, const FrustumCulling& culling, const glm::mat4& view, FrameData& frame) {
+    _variants.resize(_materials.size());
+    _layouts.resize(_materials.size());
+    _pipelines.resize(_materials.size());
+
+    std::vector<VkPipelineLayout> layouts;
+    std::vector<VkPipeline> pipelines;
+    for (size_t i = 0; i < _materials.size(); i++) {
+        _variants[i] = materialManager.get_variant(pipelineBuilder, _materials[i], variant);
+        auto layout = std::find(layouts.begin(), layouts.end(), _variants[i]->pipelineLayout);
+        if (layout == layouts.end()) {
+            layout = layouts.insert(layouts.end(), _variants[i]->pipelineLayout);
+        }
+        _layouts[i] = static_cast<uint32_t>(layout - layouts.begin());
+        auto pipeline = std::find(pipelines.begin(), pipelines.end(), _variants[i]->pipeline);
+        if (pipeline == pipelines.end()) {
+            pipeline = pipelines.insert(pipelines.end(), _variants[i]->pipeline);
+        }
+        _pipelines[i] = static_cast<uint32_t>(pipeline - pipelines.begin());
+    }
+
+    const glm::vec3 depthAxis = -glm::vec3(view[0][2], view[1][2], view[2][2]); // camera looks down -z
+    const float depthOffset = -view[3][2];
+
+    uint32_t* instanceObjects = static_cast<uint32_t*>(frame.instanceBuffer._data); // persistently mapped
+    uint32_t instanceCount = 0;
+
+    _entries.clear();
+    for (uint32_t i = 0; i < _packets.size(); i++) {
+        const DrawPacket& packet = _packets[i];
+        float depth = std::numeric_limits<float>::max();
+
+        _ranges[i] = {instanceCount, 0};
+        const uint32_t lastInstance = packet.firstInstance + packet.instanceCount;
+        for (uint32_t j = packet.firstInstance; j < lastInstance && instanceCount < MAX_DRAWS; j++) { // instance buffer holds MAX_DRAWS slots
+            const Instance& instance = _instances[j];
+            if (!culling.primitive_visible(instance.primitive)) {
+                continue;
+            }
+            instanceObjects[instanceCount++] = instance.object;
+            depth = std::min(depth, glm::dot(depthAxis, instance.center) + depthOffset);
+        }
+        _ranges[i].instanceCount = instanceCount - _ranges[i].firstInstance;
+
+        if (_ranges[i].instanceCount > 0) {
+            _entries.push_back({sort_key(_layouts[packet.material], _pipelines[packet.material], packet.material, packet.geometry, depth), i});
+        }
+    }
+
+    radix_sort(_entries, _scratch);
+}
+
+/**
+ * Must be called after prepare, within the scene render pass. Instances read their object through gl_InstanceIndex.
+ * @brief record the sorted instanced draws
+ * @param commandBuffer
+ * @param frame
+ * @param device
+ */
+void RenderQueue::record(VkCommandBuffer commandBuffer, FrameData& frame, const Device& device) {
+    _statistics = record_range(commandBuffer, frame, device, 0, static_cast<uint32_t>(_entries.size()));
+}
+
+/**
+ * Sorted draws are split into contiguous ranges recorded in parallel, one secondary command buffer per range.
+ * Must be called after prepare, the command buffers are executed within the scene render pass.
+ * @brief record the sorted instanced draws into secondary command buffers
+ * @param recorder
+ * @param frameIndex frame in flight index
+ * @param inheritance scene render pass
+ * @param frame
+ * @param device
+ * @param commandBuffers secondary command buffers, appended in draw order
+ */
+void RenderQueue::record(SecondaryRecorder& recorder, uint32_t frameIndex, const SecondaryRecorder::Inheritance& inheritance, FrameData& frame, const Device& device, std::vector<VkCommandBuffer>& commandBuffers) {
+    const uint32_t drawCount = static_cast<uint32_t>(_entries.size());
+    const uint32_t rangeCount = std::clamp(drawCount / MIN_RANGE_DRAWS, 1u, recorder.slot_count());
+
+    std::vector<Statistics> statistics(rangeCount);
+    recorder.record(frameIndex, inheritance, rangeCount, [&](VkCommandBuffer commandBuffer, uint32_t range) {
+        const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * range / rangeCount);
+        const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (range + 1) / rangeCount);
+        statistics[range] = record_range(commandBuffer, frame, device, first, last);
+    }, commandBuffers);
+
+    _statistics = {};
+    for (const Statistics& range : statistics) {
+        _statistics.draws += range.draws;
+        _statistics.instances += range.instances;
+        _statistics.pipelineBinds += range.pipelineBinds;
+        _statistics.materialBinds += range.materialBinds;
+        _statistics.layoutBinds += range.layoutBinds;
+        _statistics.geometryBinds += range.geometryBinds;
+    }
+}
+
+/**
+ * State is tracked from scratch : a range can start a command buffer. Read only, ranges can be recorded concurrently.
+ * @brief record a range of the sorted draws
+ * @param commandBuffer
+ * @param frame
+ * @param device
+ * @param first first sorted draw
+ * @param last last sorted draw (excluded)
+ * @return binds and draws recorded
+ */
+RenderQueue::Statistics RenderQueue::record_range(VkCommandBuffer commandBuffer, FrameData& frame, const Device& device, uint32_t first, uint32_t last) const {
+    const std::array<uint32_t, 2> dynOffsets = {frame.lightingOffset, frame.cascadedOffset}; // frame arena slices
+    const Material* lastMaterial = nullptr;
+    VkPipeline lastPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout lastLayout = VK_NULL_HANDLE;
+    const Model* lastModel = nullptr;
+    uint32_t lastNode = UINT32_MAX;
+    uint32_t lastMaterialIndex = UINT32_MAX;
+
+    Statistics statistics{};
+    statistics.draws = last - first;
+
+    for (uint32_t i = first; i < last; i++) {
+        const SortEntry& entry = _entries[i];
+        const DrawPacket& packet = _packets[entry.packet];
+        const Material* material = _variants[packet.material].get();
+
+        if (material->pipeline != lastPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+            lastPipeline = material->pipeline;
+            statistics.pipelineBinds++;
+        }
+        if (material != lastMaterial) { // materials sharing a pipeline may differ by their dynamic raster state
+            GraphicPipeline::set_raster_state(device, commandBuffer, *material);
+            lastMaterial = material;
+            statistics.materialBinds++;
+        }
+
+        if (material->pipelineLayout != lastLayout) { // descriptor sets and push constants stay valid across a layout
+            lastLayout = material->pipelineLayout;
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lastLayout, 0, 1, &frame.environmentDescriptor, static_cast<uint32_t>(dynOffsets.size()), dynOffsets.data());
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lastLayout, 1, 1, &frame.objectDescriptor, 0, nullptr);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lastLayout, 2, 1, &frame.materialDescriptor, 0, nullptr);
+            lastNode = UINT32_MAX;
+            lastMaterialIndex = UINT32_MAX;
+            statistics.layoutBinds++;
+        }
+
+        if (packet.model != lastModel) {
+            packet.model->bind(commandBuffer);
+            lastModel = packet.model;
+            statistics.geometryBinds++;
+        }
+
+        if (packet.node != lastNode) {
+            vkCmdPushConstants(commandBuffer, lastLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &_nodeMatrices[packet.node]);
+            lastNode = packet.node;
+        }
+        if (packet.materialIndex != lastMaterialIndex) {
+            vkCmdPushConstants(commandBuffer, lastLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4), sizeof(uint32_t), &packet.materialIndex);
+            lastMaterialIndex = packet.materialIndex;
+        }
+
+        const DrawRange& range = _ranges[entry.packet];
+        vkCmdDrawIndexed(commandBuffer, packet.indexCount, range.instanceCount, packet.firstIndex, 0, range.firstInstance);
+        statistics.instances += range.instanceCount;
+    }
+
+    return statistics;
+}
@@ -0,0 +1,120 @@
+/*
+*  H2Vk - Render queue
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "glm/glm.hpp"
+#include "core/utilities/vk_types.h"
+#include "core/vk_shaders.h"
+#include "core/vk_secondary_recorder.h"
+
+class Device;
+class Model;
+class PipelineBuilder;
+class MaterialManager;
+class FrustumCulling;
+
+/**
+ * Scene primitives are flattened into plain draw packets when the scene changes : objects sharing a model and a material
+ * are instances of the same packets. Each frame, visible instances are written to the frame instance buffer, and each
+ * packet with visible instances gets a 64-bit sort key and is radix sorted, so the recording loop changes state only
+ * when the key prefix changes. Key layout, from the most significant bits : pipeline layout (8), pipeline (12),
+ * material (12), geometry (12), depth (20). Materials sharing a pipeline differ by their dynamic raster state only.
+ * Scene materials are opaque : draws sharing a state are sorted front to back.
+ * @brief Sorted, instanced draw list of the scene meshes
+ */
+class RenderQueue final {
+public:
+    /** @brief Everything needed to record a draw, no ownership */
+    struct DrawPacket {
+        Model* model;
+        /** @brief scene material slot, resolved to a shader variant each frame */
+        uint32_t material;
+        /** @brief geometry slot (vertex and index buffers) */
+        uint32_t geometry;
+        /** @brief node matrix slot, shared by the instances */
+        uint32_t node;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        /** @brief bindless material slot, overridden by the object material if any */
+        uint32_t materialIndex;
+        /** @brief range of the packet instances */
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    /** @brief Object drawing a packet */
+    struct Instance {
+        uint32_t object;
+        /** @brief primitive index in the culling results */
+        uint32_t primitive;
+        /** @brief world space center, used for depth sorting */
+        glm::vec3 center;
+    };
+
+    /** @brief Visible instances of a packet, in the frame instance buffer */
+    struct DrawRange {
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    struct Statistics {
+        uint32_t draws = 0;
+        uint32_t instances = 0;
+        uint32_t pipelineBinds = 0;
+        /** @brief material changes, dynamic raster state set */
+        uint32_t materialBinds = 0;
+        uint32_t layoutBinds = 0;
+        uint32_t geometryBinds = 0;
+    };
+
+    void build(const Renderables& renderables);
+    void prepare(MaterialManager& materialManager, PipelineBuilder& pipelineBuilder, const ShaderVariant& variant, const FrustumCulling& culling, const glm::mat4& view, FrameData& frame);
+    void record(VkCommandBuffer commandBuffer, FrameData& frame, const Device& device);
+    void record(SecondaryRecorder& recorder, uint32_t frameIndex, const SecondaryRecorder::Inheritance& inheritance, FrameData& frame, const Device& device, std::vector<VkCommandBuffer>& commandBuffers);
+
+    Statistics statistics() const { return _statistics; };
+    const std::vector<DrawPacket>& packets() const { return _packets; };
+    const std::vector<Instance>& instances() const { return _instances; };
+    const glm::mat4& node_matrix(uint32_t node) const { return _nodeMatrices[node]; };
+
+    /** @brief Minimum number of draws recorded by a secondary command buffer */
+    static constexpr uint32_t MIN_RANGE_DRAWS = 256;
+
+    static uint64_t sort_key(uint32_t layout, uint32_t pipeline, uint32_t material, uint32_t geometry, float depth);
+    static void radix_sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+private:
+    std::vector<DrawPacket> _packets;
+    std::vector<Instance> _instances;
+    /** @brief visible instances of each packet for the current frame */
+    std::vector<DrawRange> _ranges;
+    std::vector<SortEntry> _entries;
+    std::vector<SortEntry> _scratch;
+    std::vector<glm::mat4> _nodeMatrices;
+    /** @brief scene materials, indexed by packet material slot */
+    std::vector<std::shared_ptr<Material>> _materials;
+    /** @brief shader variants of the scene materials for the current frame */
+    std::vector<std::shared_ptr<Material>> _variants;
+    /** @brief pipeline layout slot of each variant for the current frame */
+    std::vector<uint32_t> _layouts;
+    /** @brief pipeline slot of each variant for the current frame, variants sharing a pipeline share the slot */
+    std::vector<uint32_t> _pipelines;
+    Statistics _statistics;
+
+    Statistics record_range(VkCommandBuffer commandBuffer, FrameData& frame, const Device& device, uint32_t first, uint32_t last) const;
+};
@@ -9,6 +9,13 @@
 #include "vk_scene.h"
 #include "core/utilities/vk_global.h"
 #include "components/camera/vk_camera.h"
+#include "core/vk_bindless_table.h"
+#include "vk_engine.h"
+#include "core/vk_pipeline_cache.h"
+
+#include <iostream>
+#include <array>
+#include <unordered_set>
 
 void Scene::load_scene(int sceneIndex, Camera& camera) {
     if (sceneIndex == _sceneIndex) {
@@ -16,19 +23,53 @@ void Scene::load_scene(int sceneIndex, Camera& camera) {
     }
     _ready = false;
 
+    const PipelineCache::Statistics before = _engine._device->_pipelineCache->statistics();
     Camera adhocCamera{};
     auto renderables = SceneListing::scenes[sceneIndex].second(adhocCamera, &_engine);
 
     camera = adhocCamera;
-    _sceneIndex = sceneIndex;
-    _renderables.clear();
+
+    // Previous models (buffers, textures) are released once in-flight frames stop using them
+    auto retired = std::make_shared<Renderables>(std::move(_renderables));
+    g_deletionQueue.retire(retired);
     _renderables = renderables;
+    _sceneIndex = sceneIndex;
+
+    // Variants of the enabled features are compiled before the scene is shown, not while its first frame is recorded
+    _engine._materialManager->wait(prepare_variants(_engine.shader_variant()));
     _ready = true;
+
+    const BindlessTable::Statistics stats = _engine._bindless->statistics();
+    std::cout << "Scene " << SceneListing::scenes[sceneIndex].first << " : "
+              << stats.textures << " textures (" << stats.sharedTextures << " shared), "
+              << stats.materials << " materials (" << stats.sharedMaterials << " shared)" << std::endl;
+
+    const PipelineCache::Statistics after = _engine._device->_pipelineCache->statistics();
+    std::cout << "Scene " << SceneListing::scenes[sceneIndex].first << " : " << after.pipelineCount - before.pipelineCount
+              << " pipelines created in " << after.creationTime - before.creationTime << " ms" << std::endl;
+}
+
+/**
+ * Variants are compiled on the job system, the previous variants are drawn meanwhile.
+ * @brief queue the shader variant of every scene material
+ * @param variant engine features specialized into the shaders
+ * @return specialized materials, available once compiled
+ */
+std::vector<MaterialManager::MaterialFuture> Scene::prepare_variants(const ShaderVariant& variant) {
+    std::vector<MaterialManager::MaterialFuture> variants;
+    std::unordered_set<const Material*> materials;
+    for (const auto& renderable : _renderables) {
+        if (materials.insert(renderable.material.get()).second) {
+            variants.push_back(_engine._materialManager->prepare_variant(*_engine._pipelineBuilder, renderable.material, variant));
+        }
+    }
+    return variants;
 }
 
 void Scene::allocate_buffers(Device& device) {
     for (int i = 0; i < FRAME_OVERLAP; i++) {
-        Buffer::create_buffer(device, &g_frames[i].objectBuffer, sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        Buffer::create_buffer(device, &g_frames[i].objectBuffer, sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        Buffer::create_buffer(device, &g_frames[i].instanceBuffer, sizeof(uint32_t) * MAX_DRAWS * INSTANCE_PASSES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
     }
 }
 
@@ -48,16 +89,28 @@ void Scene::setup_transformation_descriptors(DescriptorLayoutCache& layoutCache,
         objectsBInfo.offset = 0;
         objectsBInfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
 
+        VkDescriptorBufferInfo drawsBInfo{};
+        drawsBInfo.buffer = g_frames[i].drawBuffer._buffer;
+        drawsBInfo.offset = 0;
+        drawsBInfo.range = sizeof(GPUDrawData) * MAX_DRAWS;
+
+        VkDescriptorBufferInfo instancesBInfo{};
+        instancesBInfo.buffer = g_frames[i].instanceBuffer._buffer;
+        instancesBInfo.offset = 0;
+        instancesBInfo.range = sizeof(uint32_t) * MAX_DRAWS * INSTANCE_PASSES;
+
         DescriptorBuilder::begin(layoutCache, allocator)
                 .bind_buffer(objectsBInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0)
+                .bind_buffer(drawsBInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1)
+                .bind_buffer(instancesBInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2)
                 .layout(setLayout)
                 .build(g_frames[i].objectDescriptor, setLayout, poolSizes);
     }
 }
 
-void Scene::setup_texture_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout) {
+void Scene::setup_texture_descriptors(BindlessTable& bindlessTable) {
     for (auto &renderable: this->_renderables) {
-        renderable.model->setup_descriptors(layoutCache, allocator, setLayout); // Duplicate with scene listing. Not multi-thread safe. Use global _renderables.
+        renderable.model->setup_descriptors(bindlessTable); // Duplicate with scene listing. Not multi-thread safe. Use global _renderables.
     }
 }
 
@@ -66,29 +119,89 @@ void Scene::setup_texture_descriptors(DescriptorLayoutCache& layoutCache, Descri
  * @param commandBuffer
  */
 void Scene::render_objects(VkCommandBuffer commandBuffer, FrameData& frame) {
-    std::shared_ptr<Model> lastModel = nullptr;
-    std::shared_ptr<Material> lastMaterial = nullptr;
-    // uint32_t frameIndex = _frameNumber % FRAME_OVERLAP;
-
-    uint32_t count = _renderables.size();
-    RenderObject *first = _renderables.data();
-
-    for (int i=0; i < count; i++) { // For each scene/object in the vector of scenes.
-        RenderObject& object = first[i]; // Take the scene/object
-
-        if (object.material != lastMaterial) {
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-            lastMaterial = object.material;
-            // uint32_t lightOffset = helper::pad_uniform_buffer_size(*_device,sizeof(GPULightData)) * frameIndex;
-            std::vector<uint32_t> dynOffsets = {0, 0};
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 0, 1, &frame.environmentDescriptor, 2, dynOffsets.data());
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 1, 1, &frame.objectDescriptor, 0,nullptr);
+    const ShaderVariant variant = _engine.shader_variant();
+
+    if (variant.indirectDraw) {
+        render_indirect(commandBuffer, frame, variant);
+        return;
+    }
+
+    prepare_queue(frame, variant);
+    _queue.record(commandBuffer, frame, *_engine._device);
+}
+
+/**
+ * Culling and sorting run on the calling thread, the sorted draws are recorded in parallel. The GPU-driven path records
+ * a few batches only : it keeps a single command buffer.
+ * @brief Render scene assets into secondary command buffers
+ * @param recorder
+ * @param frameIndex frame in flight index
+ * @param inheritance scene render pass
+ * @param frame
+ * @param commandBuffers secondary command buffers, appended in draw order
+ */
+void Scene::render_objects(SecondaryRecorder& recorder, uint32_t frameIndex, const SecondaryRecorder::Inheritance& inheritance, FrameData& frame, std::vector<VkCommandBuffer>& commandBuffers) {
+    const ShaderVariant variant = _engine.shader_variant();
+
+    if (variant.indirectDraw) {
+        recorder.record(frameIndex, inheritance, 1, [&](VkCommandBuffer commandBuffer, uint32_t) {
+            render_indirect(commandBuffer, frame, variant);
+        }, commandBuffers);
+        return;
+    }
+
+    prepare_queue(frame, variant);
+    _queue.record(recorder, frameIndex, inheritance, frame, *_engine._device, commandBuffers);
+}
+
+/**
+ * GPU-driven path : one indirect draw per batch, visible primitives are selected by the culling pass
+ * @brief Render scene batches
+ * @param commandBuffer
+ * @param frame
+ * @param variant shader variant matching the enabled features
+ */
+void Scene::render_indirect(VkCommandBuffer commandBuffer, FrameData& frame, const ShaderVariant& variant) {
+    const std::array<uint32_t, 2> dynOffsets = {frame.lightingOffset, frame.cascadedOffset}; // frame arena slices
+    const Material* lastMaterial = nullptr;
+    const Model* lastModel = nullptr;
+    std::shared_ptr<Material> material = nullptr; // shader variant of the last material
+    VkPipelineLayout lastLayout = VK_NULL_HANDLE;
+
+    const auto& batches = _engine._indirectDraw->batches();
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        const IndirectDraw::Batch& batch = batches[i];
+        if (batch.material.get() != lastMaterial) {
+            material = _engine._materialManager->get_variant(*_engine._pipelineBuilder, batch.material, variant);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+            GraphicPipeline::set_raster_state(*_engine._device, commandBuffer, *material);
+            lastMaterial = batch.material.get();
+        }
+
+        if (material->pipelineLayout != lastLayout) {
+            lastLayout = material->pipelineLayout;
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 0, 1, &frame.environmentDescriptor, static_cast<uint32_t>(dynOffsets.size()), dynOffsets.data());
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 1, 1, &frame.objectDescriptor, 0,nullptr);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &frame.materialDescriptor, 0, nullptr);
         }
 
-        if (object.model) {
-            bool bind = object.model.get() != lastModel.get();
-            object.model->draw(commandBuffer, object.material->pipelineLayout, sizeof(glm::mat4), i, bind);
-            lastModel = bind ? object.model : lastModel;
+        if (batch.model.get() != lastModel) {
+            batch.model->bind(commandBuffer);
+            lastModel = batch.model.get();
         }
+        _engine._indirectDraw->draw(commandBuffer, frame, i);
     }
+}
+
+/**
+ * CPU path : cull, gather visible instances, sort draws by state and depth
+ * @brief Prepare the render queue of the frame
+ * @param frame
+ * @param variant shader variant matching the enabled features
+ */
+void Scene::prepare_queue(FrameData& frame, const ShaderVariant& variant) {
+    Camera& camera = *_engine._camera;
+    const glm::mat4 view = camera.get_view_matrix();
+    _culling.cull(Camera::frustum_planes(camera.get_projection_matrix() * view));
+    _queue.prepare(*_engine._materialManager, *_engine._pipelineBuilder, variant, _culling, view, frame);
 }
\ No newline at end of file
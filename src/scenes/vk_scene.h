@@ -9,11 +9,15 @@
 #pragma once
 
 #include "vk_scene_listing.h"
+#include "vk_render_queue.h"
+#include "techniques/vk_frustum_culling.h"
+#include "core/manager/vk_material_manager.h"
 #include <mutex>
 
 class VulkanEngine;
 class Camera;
 class Texture;
+class BindlessTable;
 
 class Scene final {
 public:
@@ -25,15 +29,24 @@ public:
     Renderables _renderables;
     /** @brief Resource synchronizer */
     bool _ready = false;
+    /** @brief Visibility of objects and primitives */
+    FrustumCulling _culling;
+    /** @brief Sorted draws of the visible primitives */
+    RenderQueue _queue;
 
     explicit Scene(VulkanEngine& engine) : _engine(engine) {};
 
     void load_scene(int sceneIndex, Camera& camera);
+    std::vector<MaterialManager::MaterialFuture> prepare_variants(const ShaderVariant& variant);
     void render_objects(VkCommandBuffer commandBuffer, FrameData& frame);
+    void render_objects(SecondaryRecorder& recorder, uint32_t frameIndex, const SecondaryRecorder::Inheritance& inheritance, FrameData& frame, std::vector<VkCommandBuffer>& commandBuffers);
     static void allocate_buffers(Device& device);
     void setup_transformation_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout);
-    void setup_texture_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout);
+    void setup_texture_descriptors(BindlessTable& bindlessTable);
 
 private:
     VulkanEngine& _engine;
+
+    void render_indirect(VkCommandBuffer commandBuffer, FrameData& frame, const ShaderVariant& variant);
+    void prepare_queue(FrameData& frame, const ShaderVariant& variant);
 };
\ No newline at end of file
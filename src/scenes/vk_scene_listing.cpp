@@ -57,7 +57,7 @@ Renderables SceneListing::spheres(Camera& camera, VulkanEngine* engine) {
     // === Init shader materials ===
     std::vector<PushConstant> constants {
             {sizeof(glm::mat4), ShaderType::VERTEX},
-            {sizeof(Materials::Factors), ShaderType::FRAGMENT}
+            {sizeof(uint32_t), ShaderType::FRAGMENT} // bindless material index
     };
 
     std::vector<std::pair<ShaderType, const char*>> modules {
@@ -65,51 +65,54 @@ Renderables SceneListing::spheres(Camera& camera, VulkanEngine* engine) {
             {ShaderType::FRAGMENT, "../src/shaders/pbr/pbr_ibl.frag.spv"},
     };
 
-    floorModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, engine->_descriptorSetLayouts.textures);
+    floorModel->setup_descriptors(*engine->_bindless);
     std::vector<VkDescriptorSetLayout> setLayouts = {engine->_descriptorSetLayouts.environment, engine->_descriptorSetLayouts.matrices, engine->_descriptorSetLayouts.textures};
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "pbrMaterial", setLayouts, constants, modules);
 
-    wallModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, engine->_descriptorSetLayouts.textures);
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "pbrMaterial2", setLayouts, constants, modules);
+    // Materials are compiled on the job system while meshes are built, one per plane renderable, in order
+    std::vector<MaterialManager::MaterialFuture> materials;
+    materials.push_back(engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "pbrMaterial", setLayouts, constants, modules));
 
-    std::vector<VkDescriptorSetLayout> shadowSetLayouts = {engine->_descriptorSetLayouts.environment, engine->_descriptorSetLayouts.matrices};
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "shadowScene", shadowSetLayouts, constants, modules);
+    wallModel->setup_descriptors(*engine->_bindless);
+    materials.push_back(engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "pbrMaterial2", setLayouts, constants, modules));
+
+    MaterialManager::MaterialFuture shadowScene = engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "shadowScene", setLayouts, constants, modules);
 
     RenderObject floor;
     floor.model = engine->_meshManager->get_model("floor");
-    floor.material = engine->_materialManager->get_material("pbrMaterial");
     floor.transformMatrix = glm::mat4{ 1.0f };
     renderables.push_back(floor);
 
     RenderObject wall;
     wall.model = engine->_meshManager->get_model("wall");
-    wall.material = engine->_materialManager->get_material("pbrMaterial2");
     wall.transformMatrix = glm::mat4{ 1.0f };
     renderables.push_back(wall);
 
+    // Spheres share one mesh and one pipeline : they are drawn as instances, each picks its material in the object buffer
+    std::shared_ptr<Model> sphereModel = ModelPOLY::get_uv_sphere(*engine->_meshManager, engine->_device.get(), engine->_uploadContext, {0.0f, 0.0f, -5.0f}, 1.0f, 32, 32, {1.0f, 1.0f, 1.0f});
+    MaterialManager::MaterialFuture sphereMaterial = engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "spherePbrMaterial", setLayouts, constants, modules);
+
     for (int x = 0; x <= 6; x++) {
         for (int y = 0; y <= 6; y++) {
             float ratio_x = static_cast<float>(x) / 6.0f;
             float ratio_y = static_cast<float>(y) / 6.0f;
             Materials gold = {{1.0f,  0.765557f, 0.336057f, 1.0f}, ratio_y * 1.0f, ratio_x * 1.0f, 1.0f};
-            std::string name = "sphere_" + std::to_string(x) + "_" + std::to_string(y);
-            std::shared_ptr<Model> sphereModel = ModelPOLY::create_uv_sphere(engine->_device.get(), engine->_uploadContext, {0.0f, 0.0f, -5.0f}, 1.0f, 32, 32, {1.0f,1.0f,  1.0f}, gold);
-
-            sphereModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, engine->_descriptorSetLayouts.textures);
-            engine->_materialManager->create_material(*engine->_pipelineBuilder, "spherePbrMaterial_" + std::to_string(7 * x + y), setLayouts, constants, modules);
-
-            engine->_meshManager->upload_mesh(*sphereModel);
-            engine->_meshManager->add_entity(name, std::static_pointer_cast<Entity>(sphereModel));
 
             RenderObject sphere;
-            sphere.model = engine->_meshManager->get_model(name);
-            sphere.material = engine->_materialManager->get_material("spherePbrMaterial_" + std::to_string(7 * x + y));
+            sphere.model = sphereModel;
+            sphere.materialIndex = static_cast<int32_t>(sphereModel->add_material(gold));
             glm::mat4 translation = glm::translate(glm::mat4{ 1.0 }, glm::vec3(x - 3, y - 3, 0));
             glm::mat4 scale = glm::scale(glm::mat4{ 1.0 }, glm::vec3(0.5, 0.5, 0.5));
             sphere.transformMatrix = translation * scale;
             renderables.push_back(sphere);
         }
     }
+    sphereModel->setup_descriptors(*engine->_bindless);
+
+    engine->_materialManager->wait(materials);
+    engine->_materialManager->wait({sphereMaterial, shadowScene});
+    for (size_t i = 0; i < renderables.size(); i++) {
+        renderables[i].material = i < materials.size() ? materials[i].get() : sphereMaterial.get();
+    }
 
     return renderables;
 }
@@ -124,19 +127,10 @@ Renderables SceneListing::damagedHelmet(Camera& camera, VulkanEngine* engine) {
     camera.set_type(Camera::Type::look_at);
     camera.set_speed(10.0f);
 
-    // === Add entities ===
-    std::shared_ptr<ModelGLTF2> helmetModel = std::make_shared<ModelGLTF2>(engine->_device.get());
-    helmetModel->load_model(*engine->_device, engine->_uploadContext, "../assets/damaged_helmet/gltf/DamagedHelmet.gltf");
-    engine->_meshManager->upload_mesh(*helmetModel);
-    engine->_meshManager->add_entity("helmet", std::static_pointer_cast<Entity>(helmetModel));
-
-    engine->_lightingManager->clear_entities();
-    engine->_lightingManager->add_entity("sun", std::make_shared<Light>(glm::vec4(0.f, 0.f, 0.f, 0.f),  glm::vec4(1.f)));
-
     // === Init shader materials ===
     std::vector<PushConstant> constants {
             {sizeof(glm::mat4), ShaderType::VERTEX},
-            {sizeof(Materials::Factors), ShaderType::FRAGMENT}
+            {sizeof(uint32_t), ShaderType::FRAGMENT} // bindless material index
     };
 
     std::vector<std::pair<ShaderType, const char*>> pbr_modules {
@@ -144,15 +138,27 @@ Renderables SceneListing::damagedHelmet(Camera& camera, VulkanEngine* engine) {
             {ShaderType::FRAGMENT, "../src/shaders/pbr/pbr_ibl_tex.frag.spv"},
     };
 
-    // VkDescriptorSetLayout textures{}; // todo : stop duplicate with _scene->setup_texture_descriptors
-    helmetModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, engine->_descriptorSetLayouts.textures);
     std::vector<VkDescriptorSetLayout> setLayouts = {engine->_descriptorSetLayouts.environment, engine->_descriptorSetLayouts.matrices, engine->_descriptorSetLayouts.textures};
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "pbrTextureMaterial", setLayouts, constants, pbr_modules);
+
+    // Compiled on the job system while the model is loaded
+    MaterialManager::MaterialFuture material = engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "pbrTextureMaterial", setLayouts, constants, pbr_modules);
+
+    // === Add entities ===
+    std::shared_ptr<ModelGLTF2> helmetModel = std::make_shared<ModelGLTF2>(engine->_device.get());
+    helmetModel->load_model(*engine->_device, engine->_uploadContext, "../assets/damaged_helmet/gltf/DamagedHelmet.gltf");
+    engine->_meshManager->upload_mesh(*helmetModel);
+    engine->_meshManager->add_entity("helmet", std::static_pointer_cast<Entity>(helmetModel));
+
+    engine->_lightingManager->clear_entities();
+    engine->_lightingManager->add_entity("sun", std::make_shared<Light>(glm::vec4(0.f, 0.f, 0.f, 0.f),  glm::vec4(1.f)));
+
+    helmetModel->setup_descriptors(*engine->_bindless);
 
     // == Init scene ==
     RenderObject helmet;
     helmet.model = engine->_meshManager->get_model("helmet");
-    helmet.material = engine->_materialManager->get_material("pbrTextureMaterial");
+    engine->_materialManager->wait({material});
+    helmet.material = material.get();
     helmet.transformMatrix = glm::mat4{ 1.0f };
     renderables.push_back(helmet);
 
@@ -169,20 +175,10 @@ Renderables SceneListing::sponza(Camera& camera, VulkanEngine* engine) {
     camera.set_type(Camera::Type::pov);
     camera.set_speed(10.0f);
 
-    // === Add entities ===
-    std::shared_ptr<ModelGLTF2> sponzaModel = std::make_shared<ModelGLTF2>(engine->_device.get());
-    sponzaModel->load_model(*engine->_device, engine->_uploadContext, "../assets/glTF-Sample-Models/2.0/Sponza/glTF/Sponza.gltf");
-
-    engine->_meshManager->upload_mesh(*sponzaModel);
-    engine->_meshManager->add_entity("sponza", std::static_pointer_cast<Entity>(sponzaModel));
-
-    engine->_lightingManager->clear_entities();
-    engine->_lightingManager->add_entity("sun", std::make_shared<Light>(glm::vec4(0.f, 0.f, 0.f, 0.f),  glm::vec4(1.f)));
-
     // === Init shader materials ===
     std::vector<PushConstant> constants {
             {sizeof(glm::mat4), ShaderType::VERTEX},
-            {sizeof(Materials::Factors), ShaderType::FRAGMENT}
+            {sizeof(uint32_t), ShaderType::FRAGMENT} // bindless material index
     };
 
     std::vector<std::pair<ShaderType, const char*>> pbr_modules {
@@ -190,15 +186,28 @@ Renderables SceneListing::sponza(Camera& camera, VulkanEngine* engine) {
             {ShaderType::FRAGMENT, "../src/shaders/shadow_map/scene_debug.frag.spv"},
     };
 
-    VkDescriptorSetLayout textures{};
-    sponzaModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, textures);
-    std::vector<VkDescriptorSetLayout> setLayouts = {engine->_descriptorSetLayouts.environment, engine->_descriptorSetLayouts.matrices, textures};
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "sponzaMaterial", setLayouts, constants, pbr_modules);
+    std::vector<VkDescriptorSetLayout> setLayouts = {engine->_descriptorSetLayouts.environment, engine->_descriptorSetLayouts.matrices, engine->_descriptorSetLayouts.textures};
+
+    // Compiled on the job system while the model is loaded
+    MaterialManager::MaterialFuture material = engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "sponzaMaterial", setLayouts, constants, pbr_modules);
+
+    // === Add entities ===
+    std::shared_ptr<ModelGLTF2> sponzaModel = std::make_shared<ModelGLTF2>(engine->_device.get());
+    sponzaModel->load_model(*engine->_device, engine->_uploadContext, "../assets/glTF-Sample-Models/2.0/Sponza/glTF/Sponza.gltf");
+
+    engine->_meshManager->upload_mesh(*sponzaModel);
+    engine->_meshManager->add_entity("sponza", std::static_pointer_cast<Entity>(sponzaModel));
+
+    engine->_lightingManager->clear_entities();
+    engine->_lightingManager->add_entity("sun", std::make_shared<Light>(glm::vec4(0.f, 0.f, 0.f, 0.f),  glm::vec4(1.f)));
+
+    sponzaModel->setup_descriptors(*engine->_bindless);
 
     // == Init scene ==
     RenderObject sponza;
     sponza.model = engine->_meshManager->get_model("sponza");
-    sponza.material = engine->_materialManager->get_material("sponzaMaterial");
+    engine->_materialManager->wait({material});
+    sponza.material = material.get();
     sponza.transformMatrix = glm::mat4{ 1.0f };
     renderables.push_back(sponza);
 
@@ -233,7 +242,7 @@ Renderables SceneListing::field(Camera& camera, VulkanEngine* engine) {
     // === Init shader materials ===
     std::vector<PushConstant> constants {
             {sizeof(glm::mat4), ShaderType::VERTEX},
-            {sizeof(Materials::Factors), ShaderType::FRAGMENT}
+            {sizeof(uint32_t), ShaderType::FRAGMENT} // bindless material index
     };
 
    std::vector<std::pair<ShaderType, const char*>> modules {
@@ -241,17 +250,18 @@ Renderables SceneListing::field(Camera& camera, VulkanEngine* engine) {
            {ShaderType::FRAGMENT, "../src/shaders/shadow_map/scene_debug.frag.spv"},
    };
 
-    treeModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, engine->_descriptorSetLayouts.textures);
+    treeModel->setup_descriptors(*engine->_bindless);
     std::vector<VkDescriptorSetLayout> setLayouts = {engine->_descriptorSetLayouts.environment, engine->_descriptorSetLayouts.matrices, engine->_descriptorSetLayouts.textures};
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "treeMaterial", setLayouts, constants, modules);
+    MaterialManager::MaterialFuture treeMaterial = engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "treeMaterial", setLayouts, constants, modules);
 
-    fieldModel->setup_descriptors(*engine->_layoutCache, *engine->_allocator, engine->_descriptorSetLayouts.textures);
-    engine->_materialManager->create_material(*engine->_pipelineBuilder, "fieldMaterial", setLayouts, constants, modules);
+    fieldModel->setup_descriptors(*engine->_bindless);
+    MaterialManager::MaterialFuture fieldMaterial = engine->_materialManager->create_material_async(*engine->_pipelineBuilder, "fieldMaterial", setLayouts, constants, modules);
+    engine->_materialManager->wait({treeMaterial, fieldMaterial});
 
     // == Init scene ==
     RenderObject tree;
     tree.model = engine->_meshManager->get_model("tree");
-    tree.material = engine->_materialManager->get_material("treeMaterial");
+    tree.material = treeMaterial.get();
     glm::mat4 translation = glm::translate(glm::mat4{ 1.0 }, glm::vec3(1.25f, -0.25f, 1.25f));
     glm::mat4 scale = glm::scale(glm::mat4{ 1.0 }, glm::vec3(1.0f));
     tree.transformMatrix = translation * scale;
@@ -259,7 +269,7 @@ Renderables SceneListing::field(Camera& camera, VulkanEngine* engine) {
 
     RenderObject field;
     field.model = engine->_meshManager->get_model("field");
-    field.material = engine->_materialManager->get_material("fieldMaterial");
+    field.material = fieldMaterial.get();
     field.transformMatrix = glm::mat4{ 1.0f };
     renderables.push_back(field);
 
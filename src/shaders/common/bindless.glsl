@@ -0,0 +1,36 @@
+// Bindless material resources (set 2). Requires GL_EXT_nonuniform_qualifier.
+// Including shader declares a push constant block named pushData holding the material slot index (materialIndex).
+// Material index varies per instance, descriptor array indices are qualified as non-uniform.
+
+struct MaterialData {
+    vec4 baseColorFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    float alphaCutoff;
+    uint baseColorTexture;
+    uint normalTexture;
+    uint metallicRoughnessTexture;
+    uint aoTexture;
+    uint emissiveTexture;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+} materialBuffer;
+
+layout(set = 2, binding = 1) uniform sampler2D textures[];
+
+#ifndef NO_MATERIAL
+#define NO_MATERIAL 0xFFFFFFFFu
+#endif
+
+#ifndef MATERIAL_INDEX
+#define MATERIAL_INDEX pushData.materialIndex
+#endif
+
+#define material materialBuffer.materials[nonuniformEXT(MATERIAL_INDEX)]
+#define samplerAlbedoMap textures[nonuniformEXT(material.baseColorTexture)]
+#define samplerNormalMap textures[nonuniformEXT(material.normalTexture)]
+#define samplerMetalRoughnessMap textures[nonuniformEXT(material.metallicRoughnessTexture)]
+#define samplerAOMap textures[nonuniformEXT(material.aoTexture)]
+#define samplerEmissiveMap textures[nonuniformEXT(material.emissiveTexture)]
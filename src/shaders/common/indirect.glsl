@@ -0,0 +1,29 @@
+// GPU-driven draws (set 1, binding 1). Requires GL_GOOGLE_include_directive.
+// Each indirect command draws one primitive, its instance index selects the primitive transformation and material.
+
+layout (constant_id = 4) const bool INDIRECT_DRAW = false;
+
+struct DrawData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint firstIndex;
+    uint indexCount;
+    uint materialIndex;
+    uint batch;
+    uint commandOffset;
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer DrawBuffer {
+    DrawData draws[];
+} drawBuffer;
+
+// Instanced draws (set 1, binding 2) : the instance index selects a slot holding the object index.
+// Objects drawn with the same primitive occupy consecutive slots, written each frame by the render queue.
+
+#ifndef NO_MATERIAL
+#define NO_MATERIAL 0xFFFFFFFFu
+#endif
+
+layout (std430, set = 1, binding = 2) readonly buffer InstanceBuffer {
+    uint objects[];
+} instanceBuffer;
@@ -28,3 +28,4 @@ glslc shadow_map/csm_offscreen.frag -o shadow_map/csm_offscreen.frag.spv
 glslc shadow_map/csm_debug_quad.vert -o shadow_map/csm_debug_quad.vert.spv
 glslc shadow_map/csm_debug_quad.frag -o shadow_map/csm_debug_quad.frag.spv
 glslc shadow_map/scene_debug.frag -o shadow_map/scene_debug.frag.spv
+glslc culling/frustum_culling.comp -o culling/frustum_culling.comp.spv
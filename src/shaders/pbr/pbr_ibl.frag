@@ -1,11 +1,16 @@
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "../common/constants.glsl"
 #include "../common/brdf.glsl"
 #include "../common/filters.glsl"
 #include "../common/debug.glsl"
 
+// Engine features, specialized per material variant
+layout (constant_id = 0) const bool SHADOW_MAPPING = false;
+layout (constant_id = 3) const uint SHADOW_CASCADES = 4; // CASCADE_COUNT
+
 layout (std140, set = 0, binding = 0) uniform EnabledFeaturesData {
     bool shadowMapping;
     bool skybox;
@@ -45,13 +50,14 @@ layout (location = 3) in vec3 inFragPos;
 layout (location = 4) in vec3 inCameraPos;
 layout (location = 5) in vec3 inViewPos;
 layout (location = 6) in vec3 inTangent;
+layout (location = 7) flat in uint inMaterialIndex;
+
+layout (push_constant) uniform PushConstants {
+    layout(offset = 64) uint materialIndex;
+} pushData;
 
-layout (push_constant) uniform Material {
-    layout(offset = 64) vec4 albedo; // update offset for csm
-    layout(offset = 80) float metallic;
-    layout(offset = 84) float roughness;
-    layout(offset = 88) float ao;
-} material;
+#define MATERIAL_INDEX (inMaterialIndex != NO_MATERIAL ? inMaterialIndex : pushData.materialIndex)
+#include "../common/bindless.glsl"
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -67,8 +73,8 @@ vec3 prefiltered_reflection(vec3 R, float roughness) {
 
 vec3 BRDF(vec3 N, vec3 L, vec3 V, vec3 C) {
     vec3 color = vec3(0.0);
-    float roughness = material.roughness;
-    vec3 F0 = mix(vec3(0.02), material.albedo.rgb, material.metallic);
+    float roughness = material.roughnessFactor;
+    vec3 F0 = mix(vec3(0.02), material.baseColorFactor.rgb, material.metallicFactor);
 
 
     vec3 H = normalize(V + L);
@@ -83,8 +89,8 @@ vec3 BRDF(vec3 N, vec3 L, vec3 V, vec3 C) {
         float G = G_GGX(dotNL, dotNV, roughness);
         vec3 F = F_Schlick(F0, dotHV); // dotNV
         vec3 spec = D * G * F / (4.0 * dotNL * dotNV + 0.001);
-        vec3 kd = (vec3(1.0) - F) * (1.0 - material.metallic);
-        color += (kd * material.albedo.rgb / PI + spec) * dotNL;
+        vec3 kd = (vec3(1.0) - F) * (1.0 - material.metallicFactor);
+        color += (kd * material.baseColorFactor.rgb / PI + spec) * dotNL;
     }
 
     return color;
@@ -121,7 +127,7 @@ vec3 directional_light(vec3 Lo, vec3 N, vec3 V) {
 
 void main()
 {
-    float roughness = material.roughness;
+    float roughness = material.roughnessFactor;
     vec3 V = normalize(inCameraPos - inFragPos);
     vec3 N = normalize(inNormal);
     vec3 R = -normalize(reflect(V, N));
@@ -137,14 +143,14 @@ void main()
     vec3 reflection = prefiltered_reflection(R, roughness).rgb;
     vec3 irradiance = texture(irradianceMap, N).rgb;
 
-    vec3 diffuse = irradiance *  material.albedo.rgb;
+    vec3 diffuse = irradiance *  material.baseColorFactor.rgb;
 
-    vec3 F0 = mix(vec3(0.02), material.albedo.rgb, material.metallic);
+    vec3 F0 = mix(vec3(0.02), material.baseColorFactor.rgb, material.metallicFactor);
     vec3 F = F_SchlickR(F0, max(dot(N, V), 0.0), roughness);
 
     vec3 specular = reflection * (F * brdf.x + brdf.y);
 
-    vec3 kD = (vec3(1.0) - F) * (1.0 - material.metallic);
+    vec3 kD = (vec3(1.0) - F) * (1.0 - material.metallicFactor);
     vec3 ambient = (kD * diffuse + specular);
 
     vec3 color = ambient + Lo;
@@ -155,10 +161,10 @@ void main()
     // Convert from linear to sRGB ! Do not use for Vulkan !
     // color = pow(color, vec3(0.4545)); // Gamma correction
 
-    if (enabledFeaturesData.shadowMapping == true) {
+    if (SHADOW_MAPPING) {
         // Cascaded shadow mapping
         uint cascadeIndex = 0;
-        for(uint i = 0; i < CASCADE_COUNT - 1; ++i) {
+        for(uint i = 0; i < min(SHADOW_CASCADES, uint(CASCADE_COUNT)) - 1u; ++i) {
             if(inViewPos.z < depthData.splitDepth[i]) {
                 cascadeIndex = i + 1;
             }
@@ -1,4 +1,5 @@
 #version 460
+#extension GL_GOOGLE_include_directive : enable
 
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inNormal;
@@ -13,6 +14,7 @@ layout (location = 3) out vec3 outFragPos;
 layout (location = 4) out vec3 outCameraPos;
 layout (location = 5) out vec3 outViewPos;
 layout (location = 6) out vec3 outTangent;
+layout (location = 7) flat out uint outMaterialIndex;
 
 layout(std140, set = 0, binding = 1) uniform  CameraBuffer
 {
@@ -24,6 +26,7 @@ layout(std140, set = 0, binding = 1) uniform  CameraBuffer
 
 struct ObjectData {
     mat4 model;
+    uint materialIndex; // bindless material slot overriding the primitive one, NO_MATERIAL if none
 };
 
 layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
@@ -34,9 +37,19 @@ layout (push_constant) uniform NodeModel {
     mat4 model;
 } nodeData;
 
+#include "../common/indirect.glsl"
+
 void main()
 {
-    mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model * nodeData.model;
+    mat4 modelMatrix;
+    if (INDIRECT_DRAW) {
+        modelMatrix = drawBuffer.draws[gl_BaseInstance].model;
+        outMaterialIndex = drawBuffer.draws[gl_BaseInstance].materialIndex;
+    } else {
+        ObjectData object = objectBuffer.objects[instanceBuffer.objects[gl_InstanceIndex]];
+        modelMatrix = object.model * nodeData.model;
+        outMaterialIndex = object.materialIndex;
+    }
     mat4 transformMatrix = (cameraData.view * cameraData.proj * modelMatrix);
     vec4 pos = modelMatrix * vec4(inPosition, 1.0f);
 
@@ -1,6 +1,7 @@
 #version 460
 #extension GL_EXT_debug_printf : enable
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "../common/constants.glsl"
 #include "../common/brdf.glsl"
@@ -8,6 +9,10 @@
 #include "../common/tonemaps.glsl"
 #include "../common/debug.glsl"
 
+// Engine features, specialized per material variant
+layout (constant_id = 0) const bool SHADOW_MAPPING = false;
+layout (constant_id = 3) const uint SHADOW_CASCADES = 4; // CASCADE_COUNT
+
 layout(std140, set = 0, binding = 0) uniform EnabledFeaturesData {
     bool shadowMapping;
     bool skybox;
@@ -43,11 +48,12 @@ layout(set = 0, binding = 5) uniform samplerCube prefilteredMap;
 layout(set = 0, binding = 6) uniform sampler2D brdfMap;
 layout(set = 0, binding = 7) uniform sampler2DArray shadowMap;
 
-layout(set = 2, binding = 0) uniform sampler2D samplerAlbedoMap;
-layout(set = 2, binding = 1) uniform sampler2D samplerNormalMap;
-layout(set = 2, binding = 2) uniform sampler2D samplerMetalRoughnessMap;
-layout(set = 2, binding = 3) uniform sampler2D samplerAOMap;
-layout(set = 2, binding = 4) uniform sampler2D samplerEmissiveMap;
+layout (push_constant) uniform PushConstants {
+    layout(offset = 64) uint materialIndex;
+} pushData;
+
+#define MATERIAL_INDEX (inMaterialIndex != NO_MATERIAL ? inMaterialIndex : pushData.materialIndex)
+#include "../common/bindless.glsl"
 
 layout (location = 0) in vec3 inColor;
 layout (location = 1) in vec2 inUV;
@@ -56,6 +62,7 @@ layout (location = 3) in vec3 inFragPos; // fragment/world position
 layout (location = 4) in vec3 inCameraPos; // camera/view position
 layout (location = 5) in vec3 inViewPos;
 layout (location = 6) in vec3 inTangent;
+layout (location = 7) flat in uint inMaterialIndex;
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -197,10 +204,10 @@ void main()
     // color = uncharted2_tonemap(color);
     // color = color * (1.0f / uncharted2_tonemap(vec3(11.2f)));
 
-    if (enabledFeaturesData.shadowMapping == true) {
+    if (SHADOW_MAPPING) {
        // Cascaded shadow mapping
         uint cascadeIndex = 0;
-        for(uint i = 0; i < CASCADE_COUNT - 1; ++i) {
+        for(uint i = 0; i < min(SHADOW_CASCADES, uint(CASCADE_COUNT)) - 1u; ++i) {
             if(inViewPos.z < depthData.splitDepth[i]) {
                 cascadeIndex = i + 1;
             }
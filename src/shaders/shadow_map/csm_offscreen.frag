@@ -1,13 +1,19 @@
-#version 450
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout (set = 2, binding = 0) uniform sampler2D colorMap;
+layout (push_constant) uniform PushConstants {
+    layout(offset = 68) uint materialIndex;
+} pushData;
+
+#include "../common/bindless.glsl"
 
 layout (location = 0) in vec2 inUV;
 
 void main() 
 {	
     // No shadow if transparency : BUG - segfault if use with non-pbr shader
-	float alpha = texture(colorMap, inUV).a;
+	float alpha = texture(samplerAlbedoMap, inUV).a;
 	if (alpha < 0.5) {
 		discard;
 	}
@@ -1,5 +1,6 @@
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_multiview : enable
 
 #include "../common/constants.glsl"
 
@@ -11,6 +12,8 @@ layout (location = 4) in vec4 vTangent;
 
 layout (location = 0) out vec2 outUV;
 
+layout (constant_id = 5) const bool MULTIVIEW = false; // one view per cascade, the push constant index is ignored
+
 layout (std140, set = 0, binding = 0) uniform ShadowData {
     layout(offset = 0) mat4 cascadeVP[CASCADE_COUNT];
     layout(offset = 256) vec4 splitDepth;
@@ -18,12 +21,18 @@ layout (std140, set = 0, binding = 0) uniform ShadowData {
 
 struct ObjectData {
     mat4 model;
+    uint materialIndex; // bindless material slot overriding the primitive one, NO_MATERIAL if none
 };
 
 layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
     ObjectData objects[];
 } objectBuffer;
 
+// Instanced draws : the instance index selects a slot holding the object index, written each frame per cascade
+layout (std430, set = 1, binding = 2) readonly buffer InstanceBuffer {
+    uint objects[];
+} instanceBuffer;
+
 layout (push_constant) uniform PushConstants {
     layout(offset = 0) mat4 model;
     layout(offset = 64) int cascadeIndex;
@@ -31,8 +40,9 @@ layout (push_constant) uniform PushConstants {
 
 void main()
 {
-    mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model * pushData.model;
-    mat4 transformMatrix = shadowData.cascadeVP[pushData.cascadeIndex] * modelMatrix;
+    mat4 modelMatrix = objectBuffer.objects[instanceBuffer.objects[gl_InstanceIndex]].model * pushData.model;
+    int cascadeIndex = MULTIVIEW ? int(gl_ViewIndex) : pushData.cascadeIndex;
+    mat4 transformMatrix = shadowData.cascadeVP[cascadeIndex] * modelMatrix;
 
     outUV = vUV;
     gl_Position = transformMatrix * vec4(vPosition, 1.0);
@@ -19,6 +19,7 @@ layout(set = 0, binding = 1) uniform  CameraBuffer
 
 struct ObjectData {
     mat4 model;
+    uint materialIndex; // bindless material slot overriding the primitive one, NO_MATERIAL if none
 };
 
 layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
@@ -29,6 +30,8 @@ layout (push_constant) uniform NodeModel {
     mat4 model;
 } nodeData;
 
+#include "../common/indirect.glsl"
+
 layout (location = 0) out vec3 outColor;
 layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outNormal;
@@ -36,10 +39,19 @@ layout (location = 3) out vec3 outFragPos;
 layout (location = 4) out vec3 outCameraPos;
 layout (location = 5) out vec3 outViewPos;
 layout (location = 6) out vec4 outTangent;
+layout (location = 7) flat out uint outMaterialIndex;
 
 void main()
 {
-    mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model * nodeData.model;
+    mat4 modelMatrix;
+    if (INDIRECT_DRAW) {
+        modelMatrix = drawBuffer.draws[gl_BaseInstance].model;
+        outMaterialIndex = drawBuffer.draws[gl_BaseInstance].materialIndex;
+    } else {
+        ObjectData object = objectBuffer.objects[instanceBuffer.objects[gl_InstanceIndex]];
+        modelMatrix = object.model * nodeData.model;
+        outMaterialIndex = object.materialIndex;
+    }
     mat4 cameraMVP = (cameraData.proj * cameraData.view * modelMatrix);
     vec4 pos = modelMatrix * vec4(inPosition.xyz, 1.0f);
 
@@ -20,6 +20,7 @@ layout (std140, set = 0, binding = 0) uniform ShadowData {
 
 struct ObjectData {
     mat4 model;
+    uint materialIndex; // bindless material slot overriding the primitive one, NO_MATERIAL if none
 };
 
 layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
@@ -1,6 +1,7 @@
 #version 460
 #extension GL_EXT_debug_printf : enable
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "../common/constants.glsl"
 #include "../common/filters.glsl"
@@ -21,11 +22,12 @@ layout (std140, set = 0, binding = 3) uniform ShadowData {
     layout(offset = 272) bool color_cascades;
 } depthData;
 
-layout(set = 2, binding = 0) uniform sampler2D samplerAlbedoMap;
-layout(set = 2, binding = 1) uniform sampler2D samplerNormalMap;
-layout(set = 2, binding = 2) uniform sampler2D samplerMetalRoughnessMap;
-layout(set = 2, binding = 3) uniform sampler2D samplerAOMap;
-layout(set = 2, binding = 4) uniform sampler2D samplerEmissiveMap;
+layout (push_constant) uniform PushConstants {
+    layout(offset = 64) uint materialIndex;
+} pushData;
+
+#define MATERIAL_INDEX (inMaterialIndex != NO_MATERIAL ? inMaterialIndex : pushData.materialIndex)
+#include "../common/bindless.glsl"
 layout (set = 0, binding = 7) uniform sampler2DArray shadowMap;
 
 layout (location = 0) in vec3 inColor;
@@ -35,6 +37,7 @@ layout (location = 3) in vec3 inFragPos;
 layout (location = 4) in vec3 inCameraPos;
 layout (location = 5) in vec3 inViewPos;
 layout (location = 6) in vec4 inTangent;
+layout (location = 7) flat in uint inMaterialIndex;
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -18,6 +18,7 @@
 #include "core/vk_command_pool.h"
 #include "core/vk_command_buffer.h"
 #include "core/utilities/vk_global.h"
+#include "core/utilities/vk_memory_statistics.h"
 #include "components/camera/vk_camera.h"
 
 #include <chrono>
@@ -145,12 +146,14 @@ void Atmosphere::create_transmittance_resource(Device& device, UploadContext& up
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &_transmittanceLUT._image, &_transmittanceLUT._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, _transmittanceLUT._allocation, MemoryCategory::OTHER);
 
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, _transmittanceLUT._image, VK_IMAGE_ASPECT_COLOR_BIT);
     vkCreateImageView(device._logicalDevice, &imageViewInfo, nullptr, &_transmittanceLUT._imageView);
 
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &_transmittanceLUT._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
@@ -215,12 +218,14 @@ void Atmosphere::create_multiple_scattering_resource(Device& device, UploadConte
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &_multipleScatteringLUT._image, &_multipleScatteringLUT._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, _multipleScatteringLUT._allocation, MemoryCategory::OTHER);
 
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, _multipleScatteringLUT._image, VK_IMAGE_ASPECT_COLOR_BIT);
     vkCreateImageView(device._logicalDevice, &imageViewInfo, nullptr, &_multipleScatteringLUT._imageView);
 
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &_multipleScatteringLUT._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
@@ -299,12 +304,14 @@ void Atmosphere::create_skyview_resource(Device &device, UploadContext &uploadCo
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &_skyviewLUT._image, &_skyviewLUT._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, _skyviewLUT._allocation, MemoryCategory::OTHER);
 
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, _skyviewLUT._image, VK_IMAGE_ASPECT_COLOR_BIT);
     vkCreateImageView(device._logicalDevice, &imageViewInfo, nullptr, &_skyviewLUT._imageView);
 
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &_skyviewLUT._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
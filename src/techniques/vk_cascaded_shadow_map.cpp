@@ -20,8 +20,13 @@
 #include "components/lighting/vk_light.h"
 #include "components/camera/vk_camera.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/utilities/vk_memory_statistics.h"
 
-CascadedShadow::CascadedShadow(Device& device, UploadContext& uploadContext) : _device(device), _depthPass(RenderPass(device)), _uploadContext(uploadContext) {
+#include <algorithm>
+
+static_assert(1 + CascadedShadow::COUNT <= INSTANCE_PASSES, "frame instance buffer holds a slice per cascade");
+
+CascadedShadow::CascadedShadow(Device& device, UploadContext& uploadContext) : _device(device), _depthPass(RenderPass(device)), _multiviewPass(RenderPass(device)), _uploadContext(uploadContext) {
     _ready = false;
     prepare_resources(device);
     _ready = true;
@@ -30,11 +35,15 @@ CascadedShadow::CascadedShadow(Device& device, UploadContext& uploadContext) : _
 CascadedShadow::~CascadedShadow() {
     _depth.destroy(_device);
     _depthEffect.reset();
+    _multiviewEffect.reset();
     _debugEffect.reset();
+    _multiviewFramebuffer.reset();
 
     for (auto& c : _cascades) {
         c.destroy(_device._logicalDevice);
     }
+    _multiviewPass.destroy();
+    _depthPass.destroy();
 }
 
 void CascadedShadow::prepare_resources(Device& device) {
@@ -55,6 +64,10 @@ void CascadedShadow::prepare_resources(Device& device) {
 
     _depthPass.init(attachments, dependencies, subpasses);
 
+    // Same pass broadcast to every cascade layer
+    _multiviewPass = RenderPass(device);
+    _multiviewPass.init(attachments, dependencies, subpasses, (1u << CascadedShadow::COUNT) - 1);
+
     // === Prepare depth map ===
     VkExtent3D extent { CascadedShadow::SHADOW_WIDTH, CascadedShadow::SHADOW_HEIGHT, 1};
     VkImageCreateInfo info = vkinit::image_create_info(CascadedShadow::DEPTH_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, extent);
@@ -63,18 +76,23 @@ void CascadedShadow::prepare_resources(Device& device) {
     VmaAllocationCreateInfo alloc{};
     alloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &info, &alloc, &_depth._image, &_depth._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, _depth._allocation, MemoryCategory::SHADOW);
 
     VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(CascadedShadow::DEPTH_FORMAT, _depth._image, VK_IMAGE_ASPECT_DEPTH_BIT);
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
     viewInfo.subresourceRange.layerCount = CascadedShadow::COUNT;
     vkCreateImageView(device._logicalDevice, &viewInfo, nullptr, &_depth._imageView);
 
+    std::vector<VkImageView> multiviewAttachments = {_depth._imageView};
+    _multiviewFramebuffer = std::make_unique<FrameBuffer>(_multiviewPass, multiviewAttachments, CascadedShadow::SHADOW_WIDTH, CascadedShadow::SHADOW_HEIGHT, 1);
+
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.maxAnisotropy = 1.0f;
     samplerInfo.maxLod = 1.0f;
     samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &_depth._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     for (uint8_t i = 0; i < CascadedShadow::COUNT; i++) {
         VkImageViewCreateInfo view = vkinit::imageview_create_info(CascadedShadow::DEPTH_FORMAT, _depth._image, VK_IMAGE_ASPECT_DEPTH_BIT);
@@ -113,11 +131,27 @@ void CascadedShadow::prepare_resources(Device& device) {
 void CascadedShadow::allocate_buffers(Device &device) {
     for (int i = 0; i < FRAME_OVERLAP; i++) {
         const size_t size = helper::pad_uniform_buffer_size(device, sizeof(GPUCascadedShadowData));
-        Buffer::create_buffer(device, &g_frames[i].cascadedOffscreenBuffer, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        Buffer::create_buffer(device, &g_frames[i].cascadedOffscreenBuffer, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
     }
 }
 
+/**
+ * Cascade data changes every frame. With push descriptors, only the layout is created and descriptors
+ * are pushed while recording the depth and debug passes.
+ * @brief setup cascaded shadow descriptors
+ * @param layoutCache descriptor layout cache
+ * @param allocator descriptor allocator
+ * @param setLayout descriptor set layout updated by reference
+ */
 void CascadedShadow::setup_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout) {
+    if (_device._pushDescriptors) {
+        DescriptorBuilder::begin(layoutCache, allocator)
+            .bind_none(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0)
+            .bind_none(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+            .layout(setLayout, VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+        return;
+    }
+
     std::vector<VkDescriptorPoolSize> offscreenSizes = {
             {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 32},
             {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 32}
@@ -157,14 +191,19 @@ void CascadedShadow::setup_pipelines(Device& device, MaterialManager &materialMa
     // _depthEffect.reset();
     // _debugEffect.reset();
 
+    auto depth_state = [](GraphicPipeline& builder) {
+        builder._dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        builder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+        builder._rasterizer.depthClampEnable = VK_TRUE;
+        builder._rasterizer.depthBiasEnable = VK_FALSE;
+        builder._colorBlending.attachmentCount = 0;
+        builder._colorBlending.pAttachments = nullptr;
+        builder._depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+        builder._dynamicRaster = true;
+    };
+
     GraphicPipeline pipelineBuilder = GraphicPipeline(device, _depthPass);
-    pipelineBuilder._dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-    pipelineBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
-    pipelineBuilder._rasterizer.depthClampEnable = VK_TRUE;
-    pipelineBuilder._rasterizer.depthBiasEnable = VK_FALSE;
-    pipelineBuilder._colorBlending.attachmentCount = 0;
-    pipelineBuilder._colorBlending.pAttachments = nullptr;
-    pipelineBuilder._depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depth_state(pipelineBuilder);
 
     std::vector<std::pair<ShaderType, const char*>> modules {
             {ShaderType::VERTEX, "../src/shaders/shadow_map/csm_offscreen.vert.spv"},
@@ -173,14 +212,25 @@ void CascadedShadow::setup_pipelines(Device& device, MaterialManager &materialMa
 
     std::vector<PushConstant> constants {
         {sizeof(glm::mat4) + sizeof(int), ShaderType::VERTEX},
-        {sizeof(Materials::Factors), ShaderType::FRAGMENT},
+        {sizeof(uint32_t), ShaderType::FRAGMENT}, // bindless material index
     };
 
-    _depthEffect = materialManager.create_material(pipelineBuilder, "cascades", setLayouts, constants, modules);
+    // Pipelines are compiled concurrently
+    MaterialManager::MaterialFuture depthEffect = materialManager.create_material_async(pipelineBuilder, "cascades", setLayouts, constants, modules);
+
+    // Single pass : same shaders, the cascade is selected by view index
+    GraphicPipeline multiviewPipeline = GraphicPipeline(device, _multiviewPass);
+    depth_state(multiviewPipeline);
+
+    const VkBool32 multiview = VK_TRUE;
+    const VkSpecializationMapEntry multiviewEntry {5, 0, sizeof(VkBool32)};
+    const VkSpecializationInfo multiviewSpecialization {1, &multiviewEntry, sizeof(VkBool32), &multiview};
+    MaterialManager::MaterialFuture multiviewEffect = materialManager.create_material_async(multiviewPipeline, "cascadesMultiview", setLayouts, constants, modules, {{ShaderType::VERTEX, multiviewSpecialization}});
 
     GraphicPipeline debugPipeline = GraphicPipeline(device, renderPass);
     debugPipeline._vertexInputInfo = vkinit::vertex_input_state_create_info();
     debugPipeline._rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    debugPipeline._dynamicRaster = true; // drawn in the scene pass, whose pipelines set raster state per draw
 
     std::vector<std::pair<ShaderType, const char*>> debugMod {
             {ShaderType::VERTEX, "../src/shaders/shadow_map/csm_debug_quad.vert.spv"},
@@ -191,13 +241,62 @@ void CascadedShadow::setup_pipelines(Device& device, MaterialManager &materialMa
             {sizeof(glm::mat4) + sizeof(int), ShaderType::VERTEX},
     };
 
-    _debugEffect = materialManager.create_material(debugPipeline, "debugCascades", setLayouts, debugConst, debugMod);
+    MaterialManager::MaterialFuture debugEffect = materialManager.create_material_async(debugPipeline, "debugCascades", setLayouts, debugConst, debugMod);
+
+    materialManager.wait({depthEffect, multiviewEffect, debugEffect});
+    _depthEffect = depthEffect.get();
+    _multiviewEffect = multiviewEffect.get();
+    _debugEffect = debugEffect.get();
 
     _ready = true;
 }
 
-void CascadedShadow::compute_resources(FrameData& frame, Renderables& renderables) {
-    if (_depthEffect.get() == nullptr || !_ready) {
+/**
+ * Each cascade volume is extended toward the light : its near plane is dropped, casters between the light and the
+ * cascade are kept (their depth is clamped by the depth pass). Call after compute_cascades, before compute_resources.
+ * Skipped when every cascade is cached.
+ * @brief cull shadow casters against each cascade light space volume
+ * @param culling scene culling, holding the world space bounds of the renderables
+ */
+void CascadedShadow::cull_casters(const FrustumCulling& culling) {
+    if (up_to_date()) {
+        return; // nothing is drawn, results of the last rendering still hold
+    }
+
+    _casterCulling = nullptr;
+    if (!_cullCasters) {
+        return;
+    }
+
+    for (uint32_t l = 0; l < CascadedShadow::COUNT; l++) {
+        std::array<glm::vec4, 6> planes = Camera::frustum_planes(_cascades[l].viewProjMatrix);
+        planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // near plane, always passes
+        culling.cull(planes, _casters[l]);
+    }
+
+    _casterCulling = &culling;
+    if (!single_pass()) {
+        return;
+    }
+
+    // The single pass draws a caster once for all cascades : kept if any cascade sees it
+    _allCasters = _casters[0];
+    for (uint32_t l = 1; l < CascadedShadow::COUNT; l++) {
+        for (size_t i = 0; i < _allCasters.objects.size(); i++) {
+            _allCasters.objects[i] |= _casters[l].objects[i];
+        }
+        for (size_t i = 0; i < _allCasters.primitives.size(); i++) {
+            _allCasters.primitives[i] |= _casters[l].primitives[i];
+        }
+    }
+    _allCasters.visibleObjects = static_cast<uint32_t>(std::count(_allCasters.objects.begin(), _allCasters.objects.end(), 1));
+    _allCasters.visiblePrimitives = static_cast<uint32_t>(std::count(_allCasters.primitives.begin(), _allCasters.primitives.end(), 1));
+}
+
+void CascadedShadow::compute_resources(FrameData& frame, const RenderQueue& queue) {
+    _renderedCascades = 0;
+    _renderedDraws = 0;
+    if (_depthEffect.get() == nullptr || !_ready || up_to_date()) {
         return;
     }
 
@@ -214,31 +313,231 @@ void CascadedShadow::compute_resources(FrameData& frame, Renderables& renderable
     VkRect2D scissor = vkinit::get_scissor(static_cast<float>(CascadedShadow::SHADOW_WIDTH), static_cast<float>(CascadedShadow::SHADOW_HEIGHT));
     vkCmdSetScissor(frame._commandBuffer->_commandBuffer, 0, 1, &scissor);
 
+    if (single_pass()) {
+        VkRenderPassBeginInfo renderPassInfo = vkinit::renderpass_begin_info(_multiviewPass._renderPass, extent, _multiviewFramebuffer->_frameBuffer);
+        renderPassInfo.clearValueCount = clearValues.size();
+        renderPassInfo.pClearValues = clearValues.data();
+
+        prepare_instances(frame, queue, 0, _allCasters);
+        vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        record_casters(cmd, frame, queue, *_multiviewEffect, 0, 0, static_cast<uint32_t>(queue.packets().size()));
+        vkCmdEndRenderPass(cmd);
+
+        for (auto& c : _cascades) {
+            c.dirty = false;
+        }
+        _renderedCascades = CascadedShadow::COUNT;
+        return;
+    }
+
     for (uint8_t l = 0; l < CascadedShadow::COUNT; l++) {
+        if (!_cascades[l].dirty) {
+            continue;
+        }
         VkRenderPassBeginInfo renderPassInfo = vkinit::renderpass_begin_info(_depthPass._renderPass, extent, _cascades[l]._framebuffer->_frameBuffer);
         renderPassInfo.clearValueCount = clearValues.size();
         renderPassInfo.pClearValues = clearValues.data();
 
+        prepare_instances(frame, queue, l, _casters[l]);
         vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        {
-            std::shared_ptr<Model> lastModel = nullptr;
-            int pc = l;
-            int i = 0;
-            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthEffect->pipeline);
-            vkCmdPushConstants(cmd, _depthEffect->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(int), &pc);
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthEffect->pipelineLayout, 0, 1, &frame.cascadedOffscreenDescriptor, 0, nullptr);
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthEffect->pipelineLayout, 1, 1, &frame.objectDescriptor, 0, nullptr);
-            for (auto const &object: renderables) {
-                object.model->draw(cmd, _depthEffect->pipelineLayout, sizeof(glm::mat4) + sizeof(int), i, object.model.get() != lastModel.get());
-                lastModel = object.model;
-                i++;
-            }
+        record_casters(cmd, frame, queue, *_depthEffect, l, 0, static_cast<uint32_t>(queue.packets().size()));
+        vkCmdEndRenderPass(cmd);
+
+        _cascades[l].dirty = false;
+        _renderedCascades++;
+    }
+
+}
+
+/**
+ * Each cascade is split into packet ranges : every range of every cascade is recorded in parallel into a secondary
+ * command buffer, then cascade render passes execute their ranges in order. The single pass splits the packets over
+ * every recording slot instead. Cached cascades are skipped, the single pass renders every cascade if one is dirty.
+ * @brief record cascade render passes from secondary command buffers
+ * @param frame
+ * @param queue scene render queue, holding the packets and their instances
+ * @param recorder
+ * @param frameIndex frame in flight index
+ */
+void CascadedShadow::compute_resources(FrameData& frame, const RenderQueue& queue, SecondaryRecorder& recorder, uint32_t frameIndex) {
+    _renderedCascades = 0;
+    _renderedDraws = 0;
+    if (_depthEffect.get() == nullptr || !_ready || up_to_date()) {
+        return;
+    }
+
+    std::array<VkClearValue, 1> clearValues{};
+    clearValues[0].depthStencil = {1.0f, 0};
+
+    VkCommandBuffer& cmd = frame._commandBuffer->_commandBuffer;
+
+    VkExtent2D extent{CascadedShadow::SHADOW_WIDTH, CascadedShadow::SHADOW_HEIGHT};
+
+    SecondaryRecorder::Inheritance inheritance{};
+    inheritance.renderPass = _depthPass._renderPass; // cascade framebuffers differ : left unknown
+    inheritance.viewport = vkinit::get_viewport(static_cast<float>(CascadedShadow::SHADOW_WIDTH), static_cast<float>(CascadedShadow::SHADOW_HEIGHT));
+    inheritance.scissor = vkinit::get_scissor(static_cast<float>(CascadedShadow::SHADOW_WIDTH), static_cast<float>(CascadedShadow::SHADOW_HEIGHT));
+
+    const uint32_t packetCount = static_cast<uint32_t>(queue.packets().size());
+
+    if (single_pass()) {
+        inheritance.renderPass = _multiviewPass._renderPass;
+        inheritance.frameBuffer = _multiviewFramebuffer->_frameBuffer;
+
+        prepare_instances(frame, queue, 0, _allCasters);
+        const uint32_t rangeCount = std::clamp(packetCount / MIN_RANGE_PACKETS, 1u, recorder.slot_count());
+        std::vector<VkCommandBuffer> commandBuffers;
+        recorder.record(frameIndex, inheritance, rangeCount, [&](VkCommandBuffer commandBuffer, uint32_t range) {
+            const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(packetCount) * range / rangeCount);
+            const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(packetCount) * (range + 1) / rangeCount);
+            record_casters(commandBuffer, frame, queue, *_multiviewEffect, 0, first, last);
+        }, commandBuffers);
+
+        VkRenderPassBeginInfo renderPassInfo = vkinit::renderpass_begin_info(_multiviewPass._renderPass, extent, _multiviewFramebuffer->_frameBuffer);
+        renderPassInfo.clearValueCount = clearValues.size();
+        renderPassInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(cmd, rangeCount, commandBuffers.data());
+        vkCmdEndRenderPass(cmd);
+
+        for (auto& c : _cascades) {
+            c.dirty = false;
+        }
+        _renderedCascades = CascadedShadow::COUNT;
+        return;
+    }
+
+    std::vector<uint32_t> cascades;
+    for (uint32_t l = 0; l < CascadedShadow::COUNT; l++) {
+        if (_cascades[l].dirty) {
+            cascades.push_back(l);
+            prepare_instances(frame, queue, l, _casters[l]);
         }
+    }
+    const uint32_t cascadeCount = static_cast<uint32_t>(cascades.size());
+    const uint32_t rangeCount = std::clamp(packetCount / MIN_RANGE_PACKETS, 1u, std::max(recorder.slot_count() / cascadeCount, 1u));
+
+    std::vector<VkCommandBuffer> commandBuffers;
+    recorder.record(frameIndex, inheritance, cascadeCount * rangeCount, [&](VkCommandBuffer commandBuffer, uint32_t range) {
+        const uint32_t cascade = cascades[range / rangeCount];
+        const uint32_t r = range % rangeCount;
+        const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(packetCount) * r / rangeCount);
+        const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(packetCount) * (r + 1) / rangeCount);
+        record_casters(commandBuffer, frame, queue, *_depthEffect, cascade, first, last);
+    }, commandBuffers);
+
+    for (uint32_t c = 0; c < cascadeCount; c++) {
+        Cascade& cascade = _cascades[cascades[c]];
+        VkRenderPassBeginInfo renderPassInfo = vkinit::renderpass_begin_info(_depthPass._renderPass, extent, cascade._framebuffer->_frameBuffer);
+        renderPassInfo.clearValueCount = clearValues.size();
+        renderPassInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(cmd, rangeCount, commandBuffers.data() + c * rangeCount);
         vkCmdEndRenderPass(cmd);
+
+        cascade.dirty = false;
     }
+    _renderedCascades = cascadeCount;
+}
 
+/**
+ * Instances are written to the slice of the frame instance buffer following the scene slice, one slice per cascade.
+ * A packet draws the objects sharing its model and material whose primitive is visible from the cascade.
+ * @brief gather the visible caster instances of each render queue packet
+ * @param frame frame recorded, owner of the instance buffer
+ * @param queue scene render queue, holding the packets and their instances
+ * @param cascade cascade index, 0 for the single pass
+ * @param casters visible casters of the pass
+ */
+void CascadedShadow::prepare_instances(FrameData& frame, const RenderQueue& queue, uint32_t cascade, const FrustumCulling::Visibility& casters) {
+    const std::vector<RenderQueue::DrawPacket>& packets = queue.packets();
+    const std::vector<RenderQueue::Instance>& instances = queue.instances();
+    std::vector<RenderQueue::DrawRange>& ranges = _ranges[cascade];
+    ranges.resize(packets.size());
+
+    const uint32_t slice = MAX_DRAWS * (1 + cascade);
+    uint32_t* instanceObjects = static_cast<uint32_t*>(frame.instanceBuffer._data) + slice; // persistently mapped
+    uint32_t instanceCount = 0;
+    const bool culled = _casterCulling != nullptr;
+
+    for (size_t i = 0; i < packets.size(); i++) {
+        const RenderQueue::DrawPacket& packet = packets[i];
+        ranges[i] = {slice + instanceCount, 0};
+        const uint32_t lastInstance = packet.firstInstance + packet.instanceCount;
+        for (uint32_t j = packet.firstInstance; j < lastInstance && instanceCount < MAX_DRAWS; j++) {
+            const RenderQueue::Instance& instance = instances[j];
+            if (culled && instance.primitive < casters.primitives.size() && casters.primitives[instance.primitive] == 0) {
+                continue;
+            }
+            instanceObjects[instanceCount++] = instance.object;
+        }
+        ranges[i].instanceCount = slice + instanceCount - ranges[i].firstInstance;
+        _renderedDraws += ranges[i].instanceCount > 0 ? 1 : 0;
+    }
 }
 
+/**
+ * Call prepare_instances for the cascade first. Read only : ranges can be recorded concurrently.
+ * @brief record the instanced depth draws of a range of packets into a cascade, or into every cascade with the multiview effect
+ * @param cmd command buffer, within the cascade render pass
+ * @param frame
+ * @param queue scene render queue, holding the packets
+ * @param effect depth effect of the render pass
+ * @param cascade cascade index, ignored by the multiview effect which draws the instances of the first cascade
+ * @param first first packet
+ * @param last last packet (excluded)
+ */
+void CascadedShadow::record_casters(VkCommandBuffer cmd, FrameData& frame, const RenderQueue& queue, const Material& effect, uint32_t cascade, uint32_t first, uint32_t last) {
+    int pc = static_cast<int>(cascade);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effect.pipeline);
+    GraphicPipeline::set_raster_state(_device, cmd, effect);
+    vkCmdPushConstants(cmd, effect.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(int), &pc);
+    if (_device._pushDescriptors) {
+        VkDescriptorBufferInfo info{frame.cascadedOffscreenBuffer._buffer, 0, sizeof(GPUCascadedShadowData)};
+        DescriptorBuilder::begin(_device)
+            .bind_buffer(info, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0)
+            .push(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effect.pipelineLayout, 0);
+    } else {
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effect.pipelineLayout, 0, 1, &frame.cascadedOffscreenDescriptor, 0, nullptr);
+    }
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effect.pipelineLayout, 1, 1, &frame.objectDescriptor, 0, nullptr);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effect.pipelineLayout, 2, 1, &frame.materialDescriptor, 0, nullptr);
+
+    const std::vector<RenderQueue::DrawPacket>& packets = queue.packets();
+    const std::vector<RenderQueue::DrawRange>& ranges = _ranges[cascade];
+    Model* lastModel = nullptr;
+    uint32_t lastNode = UINT32_MAX;
+    uint32_t lastMaterialIndex = UINT32_MAX;
+    for (uint32_t i = first; i < last; i++) {
+        if (ranges[i].instanceCount == 0) {
+            continue;
+        }
+        const RenderQueue::DrawPacket& packet = packets[i];
+        if (packet.model != lastModel) {
+            packet.model->bind(cmd);
+            lastModel = packet.model;
+        }
+        if (packet.node != lastNode) {
+            vkCmdPushConstants(cmd, effect.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &queue.node_matrix(packet.node));
+            lastNode = packet.node;
+        }
+        if (packet.materialIndex != lastMaterialIndex) { // alpha tested
+            vkCmdPushConstants(cmd, effect.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4) + sizeof(int), sizeof(uint32_t), &packet.materialIndex);
+            lastMaterialIndex = packet.materialIndex;
+        }
+        vkCmdDrawIndexed(cmd, packet.indexCount, ranges[i].instanceCount, packet.firstIndex, 0, ranges[i].firstInstance);
+    }
+}
+
+/**
+ * With caching, a cascade keeps its matrix, and its depth layer, until the light, the split size, or the camera moves
+ * the split out of the cascade margin.
+ * @brief compute split depths and light space matrices of the cascades
+ * @param camera
+ * @param lightManager
+ */
 void CascadedShadow::compute_cascades(Camera& camera, LightingManager& lightManager) {
     float splits[COUNT];
     float zNear = camera.get_z_near();
@@ -303,14 +602,45 @@ void CascadedShadow::compute_cascades(Camera& camera, LightingManager& lightMana
             if (light->get_type() == Light::Type::DIRECTIONAL) {
                 glm::vec3 lightDir = normalize(-light->get_rotation());
                 glm::vec3 up = glm::abs(glm::dot(lightDir, glm::vec3(0.0f, 1.0f, 0.0f))) == 1.0f ? glm::vec3(-1.0f, 0.0f, 0.0f) :  glm::vec3(0.0f, 1.0f, 0.0f);
-                glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * radius, frustumCenter, up);
-                glm::mat4 lightOrthoMatrix = glm::ortho(-radius, radius, -f * radius, f * radius, 0.0f, 2.0f * radius);
 
                 // Store split distance and matrix in cascade
-                _cascades[i].splitDepth = (camera.get_z_near() + splitDist * range) * -1.0f;
-                _cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+                Cascade& cascade = _cascades[i];
+                cascade.splitDepth = (camera.get_z_near() + splitDist * range) * -1.0f;
 
                 lastSplitDist = splits[i];
+
+                if (!_cache) {
+                    glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * radius, frustumCenter, up);
+                    glm::mat4 lightOrthoMatrix = glm::ortho(-radius, radius, -f * radius, f * radius, 0.0f, 2.0f * radius);
+                    cascade.viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+                    cascade.dirty = true;
+                    continue;
+                }
+
+                // Cached : the volume is widened by CACHE_TEXELS and kept while the split sphere stays inside it
+                const float extent = radius * static_cast<float>(SHADOW_WIDTH) / static_cast<float>(SHADOW_WIDTH - 2 * CACHE_TEXELS);
+                const float texel = 2.0f * extent / static_cast<float>(SHADOW_WIDTH);
+                const glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+                glm::vec3 center = glm::vec3(lightRotation * glm::vec4(frustumCenter, 1.0f));
+
+                const bool covered = glm::all(glm::lessThanEqual(glm::abs(center - cascade.center), glm::vec3(extent - radius)));
+                if (!cascade.dirty && covered && cascade.lightDir == lightDir && cascade.radius == extent && cascade.flip == f) {
+                    continue;
+                }
+
+                // Snapped to the texel grid : the cascade does not shimmer when rendered again
+                center.x = std::floor(center.x / texel) * texel;
+                center.y = std::floor(center.y / texel) * texel;
+                const glm::vec3 snappedCenter = glm::vec3(glm::inverse(lightRotation) * glm::vec4(center, 1.0f));
+
+                glm::mat4 lightViewMatrix = glm::lookAt(snappedCenter - lightDir * extent, snappedCenter, up);
+                glm::mat4 lightOrthoMatrix = glm::ortho(-extent, extent, -f * extent, f * extent, 0.0f, 2.0f * extent);
+                cascade.viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+                cascade.lightDir = lightDir;
+                cascade.center = center;
+                cascade.radius = extent;
+                cascade.flip = f;
+                cascade.dirty = true;
             }
         }
 
@@ -322,8 +652,17 @@ void CascadedShadow::debug_depth(FrameData& frame) {
     if (_debugEffect.get() != nullptr) {
         VkCommandBuffer cmd = frame._commandBuffer->_commandBuffer;
         vkCmdPushConstants(cmd, _debugEffect->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(int), &_cascadeIdx);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugEffect->pipelineLayout, 0, 1, &frame.debugDescriptor, 0, nullptr);
+        if (_device._pushDescriptors) {
+            VkDescriptorBufferInfo info{frame.cascadedOffscreenBuffer._buffer, 0, sizeof(GPUCascadedShadowData)};
+            DescriptorBuilder::begin(_device)
+                .bind_buffer(info, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0)
+                .bind_image(_depth._descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+                .push(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugEffect->pipelineLayout, 0);
+        } else {
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugEffect->pipelineLayout, 0, 1, &frame.debugDescriptor, 0, nullptr);
+        }
         vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugEffect->pipeline);
+        GraphicPipeline::set_raster_state(_device, cmd, *_debugEffect);
         vkCmdDraw(cmd, 3, 1, 0, 0);
     }
 }
@@ -12,6 +12,7 @@
 #include <vector>
 #include <array>
 #include <mutex>
+#include <algorithm>
 
 #include "glm/mat4x4.hpp"
 #include "core/utilities/vk_resources.h"
@@ -21,6 +22,9 @@
 #include "core/vk_renderpass.h"
 #include "core/vk_shaders.h"
 #include "core/vk_framebuffers.h"
+#include "core/vk_secondary_recorder.h"
+#include "techniques/vk_frustum_culling.h"
+#include "scenes/vk_render_queue.h"
 
 class FrameData;
 class Device;
@@ -49,6 +53,16 @@ public:
     int _cascadeIdx = 0;
     /** @brief Color cascades */
     bool _colorCascades = false;
+    /** @brief Cull shadow casters against each cascade volume */
+    bool _cullCasters = true;
+    /** @brief Render every cascade in a single multiview pass, the vertex shader selects the cascade by view index */
+    bool _singlePass = false;
+    /** @brief Keep cascades rendered while their light space volume still covers the split */
+    bool _cache = true;
+    /** @brief Margin of cached cascades (texels) : the split can move by this much before the cascade is rendered again */
+    static constexpr uint32_t CACHE_TEXELS = 16;
+    /** @brief Minimum number of draw packets recorded by a secondary command buffer */
+    static constexpr uint32_t MIN_RANGE_PACKETS = 256;
 
     struct Cascade {
         VkImageView _view;
@@ -58,6 +72,14 @@ public:
         float splitDepth = 1.0f;
         glm::mat4 viewProjMatrix = glm::mat4(0.0f);
 
+        /** @brief Depth layer no longer matches the matrix or the casters : rendered by the next depth pass */
+        bool dirty = true;
+        /** @brief Light space state the layer was rendered with */
+        glm::vec3 lightDir = glm::vec3(0.0f);
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        float flip = 1.0f;
+
         void destroy(VkDevice device) {
             vkDestroyImageView(device, _view, nullptr);
             _framebuffer.reset();
@@ -74,8 +96,13 @@ public:
 
 
     RenderPass _depthPass;
+    /** @brief Depth pass broadcasting draws to every cascade layer */
+    RenderPass _multiviewPass;
+    /** @brief Every cascade layer, attachment of the multiview pass */
+    std::unique_ptr<FrameBuffer> _multiviewFramebuffer;
     Texture _depth;
     std::shared_ptr<Material> _depthEffect;
+    std::shared_ptr<Material> _multiviewEffect;
     std::shared_ptr<Material> _debugEffect;
 
 
@@ -86,14 +113,41 @@ public:
     static void allocate_buffers(Device& device);
     void setup_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator, VkDescriptorSetLayout& setLayout);
     void setup_pipelines(Device& device, MaterialManager &materialManager, std::vector<VkDescriptorSetLayout> setLayouts, RenderPass& renderPass);
-    void compute_resources(FrameData& frame, Renderables& renderables);
+    void cull_casters(const FrustumCulling& culling);
+    void compute_resources(FrameData& frame, const RenderQueue& queue);
+    void compute_resources(FrameData& frame, const RenderQueue& queue, SecondaryRecorder& recorder, uint32_t frameIndex);
     void compute_cascades(Camera& camera, LightingManager& lightManager);
     void debug_depth(FrameData& frame);
     GPUCascadedShadowData gpu_format();
+    /** @brief render every cascade again, the casters changed */
+    void invalidate() { for (auto& c : _cascades) { c.dirty = true; } };
+    /** @brief cascades rendered during the last frame */
+    uint32_t rendered_cascades() const { return _renderedCascades; };
+    /** @brief instanced draws recorded during the last frame, over every rendered cascade */
+    uint32_t rendered_draws() const { return _renderedDraws; };
+    /** @brief casters drawn in a cascade during the last frame */
+    const FrustumCulling::Visibility& casters(uint32_t cascade) const { return _casters[cascade]; };
+    /** @brief casters drawn by the single pass during the last frame */
+    const FrustumCulling::Visibility& all_casters() const { return _allCasters; };
 
 private:
     const class Device& _device;
     class UploadContext& _uploadContext;
     /** @brief Resource synchronizer */
     bool _ready = false;
+    /** @brief Scene culling the casters were tested with, null if every object is drawn */
+    const FrustumCulling* _casterCulling = nullptr;
+    /** @brief Visible casters of each cascade */
+    std::array<FrustumCulling::Visibility, COUNT> _casters;
+    /** @brief Casters visible in any cascade, drawn by the single pass */
+    FrustumCulling::Visibility _allCasters;
+    uint32_t _renderedCascades = 0;
+    uint32_t _renderedDraws = 0;
+    /** @brief Visible caster instances of each render queue packet, per cascade (the single pass uses the first) */
+    std::array<std::vector<RenderQueue::DrawRange>, COUNT> _ranges;
+
+    bool single_pass() const { return _singlePass && _multiviewEffect.get() != nullptr; };
+    bool up_to_date() const { return std::none_of(_cascades.begin(), _cascades.end(), [](const Cascade& c) { return c.dirty; }); };
+    void prepare_instances(FrameData& frame, const RenderQueue& queue, uint32_t cascade, const FrustumCulling::Visibility& casters);
+    void record_casters(VkCommandBuffer cmd, FrameData& frame, const RenderQueue& queue, const Material& effect, uint32_t cascade, uint32_t first, uint32_t last);
 };
\ No newline at end of file
@@ -21,6 +21,7 @@
 #include "core/manager/vk_material_manager.h"
 #include "core/utilities/vk_helpers.h"
 #include "core/utilities/vk_initializers.h"
+#include "core/utilities/vk_memory_statistics.h"
 #include "components/model/vk_poly.h"
 
 Texture EnvMap::cube_map_converter(Device& device, UploadContext& uploadContext, MeshManager& meshManager, Texture& inTexture) {
@@ -46,6 +47,7 @@ Texture EnvMap::cube_map_converter(Device& device, UploadContext& uploadContext,
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &outTexture._image, &outTexture._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, outTexture._allocation, MemoryCategory::IBL);
 
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, outTexture._image, VK_IMAGE_ASPECT_COLOR_BIT);
     imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
@@ -54,6 +56,7 @@ Texture EnvMap::cube_map_converter(Device& device, UploadContext& uploadContext,
 
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &outTexture._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
@@ -236,6 +239,7 @@ Texture EnvMap::irradiance_cube_mapping(Device& device, UploadContext& uploadCon
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &outTexture._image, &outTexture._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, outTexture._allocation, MemoryCategory::IBL);
 
     // Create image view
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, outTexture._image, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -246,6 +250,7 @@ Texture EnvMap::irradiance_cube_mapping(Device& device, UploadContext& uploadCon
     // Create sampler
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &outTexture._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
@@ -456,6 +461,7 @@ Texture EnvMap::prefilter_cube_mapping(Device& device, UploadContext& uploadCont
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &outTexture._image, &outTexture._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, outTexture._allocation, MemoryCategory::IBL);
 
     // Create image view
     VkImageViewCreateInfo imageViewInfo = vkinit::imageview_create_info(format, outTexture._image, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -472,6 +478,7 @@ Texture EnvMap::prefilter_cube_mapping(Device& device, UploadContext& uploadCont
     samplerInfo.maxLod = static_cast<float>(PRE_FILTER_MIP_LEVEL);
     samplerInfo.mipLodBias = 0.0f;
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &outTexture._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
@@ -665,6 +672,7 @@ Texture EnvMap::brdf_convolution(Device& device, UploadContext& uploadContext) {
     VmaAllocationCreateInfo imgAllocinfo = {};
     imgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     vmaCreateImage(device._allocator, &imgInfo, &imgAllocinfo, &outTexture._image, &outTexture._allocation, nullptr);
+    MemoryStatistics::track(device._allocator, outTexture._allocation, MemoryCategory::IBL);
 
     // Create image view
     VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, outTexture._image, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -673,6 +681,7 @@ Texture EnvMap::brdf_convolution(Device& device, UploadContext& uploadContext) {
     // Create sampler
     VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     vkCreateSampler(device._logicalDevice, &samplerInfo, nullptr, &outTexture._sampler);
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(device, uploadContext, [&](VkCommandBuffer cmd) {
         VkImageSubresourceRange range;
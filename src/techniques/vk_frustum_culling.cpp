@@ -0,0 +1,257 @@
+/*
+*  H2Vk - Frustum culling
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_frustum_culling.h"
+
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define H2VK_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+#include "components/model/vk_model.h"
+#include "core/manager/vk_job_manager.h"
+
+namespace {
+    constexpr float MAX_BOUND = std::numeric_limits<float>::max();
+}
+
+void FrustumCulling::Bounds::clear() {
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void FrustumCulling::Bounds::push_back(const glm::vec3& min, const glm::vec3& max) {
+    minX.push_back(min.x); minY.push_back(min.y); minZ.push_back(min.z);
+    maxX.push_back(max.x); maxY.push_back(max.y); maxZ.push_back(max.z);
+}
+
+/**
+ * Empty boxes (min > max) are unbounded : they are never culled.
+ * @brief world space box of a transformed box
+ * @param min box minimum
+ * @param max box maximum
+ * @param transform box to world matrix
+ * @param outMin world box minimum
+ * @param outMax world box maximum
+ */
+void FrustumCulling::transform_bounds(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform, glm::vec3& outMin, glm::vec3& outMax) {
+    if (min.x > max.x || min.y > max.y || min.z > max.z) {
+        outMin = glm::vec3(-MAX_BOUND);
+        outMax = glm::vec3(MAX_BOUND);
+        return;
+    }
+
+    const glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+    const glm::vec3 extent = (max - min) * 0.5f;
+    glm::vec3 worldExtent;
+    for (int i = 0; i < 3; i++) {
+        worldExtent[i] = std::abs(transform[0][i]) * extent.x + std::abs(transform[1][i]) * extent.y + std::abs(transform[2][i]) * extent.z;
+    }
+    outMin = center - worldExtent;
+    outMax = center + worldExtent;
+}
+
+/**
+ * Primitives are enumerated like Model::draw : depth first, in node order. Call when the scene changes.
+ * @brief build world space bounding boxes of objects and primitives
+ * @param renderables
+ */
+void FrustumCulling::build(const Renderables& renderables) {
+    _objects.clear();
+    _primitives.clear();
+    _primitiveObject.clear();
+    _primitiveOffset.clear();
+
+    for (uint32_t o = 0; o < renderables.size(); o++) {
+        const RenderObject& object = renderables[o];
+        _primitiveOffset.push_back(_primitives.size());
+
+        glm::vec3 objectMin(MAX_BOUND);
+        glm::vec3 objectMax(-MAX_BOUND);
+
+        std::function<void(const Node*, const glm::mat4&)> add_node = [&](const Node* node, const glm::mat4& parentMatrix) {
+            const glm::mat4 nodeMatrix = parentMatrix * node->matrix;
+            for (const Primitive& primitive : node->mesh.primitives) {
+                glm::vec3 min, max;
+                transform_bounds(primitive.boundsMin, primitive.boundsMax, nodeMatrix, min, max);
+                _primitives.push_back(min, max);
+                _primitiveObject.push_back(o);
+                objectMin = glm::min(objectMin, min);
+                objectMax = glm::max(objectMax, max);
+            }
+            for (const Node* child : node->children) {
+                add_node(child, nodeMatrix);
+            }
+        };
+
+        if (object.model) {
+            for (const Node* node : object.model->_nodes) {
+                add_node(node, object.transformMatrix);
+            }
+        }
+        _objects.push_back(objectMin, objectMax);
+    }
+
+    _objectVisible.assign(_objects.size(), 1);
+    _primitiveVisible.assign(_primitives.size(), 1);
+    _statistics = {_objects.size(), _objects.size(), _primitives.size(), _primitives.size(), 0.0f};
+}
+
+/**
+ * A box is outside the frustum when its vertex farthest along a plane normal is behind the plane.
+ * @brief test a range of boxes against the frustum planes
+ * @param bounds boxes
+ * @param begin first box
+ * @param end last box (excluded)
+ * @param planes normalized frustum planes
+ * @param visible output visibility, 1 if the box intersects the frustum
+ */
+void FrustumCulling::test(const Bounds& bounds, uint32_t begin, uint32_t end, const std::array<glm::vec4, 6>& planes, uint8_t* visible) {
+    uint32_t i = begin;
+
+#ifdef H2VK_CULLING_SSE
+    for (; i + 4 <= end; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : planes) {
+            // The farthest vertex along the normal is picked per plane : select the source arrays, not the lanes
+            const float* x = plane.x >= 0.0f ? bounds.maxX.data() : bounds.minX.data();
+            const float* y = plane.y >= 0.0f ? bounds.maxY.data() : bounds.minY.data();
+            const float* z = plane.z >= 0.0f ? bounds.maxZ.data() : bounds.minZ.data();
+
+            __m128 distance = _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(x + i));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(y + i)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(z + i)));
+            distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        visible[i] = mask & 1;
+        visible[i + 1] = (mask >> 1) & 1;
+        visible[i + 2] = (mask >> 2) & 1;
+        visible[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+
+    for (; i < end; i++) {
+        bool inside = true;
+        for (const glm::vec4& plane : planes) {
+            const float x = plane.x >= 0.0f ? bounds.maxX[i] : bounds.minX[i];
+            const float y = plane.y >= 0.0f ? bounds.maxY[i] : bounds.minY[i];
+            const float z = plane.z >= 0.0f ? bounds.maxZ[i] : bounds.minZ[i];
+            inside = inside && (plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0f);
+        }
+        visible[i] = inside ? 1 : 0;
+    }
+}
+
+/**
+ * Objects are tested first, then primitives of visible objects. When the scene holds more than one job of primitives,
+ * ranges are claimed by the calling thread and by helper jobs : the calling thread culls ranges itself instead of
+ * waiting behind other jobs of the queue (scene or material loading), helpers claiming no range return at once.
+ * @brief update object and primitive visibility
+ * @param planes normalized frustum planes (see Camera::frustum_planes)
+ */
+void FrustumCulling::cull(const std::array<glm::vec4, 6>& planes) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const uint32_t objectCount = _objects.size();
+    const uint32_t primitiveCount = _primitives.size();
+
+    if (!_enabled) {
+        std::fill(_objectVisible.begin(), _objectVisible.end(), 1);
+        std::fill(_primitiveVisible.begin(), _primitiveVisible.end(), 1);
+        _statistics = {objectCount, objectCount, primitiveCount, primitiveCount, 0.0f};
+        return;
+    }
+
+    test(_objects, 0, objectCount, planes, _objectVisible.data());
+
+    const uint32_t jobCount = (primitiveCount + JOB_SIZE - 1) / JOB_SIZE;
+    auto cull_primitives = [this, &planes, primitiveCount](uint32_t job) {
+        const uint32_t begin = job * JOB_SIZE;
+        const uint32_t end = std::min(begin + JOB_SIZE, primitiveCount);
+        test(_primitives, begin, end, planes, _primitiveVisible.data());
+        for (uint32_t i = begin; i < end; i++) {
+            _primitiveVisible[i] &= _objectVisible[_primitiveObject[i]];
+        }
+    };
+
+    if (jobCount > 1) {
+        // Helpers may run after the culling is over : claim state outlives the call
+        struct Claims {
+            std::atomic<uint32_t> next {0};
+            std::atomic<uint32_t> finished {0};
+        };
+        auto claims = std::make_shared<Claims>();
+        auto cull_claimed = [&cull_primitives, jobCount](Claims& c) {
+            for (uint32_t job = c.next.fetch_add(1); job < jobCount; job = c.next.fetch_add(1)) {
+                cull_primitives(job);
+                c.finished.fetch_add(1);
+            }
+        };
+
+        JobManager::dispatch(jobCount - 1, 1, [claims, cull_claimed](JobDispatchData) {
+            cull_claimed(*claims);
+        });
+        cull_claimed(*claims);
+
+        // Every range is claimed : wait for the ranges still culled by helpers only
+        while (claims->finished.load() < jobCount) {
+            std::this_thread::yield();
+        }
+    } else if (jobCount == 1) {
+        cull_primitives(0);
+    }
+
+    _statistics.objects = objectCount;
+    _statistics.visibleObjects = static_cast<uint32_t>(std::count(_objectVisible.begin(), _objectVisible.end(), 1));
+    _statistics.primitives = primitiveCount;
+    _statistics.visiblePrimitives = static_cast<uint32_t>(std::count(_primitiveVisible.begin(), _primitiveVisible.end(), 1));
+    _statistics.time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/**
+ * Same tests as the camera culling, against any convex volume (ex. a shadow cascade). Single threaded : primitives are
+ * tested only for visible objects.
+ * @brief compute visibility of objects and primitives against a volume
+ * @param planes normalized planes of the volume, pointing inward
+ * @param visibility output visibility
+ */
+void FrustumCulling::cull(const std::array<glm::vec4, 6>& planes, Visibility& visibility) const {
+    const uint32_t objectCount = _objects.size();
+    const uint32_t primitiveCount = _primitives.size();
+
+    visibility.objects.resize(objectCount);
+    visibility.primitives.assign(primitiveCount, 0);
+    visibility.visibleObjects = 0;
+    visibility.visiblePrimitives = 0;
+
+    test(_objects, 0, objectCount, planes, visibility.objects.data());
+
+    for (uint32_t o = 0; o < objectCount; o++) {
+        if (visibility.objects[o] == 0) {
+            continue;
+        }
+        const uint32_t begin = _primitiveOffset[o];
+        const uint32_t end = o + 1 < objectCount ? _primitiveOffset[o + 1] : primitiveCount;
+        test(_primitives, begin, end, planes, visibility.primitives.data());
+
+        visibility.visibleObjects++;
+        visibility.visiblePrimitives += static_cast<uint32_t>(std::count(visibility.primitives.begin() + begin, visibility.primitives.begin() + end, 1));
+    }
+}
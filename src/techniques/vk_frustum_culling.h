@@ -0,0 +1,90 @@
+/*
+*  H2Vk - Frustum culling
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+#include "glm/glm.hpp"
+#include "core/utilities/vk_types.h"
+
+/**
+ * World space bounding boxes of the scene objects and of their primitives are built when the scene is loaded,
+ * stored as structure of arrays. Each frame, boxes are tested four at a time (SSE) against the camera frustum planes,
+ * large scenes are split over the job system.
+ * @brief CPU frustum culling of scene objects and primitives
+ */
+class FrustumCulling final {
+public:
+    struct Statistics {
+        uint32_t objects = 0;
+        uint32_t visibleObjects = 0;
+        uint32_t primitives = 0;
+        uint32_t visiblePrimitives = 0;
+        /** @brief culling time (ms) */
+        float time = 0.0f;
+    };
+
+    /** @brief Visibility against another volume than the camera frustum, owned by the caller */
+    struct Visibility {
+        std::vector<uint8_t> objects;
+        std::vector<uint8_t> primitives;
+        uint32_t visibleObjects = 0;
+        uint32_t visiblePrimitives = 0;
+    };
+
+    /** @brief Cull objects and primitives outside the frustum, everything is visible otherwise */
+    bool _enabled = true;
+    /** @brief Number of primitives tested by a job */
+    static constexpr uint32_t JOB_SIZE = 4096;
+
+    void build(const Renderables& renderables);
+    void cull(const std::array<glm::vec4, 6>& planes);
+    void cull(const std::array<glm::vec4, 6>& planes, Visibility& visibility) const;
+
+    /** @brief true if part of the object is in the frustum */
+    bool object_visible(uint32_t object) const { return object >= _objectVisible.size() || _objectVisible[object] != 0; };
+    /** @brief visibility of the object primitives, in node enumeration order. Null if unknown */
+    const uint8_t* primitive_visibility(uint32_t object) const {
+        return object < _primitiveOffset.size() ? _primitiveVisible.data() + _primitiveOffset[object] : nullptr;
+    };
+    /** @brief visibility of the object primitives in another volume, in node enumeration order. Null if unknown */
+    const uint8_t* primitive_visibility(const Visibility& visibility, uint32_t object) const {
+        return object < _primitiveOffset.size() && visibility.primitives.size() == _primitives.size() ? visibility.primitives.data() + _primitiveOffset[object] : nullptr;
+    };
+    /** @brief true if the primitive is in the frustum, primitives are indexed in scene enumeration order */
+    bool primitive_visible(uint32_t primitive) const { return primitive >= _primitiveVisible.size() || _primitiveVisible[primitive] != 0; };
+    Statistics statistics() const { return _statistics; };
+
+    static void transform_bounds(const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform, glm::vec3& outMin, glm::vec3& outMax);
+
+private:
+    /** @brief axis aligned boxes, one array per component */
+    struct Bounds {
+        std::vector<float> minX, minY, minZ;
+        std::vector<float> maxX, maxY, maxZ;
+
+        void clear();
+        void push_back(const glm::vec3& min, const glm::vec3& max);
+        uint32_t size() const { return static_cast<uint32_t>(minX.size()); };
+    };
+
+    Bounds _objects;
+    Bounds _primitives;
+    /** @brief object of each primitive */
+    std::vector<uint32_t> _primitiveObject;
+    /** @brief first primitive of each object */
+    std::vector<uint32_t> _primitiveOffset;
+    std::vector<uint8_t> _objectVisible;
+    std::vector<uint8_t> _primitiveVisible;
+    Statistics _statistics;
+
+    static void test(const Bounds& bounds, uint32_t begin, uint32_t end, const std::array<glm::vec4, 6>& planes, uint8_t* visible);
+};
@@ -0,0 +1,255 @@
+/*
+*  H2Vk - Indirect draw
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#include "vk_indirect_draw.h"
+
+#include <map>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+#include "core/utilities/vk_global.h"
+#include "core/vk_device.h"
+#include "core/vk_buffer.h"
+#include "core/vk_descriptor_builder.h"
+#include "core/vk_pipeline.h"
+#include "core/vk_bindless_table.h"
+#include "core/manager/vk_material_manager.h"
+#include "components/model/vk_model.h"
+#include "components/camera/vk_camera.h"
+#include "techniques/vk_frustum_culling.h"
+
+IndirectDraw::~IndirectDraw() {
+    _batches.clear();
+    _cullingPass.reset();
+}
+
+/**
+ * @brief allocate per frame draw, indirect command and draw count buffers
+ * @param device
+ */
+void IndirectDraw::allocate_buffers(Device& device) {
+    for (int i = 0; i < FRAME_OVERLAP; i++) {
+        Buffer::create_buffer(device, &g_frames[i].drawBuffer, MAX_DRAWS * sizeof(GPUDrawData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        Buffer::create_buffer(device, &g_frames[i].indirectBuffer, MAX_DRAWS * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        Buffer::create_buffer(device, &g_frames[i].countBuffer, MAX_DRAW_BATCHES * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    }
+}
+
+/**
+ * @brief culling descriptors : draw buffer (read), indirect commands and draw counts (write)
+ * @param layoutCache
+ * @param allocator
+ */
+void IndirectDraw::setup_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator) {
+    const std::vector<VkDescriptorPoolSize> poolSizes = {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3}};
+
+    for (int i = 0; i < FRAME_OVERLAP; i++) {
+        VkDescriptorBufferInfo drawInfo{g_frames[i].drawBuffer._buffer, 0, MAX_DRAWS * sizeof(GPUDrawData)};
+        VkDescriptorBufferInfo indirectInfo{g_frames[i].indirectBuffer._buffer, 0, MAX_DRAWS * sizeof(VkDrawIndexedIndirectCommand)};
+        VkDescriptorBufferInfo countInfo{g_frames[i].countBuffer._buffer, 0, MAX_DRAW_BATCHES * sizeof(uint32_t)};
+
+        DescriptorBuilder::begin(layoutCache, allocator)
+                .bind_buffer(drawInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0)
+                .bind_buffer(indirectInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+                .bind_buffer(countInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)
+                .layout(_descriptorLayout)
+                .build(g_frames[i].cullingDescriptor, _descriptorLayout, poolSizes);
+    }
+}
+
+/**
+ * @brief build the frustum culling compute pipeline
+ * @param materialManager
+ */
+void IndirectDraw::setup_pipeline(MaterialManager& materialManager) {
+    ComputePipeline pipelineBuilder = ComputePipeline(_device);
+    std::vector<std::pair<ShaderType, const char*>> module {
+        {ShaderType::COMPUTE, "../src/shaders/culling/frustum_culling.comp.spv"},
+    };
+    std::vector<PushConstant> constants {{sizeof(GPUCullingData), ShaderType::COMPUTE}};
+
+    _cullingPass = materialManager.create_material(pipelineBuilder, "frustumCulling", {_descriptorLayout}, constants, module);
+}
+
+/**
+ * The sphere bounds the world space box of the primitive. Primitives without bounds are never culled.
+ * @brief world space bounding sphere of a primitive
+ * @param primitive
+ * @param transform model to world matrix
+ * @return center (xyz) and radius (w)
+ */
+glm::vec4 IndirectDraw::bounding_sphere(const Primitive& primitive, const glm::mat4& transform) {
+    if (primitive.boundsMin.x > primitive.boundsMax.x) {
+        return {glm::vec3(transform[3]), FLT_MAX};
+    }
+
+    glm::vec3 min, max;
+    FrustumCulling::transform_bounds(primitive.boundsMin, primitive.boundsMax, transform, min, max);
+    return {(min + max) * 0.5f, glm::length(max - min) * 0.5f};
+}
+
+/**
+ * Flatten the node hierarchy of every renderable into draw data, grouped into batches of primitives sharing the same
+ * model and material. Call when the scene changes, then upload to each frame.
+ * @brief build scene draw data and batches
+ * @param renderables
+ */
+void IndirectDraw::build(const Renderables& renderables) {
+    _batches.clear();
+    _draws.clear();
+    _drawCount = 0;
+
+    std::map<std::pair<const Model*, const Material*>, uint32_t> batchIndex;
+    std::vector<std::vector<GPUDrawData>> batchDraws;
+
+    for (const RenderObject& object : renderables) {
+        if (object.model == nullptr || object.material == nullptr) {
+            continue;
+        }
+
+        auto key = std::make_pair(object.model.get(), object.material.get());
+        auto it = batchIndex.find(key);
+        if (it == batchIndex.end()) {
+            if (_batches.size() >= MAX_DRAW_BATCHES) {
+                std::cout << "Indirect draw : batch limit (" << MAX_DRAW_BATCHES << ") reached, " << object.model->_name << " is skipped" << std::endl;
+                continue;
+            }
+            it = batchIndex.emplace(key, static_cast<uint32_t>(_batches.size())).first;
+            _batches.push_back({object.model, object.material});
+            batchDraws.emplace_back();
+        }
+        const uint32_t batch = it->second;
+        const Model& model = *object.model;
+
+        std::function<void(const Node*, const glm::mat4&)> add_node = [&](const Node* node, const glm::mat4& parentMatrix) {
+            const glm::mat4 nodeMatrix = parentMatrix * node->matrix;
+            for (const Primitive& primitive : node->mesh.primitives) {
+                if (primitive.indexCount == 0) {
+                    continue;
+                }
+                uint32_t materialIndex = BindlessTable::DEFAULT_INDEX;
+                if (!model._materials.empty() && primitive.materialIndex != -1) {
+                    materialIndex = model._materials[primitive.materialIndex]._bindlessIndex;
+                }
+                if (object.materialIndex >= 0 && static_cast<size_t>(object.materialIndex) < model._materials.size()) {
+                    materialIndex = model._materials[object.materialIndex]._bindlessIndex;
+                }
+
+                GPUDrawData draw{};
+                draw.model = nodeMatrix;
+                draw.boundingSphere = bounding_sphere(primitive, nodeMatrix);
+                draw.firstIndex = primitive.firstIndex;
+                draw.indexCount = primitive.indexCount;
+                draw.materialIndex = materialIndex;
+                draw.batch = batch;
+                batchDraws[batch].push_back(draw);
+            }
+            for (const Node* child : node->children) {
+                add_node(child, nodeMatrix);
+            }
+        };
+
+        for (const Node* node : model._nodes) {
+            add_node(node, object.transformMatrix);
+        }
+    }
+
+    // Batches own contiguous ranges of indirect commands
+    for (uint32_t i = 0; i < _batches.size(); i++) {
+        const uint32_t count = std::min(static_cast<uint32_t>(batchDraws[i].size()), MAX_DRAWS - _drawCount);
+        if (count < batchDraws[i].size()) {
+            std::cout << "Indirect draw : draw limit (" << MAX_DRAWS << ") reached" << std::endl;
+        }
+        _batches[i].commandOffset = _drawCount;
+        _batches[i].drawCount = count;
+        for (uint32_t j = 0; j < count; j++) {
+            batchDraws[i][j].commandOffset = _drawCount;
+            _draws.push_back(batchDraws[i][j]);
+        }
+        _drawCount += count;
+    }
+}
+
+/**
+ * The buffer is persistently mapped : the frame must no longer be in flight (its fence has been waited on).
+ * @brief write the scene draw data into the frame draw buffer
+ * @param frame
+ */
+void IndirectDraw::upload(FrameData& frame) const {
+    std::memcpy(frame.drawBuffer._data, _draws.data(), _draws.size() * sizeof(GPUDrawData)); // persistently mapped
+}
+
+/**
+ * Reset draw counts, then test every draw against the camera frustum. Must be recorded outside of a render pass.
+ * @brief compute visible draws of the frame
+ * @param commandBuffer
+ * @param frame
+ * @param camera
+ */
+void IndirectDraw::cull(VkCommandBuffer commandBuffer, FrameData& frame, Camera& camera) {
+    if (_cullingPass == nullptr || _batches.empty()) {
+        return;
+    }
+
+    vkCmdFillBuffer(commandBuffer, frame.countBuffer._buffer, 0, _batches.size() * sizeof(uint32_t), 0);
+
+    VkBufferMemoryBarrier countBarrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    countBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    countBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    countBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    countBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    countBarrier.buffer = frame.countBuffer._buffer;
+    countBarrier.offset = 0;
+    countBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &countBarrier, 0, nullptr);
+
+    GPUCullingData culling{};
+    culling.planes = Camera::frustum_planes(camera.get_projection_matrix() * camera.get_view_matrix());
+    culling.drawCount = _drawCount;
+    culling.enabled = _culling ? 1 : 0;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullingPass->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullingPass->pipelineLayout, 0, 1, &frame.cullingDescriptor, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, _cullingPass->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingData), &culling);
+    vkCmdDispatch(commandBuffer, (_drawCount + 63) / 64, 1, 1);
+
+    std::array<VkBufferMemoryBarrier, 2> barriers{};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+    }
+    barriers[0].buffer = frame.indirectBuffer._buffer;
+    barriers[1].buffer = frame.countBuffer._buffer;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+}
+
+/**
+ * Vertex and index buffers of the batch model and its material pipeline must be bound.
+ * @brief draw the visible primitives of a batch
+ * @param commandBuffer
+ * @param frame
+ * @param batch batch index
+ */
+void IndirectDraw::draw(VkCommandBuffer commandBuffer, FrameData& frame, uint32_t batch) const {
+    const Batch& b = _batches.at(batch);
+    if (b.drawCount == 0) {
+        return;
+    }
+    vkCmdDrawIndexedIndirectCount(commandBuffer,
+                                  frame.indirectBuffer._buffer, b.commandOffset * sizeof(VkDrawIndexedIndirectCommand),
+                                  frame.countBuffer._buffer, batch * sizeof(uint32_t),
+                                  b.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+}
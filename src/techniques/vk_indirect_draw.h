@@ -0,0 +1,83 @@
+/*
+*  H2Vk - Indirect draw
+*
+* Copyright (C) 2022-2023 by Viviane Desgrange
+*
+* This code is licensed under the Non-Profit Open Software License ("Non-Profit OSL") 3.0 (https://opensource.org/license/nposl-3-0/)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <memory>
+
+#include "glm/glm.hpp"
+#include "core/utilities/vk_types.h"
+#include "core/vk_shaders.h"
+
+class Device;
+class Camera;
+class Model;
+struct Primitive;
+class DescriptorLayoutCache;
+class DescriptorAllocator;
+class MaterialManager;
+
+/**
+ * Every primitive of the scene is stored in the frame draw buffer. A compute shader culls them against the camera
+ * frustum and compacts visible primitives into the indirect commands of their batch, counted on the GPU.
+ * A batch groups the primitives of a model drawn with a material (same vertex buffers and pipeline) : the scene is
+ * drawn with one vkCmdDrawIndexedIndirectCount per batch, whatever the number of primitives.
+ * @brief GPU-driven indirect drawing with compute frustum culling
+ */
+class IndirectDraw final {
+public:
+    /** @brief primitives of a model drawn with a material */
+    struct Batch {
+        std::shared_ptr<Model> model;
+        std::shared_ptr<Material> material;
+        /** @brief first indirect command of the batch */
+        uint32_t commandOffset = 0;
+        /** @brief number of primitives, maximum draw count of the batch */
+        uint32_t drawCount = 0;
+    };
+
+    /** @brief culling parameters (push constants) */
+    struct GPUCullingData {
+        std::array<glm::vec4, 6> planes;
+        uint32_t drawCount;
+        uint32_t enabled;
+    };
+
+    /** @brief Cull primitives outside the camera frustum, every primitive is drawn otherwise */
+    bool _culling = true;
+
+    explicit IndirectDraw(const Device& device) : _device(device) {};
+    ~IndirectDraw();
+
+    static void allocate_buffers(Device& device);
+    void setup_descriptors(DescriptorLayoutCache& layoutCache, DescriptorAllocator& allocator);
+    void setup_pipeline(MaterialManager& materialManager);
+    void build(const Renderables& renderables);
+    void upload(FrameData& frame) const;
+    void cull(VkCommandBuffer commandBuffer, FrameData& frame, Camera& camera);
+    void draw(VkCommandBuffer commandBuffer, FrameData& frame, uint32_t batch) const;
+
+    /** @brief batches of the scene, in draw order */
+    const std::vector<Batch>& batches() const { return _batches; };
+    /** @brief number of primitives of the scene */
+    uint32_t draw_count() const { return _drawCount; };
+
+private:
+    const class Device& _device;
+    std::vector<Batch> _batches;
+    /** @brief draw data of the scene, uploaded to each frame once it is no longer in flight */
+    std::vector<GPUDrawData> _draws;
+    uint32_t _drawCount = 0;
+    VkDescriptorSetLayout _descriptorLayout = VK_NULL_HANDLE;
+    std::shared_ptr<Material> _cullingPass;
+
+    static glm::vec4 bounding_sphere(const Primitive& primitive, const glm::mat4& transform);
+};
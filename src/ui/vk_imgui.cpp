@@ -15,6 +15,9 @@
 #include "core/utilities/vk_helpers.h"
 #include "scenes/vk_scene_listing.h"
 #include "core/vk_command_buffer.h"
+#include "core/utilities/vk_memory_statistics.h"
+#include "core/vk_pipeline_cache.h"
+#include "core/vk_pipeline_library.h"
 
 #include "imgui_internal.h"
 #include "icons_font.h"
@@ -74,6 +77,7 @@ void UInterface::init_imgui() {
     pool_info.pPoolSizes = pool_sizes;
 
     VK_CHECK(vkCreateDescriptorPool(_engine._device->_logicalDevice, &pool_info, nullptr, &_pool));
+    MemoryStatistics::created(ObjectCategory::DESCRIPTOR_POOL);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -100,6 +104,8 @@ void UInterface::init_imgui() {
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
     ImGui_ImplVulkan_Init(&init_info, _engine._renderPass->_renderPass);
+    MemoryStatistics::created(ObjectCategory::PIPELINE); // created by the Vulkan backend : draw pipeline and font sampler
+    MemoryStatistics::created(ObjectCategory::SAMPLER);
 
     CommandBuffer::immediate_submit(*_engine._device, _engine._uploadContext,[&](VkCommandBuffer cmd) {
         ImGui_ImplVulkan_CreateFontsTexture(cmd);
@@ -124,9 +130,21 @@ bool UInterface::want_capture_mouse()
     return ImGui::GetIO().WantCaptureMouse;
 }
 
+/**
+ * Shared texture sets reference the textures of the previous scene : their pools are retired with the scene.
+ * @brief release the inspector texture sets when the scene changes
+ */
+void UInterface::scene_changed() {
+    _allocator->retirePools();
+    _displayedView = VK_NULL_HANDLE;
+}
+
 void UInterface::clean_up() {
     vkDestroyDescriptorPool(_engine._device->_logicalDevice, _pool, nullptr);
+    MemoryStatistics::destroyed(ObjectCategory::DESCRIPTOR_POOL);
     ImGui_ImplVulkan_Shutdown();
+    MemoryStatistics::destroyed(ObjectCategory::PIPELINE);
+    MemoryStatistics::destroyed(ObjectCategory::SAMPLER);
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 }
@@ -169,6 +187,11 @@ bool UInterface::interface(Performance::Statistics statistics) {
             updated |= ImGui::MenuItem("Skybox", nullptr, &this->_engine._enabledFeatures.skybox);
             updated |= ImGui::MenuItem("Atmosphere (WIP)", nullptr, &this->_engine._enabledFeatures.atmosphere);
             updated |= ImGui::MenuItem("Scene meshes", nullptr, &this->_engine._enabledFeatures.meshes);
+            updated |= ImGui::MenuItem("Indirect draw", nullptr, &this->_engine._enabledFeatures.indirectDraw);
+            if (_engine._enabledFeatures.indirectDraw) {
+                updated |= ImGui::MenuItem("Frustum culling", nullptr, &this->_engine._indirectDraw->_culling);
+            }
+            updated |= ImGui::MenuItem("Parallel recording", nullptr, &this->_engine._secondaryRecorder->_enabled);
 
             ImGui::EndMenu();
         }
@@ -209,7 +232,6 @@ bool UInterface::scene_editor() {
 
     const auto window_flags = ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse ;
     if (ImGui::Begin("Inspector", &this->p_open[SCENE_EDITOR], window_flags)) {
-
         std::vector<const char*> scenes;
         scenes.reserve(SceneListing::scenes.size());
         for (const auto& scene : SceneListing::scenes) {
@@ -336,12 +358,15 @@ bool UInterface::scene_editor() {
                     if (selected_tex != -1 && selected_tex < model->_images.size()) {
                             auto &image = model->_images[selected_tex]; // .at slower, better checking
 
-                            if (get_settings().texture_index != selected_tex) {
-                                get_settings().texture_index = selected_tex;
+                            // Shared set : built when the selection changes, only allocated the first time a texture is displayed
+                            get_settings().texture_index = selected_tex;
+                            if (_displayedView != image._texture._descriptor.imageView) {
+                                _displayedView = image._texture._descriptor.imageView;
                                 DescriptorBuilder::begin(*_layoutCache, *_allocator)
                                         .bind_image(image._texture._descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                                     VK_SHADER_STAGE_FRAGMENT_BIT, 0)
                                         .layout(_engine._descriptorSetLayouts.gui)
+                                        .shared()
                                         .build(get_settings()._textureDescriptorSet, _engine._descriptorSetLayouts.gui,
                                                {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}});
                             }
@@ -448,6 +473,66 @@ bool UInterface::stats_viewer(const Performance::Statistics& statistics) {
 
         ImGui::Text("Coordinates (%.0f, %.0f, %.0f)", statistics.coordinates[0], statistics.coordinates[1], statistics.coordinates[2]);
         ImGui::Text("Rotation (%.0f, %.0f, %.0f)", statistics.rotation[0], statistics.rotation[1], statistics.rotation[2]);
+
+        if (_engine._enabledFeatures.meshes && ImGui::CollapsingHeader("Culling")) {
+            const FrustumCulling::Statistics culling = _engine._scene->_culling.statistics();
+            updated |= ImGui::Checkbox("CPU frustum culling", &_engine._scene->_culling._enabled);
+            ImGui::Text("Objects %u / %u visible", culling.visibleObjects, culling.objects);
+            ImGui::Text("Primitives %u / %u visible (%u culled)", culling.visiblePrimitives, culling.primitives, culling.primitives - culling.visiblePrimitives);
+            ImGui::Text("Culling %.3f ms", culling.time);
+            const RenderQueue::Statistics queue = _engine._scene->_queue.statistics();
+            ImGui::Text("Draws %u (%u instances) : %u pipelines, %u materials, %u layouts, %u geometries bound", queue.draws, queue.instances, queue.pipelineBinds, queue.materialBinds, queue.layoutBinds, queue.geometryBinds);
+        }
+
+        if (_engine._secondaryRecorder->_enabled && ImGui::CollapsingHeader("Recording")) {
+            const SecondaryRecorder::Statistics recording = _engine._secondaryRecorder->statistics();
+            ImGui::Text("Secondary command buffers %u (%u recording slots)", recording.commandBuffers, _engine._secondaryRecorder->slot_count());
+            ImGui::Text("Recording threads %u", recording.threads);
+            ImGui::Text("Recording %.3f ms", recording.time);
+        }
+
+        if (ImGui::CollapsingHeader("Memory")) {
+            const float mb = 1024.0f * 1024.0f;
+            const auto now = std::chrono::steady_clock::now();
+            if (ImGui::Button("Refresh") || now - _memoryReportTime >= MEMORY_REPORT_PERIOD) {
+                _memoryReport = MemoryStatistics::report(*_engine._device);
+                _memoryReportTime = now;
+            }
+            const MemoryStatistics::Report& report = _memoryReport;
+            for (auto const& heap : report.heaps) {
+                ImGui::Text("Heap %u (%s) %.1f / %.1f MB", heap.index, heap.deviceLocal ? "device local" : "host visible", heap.usage / mb, heap.budget / mb);
+            }
+            ImGui::Separator();
+            for (size_t i = 0; i < report.categories.size(); i++) {
+                ImGui::Text("%s %.1f MB (%u)", MemoryStatistics::category_names[i], report.categories[i].bytes / mb, report.categories[i].count);
+            }
+            ImGui::Separator();
+            ImGui::Text("Blocks %u (%.1f MB), allocations %u (%.1f MB)", report.blockCount, report.blockBytes / mb, report.allocationCount, report.allocationBytes / mb);
+            ImGui::Text("Fragmentation %.2f (%u free ranges)", report.fragmentation, report.unusedRangeCount);
+            const PipelineCache::Statistics pipelines = _engine._device->_pipelineCache->statistics();
+            ImGui::Text("Pipelines %u created in %.1f ms (%s cache)", pipelines.pipelineCount, pipelines.creationTime, pipelines.warm ? "warm" : "cold");
+            if (_engine._device->_pipelineLibrary) {
+                const PipelineLibrary::Statistics library = _engine._device->_pipelineLibrary->statistics();
+                ImGui::Text("Pipeline library %u parts (%u reused), %u linked", library.parts, library.reusedParts, library.links);
+            }
+            for (size_t i = 0; i < report.objects.size(); i++) {
+                ImGui::Text("%s %lld", MemoryStatistics::object_names[i], static_cast<long long>(report.objects[i]));
+            }
+            if (ImGui::Button("Dump JSON")) {
+                MemoryStatistics::dump(*_engine._device, "memory_statistics.json");
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Descriptors")) {
+            const BindlessTable::Statistics bindless = _engine._bindless->statistics();
+            ImGui::Text("Textures %u (%u shared)", bindless.textures, bindless.sharedTextures);
+            ImGui::Text("Materials %u (%u shared)", bindless.materials, bindless.sharedMaterials);
+            ImGui::Separator();
+            const DescriptorAllocator::Statistics engine = _engine._allocator->statistics();
+            const DescriptorAllocator::Statistics ui = _allocator->statistics();
+            ImGui::Text("Engine sets %u (%u shared, %u pools saved)", engine.allocatedSets, engine.sharedSets, engine.savedPools);
+            ImGui::Text("Interface sets %u (%u shared, %u pools saved)", ui.allocatedSets, ui.sharedSets, ui.savedPools);
+        }
     }
     ImGui::End();
 
@@ -516,6 +601,23 @@ bool UInterface::shadow_editor() {
             updated |= ImGui::SliderInt("Cascade layer", &(_engine._cascadedShadow->_cascadeIdx), 0, CascadedShadow::COUNT - 1);
         }
 
+        ImGui::Checkbox("Single pass (multiview)", &(_engine._cascadedShadow->_singlePass));
+        ImGui::Checkbox("Cache cascades", &(_engine._cascadedShadow->_cache));
+        ImGui::Text("Rendered cascades : %u / %u (%u draws)", _engine._cascadedShadow->rendered_cascades(), CascadedShadow::COUNT, _engine._cascadedShadow->rendered_draws());
+        ImGui::Checkbox("Cull casters", &(_engine._cascadedShadow->_cullCasters));
+        if (_engine._cascadedShadow->_cullCasters) {
+            const FrustumCulling::Statistics scene = _engine._scene->_culling.statistics();
+            if (_engine._cascadedShadow->_singlePass) {
+                const FrustumCulling::Visibility& casters = _engine._cascadedShadow->all_casters();
+                ImGui::Text("All cascades : %u / %u objects, %u / %u primitives", casters.visibleObjects, scene.objects, casters.visiblePrimitives, scene.primitives);
+            } else {
+                for (uint32_t l = 0; l < CascadedShadow::COUNT; l++) {
+                    const FrustumCulling::Visibility& casters = _engine._cascadedShadow->casters(l);
+                    ImGui::Text("Cascade %u : %u / %u objects, %u / %u primitives", l, casters.visibleObjects, scene.objects, casters.visiblePrimitives, scene.primitives);
+                }
+            }
+        }
+
         ImGui::SameLine();
     }
     ImGui::End();
@@ -12,10 +12,12 @@ class VulkanEngine;
 
 #include <unordered_map>
 #include <memory>
+#include <chrono>
 #include "VkBootstrap.h"
 #include "core/vk_descriptor_cache.h"
 #include "core/vk_descriptor_allocator.h"
 #include "core/utilities/vk_performance.h"
+#include "core/utilities/vk_memory_statistics.h"
 
 typedef enum UIConstants {
     SCENE_EDITOR = 0,
@@ -49,6 +51,7 @@ public:
     void init_imgui();
     bool render(VkCommandBuffer cmd, Performance::Statistics stats);
     static bool want_capture_mouse();
+    void scene_changed();
 
     Settings& get_settings() { return _settings; };
 
@@ -57,6 +60,12 @@ private:
     Settings _settings;
     std::unique_ptr<DescriptorLayoutCache> _layoutCache;
     std::unique_ptr<DescriptorAllocator> _allocator;
+    /** @brief texture bound to the inspector texture set, the set is built again when the selection changes */
+    VkImageView _displayedView {VK_NULL_HANDLE};
+    /** @brief VMA statistics walk every block and allocation : the memory report is refreshed periodically */
+    static constexpr std::chrono::milliseconds MEMORY_REPORT_PERIOD {1000};
+    MemoryStatistics::Report _memoryReport;
+    std::chrono::steady_clock::time_point _memoryReportTime {};
 
     void clean_up();
     void new_frame();
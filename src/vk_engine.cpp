@@ -29,6 +29,10 @@
 #include <mutex>
 
 #include "vk_engine.h"
+#include "core/vk_pipeline_layout_cache.h"
+#include "core/vk_pipeline_cache.h"
+#include "core/vk_pipeline_library.h"
+#include "core/vk_shader_module_cache.h"
 
 /**
  * @brief Initialize the engine
@@ -49,8 +53,18 @@ void VulkanEngine::init()
     init_descriptors();
     init_materials();
 
-    update_objects_buffer(_scene->_renderables.data(), _scene->_renderables.size());
+    _sceneVersion++; // frame buffers are written when each frame is first recorded
+    _indirectDraw->build(_scene->_renderables);
+    _scene->_culling.build(_scene->_renderables);
+    _scene->_queue.build(_scene->_renderables);
 	_isInitialized = true;
+
+    const PipelineCache::Statistics pipelines = _device->_pipelineCache->statistics();
+    std::cout << "Startup : " << pipelines.pipelineCount << " pipelines created in " << pipelines.creationTime << " ms ("
+              << (pipelines.warm ? "warm" : "cold") << " pipeline cache)" << std::endl;
+    const ShaderModuleCache::Statistics shaders = _device->_shaderModuleCache->statistics();
+    std::cout << "Startup : " << shaders.modules << " shader modules for " << shaders.requests << " requests, "
+              << shaders.fileReads << " shader files read" << std::endl;
 }
 
 /**
@@ -94,6 +108,15 @@ void VulkanEngine::init_commands() {
 
     _uploadContext._commandPool = new CommandPool(*_device);
     _uploadContext._commandBuffer = new CommandBuffer(*_device, *_uploadContext._commandPool);
+
+    // Render passes are recorded in parallel into secondary command buffers, executed by the frame command buffer
+    _secondaryRecorder = std::make_unique<SecondaryRecorder>(*_device);
+
+    // Uploads are recorded on the transfer queue family when the device exposes a dedicated one
+    if (_device->has_dedicated_transfer()) {
+        _uploadContext._transferPool = new CommandPool(*_device, _device->get_transfer_queue_family());
+        _uploadContext._transferBuffer = new CommandBuffer(*_device, *_uploadContext._transferPool);
+    }
 }
 
 /**
@@ -149,7 +172,9 @@ void VulkanEngine::init_sync_structures() {
     }
 
     _uploadContext._uploadFence = new Fence(*_device);
+    _uploadContext._transferSemaphore = new Semaphore(*_device);
     _mainDeletionQueue.push_function([=]() {
+        delete _uploadContext._transferSemaphore;
         delete _uploadContext._uploadFence;
     });
 }
@@ -160,6 +185,7 @@ void VulkanEngine::init_sync_structures() {
  */
 void VulkanEngine::init_managers() {
     _pipelineBuilder = std::make_unique<GraphicPipeline>(*_device, *_renderPass);
+    _pipelineBuilder->_dynamicRaster = true; // scene material variants share pipelines
 
     _systemManager = std::make_unique<SystemManager>();
     _materialManager = _systemManager->register_system<MaterialManager>(_device.get());
@@ -222,6 +248,8 @@ void VulkanEngine::init_scene() {
 
     _atmosphere = std::make_unique<Atmosphere>(*_device, *_materialManager, *_lightingManager, _uploadContext);
 
+    _indirectDraw = std::make_unique<IndirectDraw>(*_device);
+
     _sceneListing = std::make_unique<SceneListing>();
     _scene = std::make_unique<Scene>(*this);
 }
@@ -233,16 +261,22 @@ void VulkanEngine::init_scene() {
 void VulkanEngine::init_descriptors() {
     _layoutCache = new DescriptorLayoutCache(*_device); // todo : make smart pointer
     _allocator = new DescriptorAllocator(*_device); // todo : make smart pointer
+    _bindless = std::make_unique<BindlessTable>(*_device, _uploadContext);
+    _descriptorSetLayouts.textures = _bindless->_setLayout;
+    for (int i = 0; i < FRAME_OVERLAP; i++) {
+        g_frames[i].materialDescriptor = _bindless->_descriptorSet;
+    }
 
     VulkanEngine::allocate_buffers(*_device);
     Camera::allocate_buffers(*_device);
-    LightingManager::allocate_buffers(*_device);
     Scene::allocate_buffers(*_device);
     CascadedShadow::allocate_buffers(*_device);
+    IndirectDraw::allocate_buffers(*_device);
 
     _skybox->setup_descriptors(*_layoutCache, *_allocator, _descriptorSetLayouts.skybox);
     _scene->setup_transformation_descriptors(*_layoutCache, *_allocator, _descriptorSetLayouts.matrices);
     _cascadedShadow->setup_descriptors(*_layoutCache, *_allocator, _descriptorSetLayouts.cascadedOffscreen);
+    _indirectDraw->setup_descriptors(*_layoutCache, *_allocator);
 
     this->setup_environment_descriptors();
 
@@ -250,10 +284,14 @@ void VulkanEngine::init_descriptors() {
     _mainDeletionQueue.push_function([&]() {
         for (int i = 0; i < FRAME_OVERLAP; i++) {
             g_frames[i].cameraBuffer.destroy();
-            g_frames[i].lightingBuffer.destroy();
+            g_frames[i].uniformArena.destroy();
             g_frames[i].objectBuffer.destroy();
+            g_frames[i].instanceBuffer.destroy();
             g_frames[i].cascadedOffscreenBuffer.destroy();
             g_frames[i].enabledFeaturesBuffer.destroy();
+            g_frames[i].drawBuffer.destroy();
+            g_frames[i].indirectBuffer.destroy();
+            g_frames[i].countBuffer.destroy();
         }
 
         delete _layoutCache;
@@ -289,13 +327,16 @@ void VulkanEngine::setup_environment_descriptors() {
         camBInfo.offset = 0;
         camBInfo.range = sizeof(GPUCameraData);
 
+        // Dynamic uniform buffers : slices of the frame arena selected at bind time with dynamic offsets
         VkDescriptorBufferInfo lightingBInfo{};
-        lightingBInfo.buffer = g_frames[i].lightingBuffer._buffer;
+        lightingBInfo.buffer = g_frames[i].uniformArena._buffer._buffer;
+        lightingBInfo.offset = 0;
         lightingBInfo.range = sizeof(GPULightData);
 
-       VkDescriptorBufferInfo offscreenBInfo{};
-       offscreenBInfo.buffer = g_frames[i].cascadedOffscreenBuffer._buffer;
-       offscreenBInfo.range = sizeof(CascadedShadow::GPUCascadedShadowData);
+        VkDescriptorBufferInfo offscreenBInfo{};
+        offscreenBInfo.buffer = g_frames[i].uniformArena._buffer._buffer;
+        offscreenBInfo.offset = 0;
+        offscreenBInfo.range = sizeof(CascadedShadow::GPUCascadedShadowData);
 
         DescriptorBuilder::begin(*_layoutCache, *_allocator)
                 .bind_buffer(featuresBInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0)
@@ -307,7 +348,7 @@ void VulkanEngine::setup_environment_descriptors() {
                 .bind_image(_skybox->_brdf._descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6) // precomputed no need to be binded every frame
                 .bind_image(_cascadedShadow->_depth._descriptor, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  VK_SHADER_STAGE_FRAGMENT_BIT, 7)
                 .layout(_descriptorSetLayouts.environment)
-                .build(g_frames[i].environmentDescriptor, _descriptorSetLayouts.environment, poolSizes);
+                .build_with_template(g_frames[i].environmentDescriptor, _descriptorSetLayouts.environment, poolSizes); // same template for every frame
 
     }
 }
@@ -320,17 +361,18 @@ void VulkanEngine::init_materials() {
     _skybox->setup_pipeline(*_materialManager, {_descriptorSetLayouts.skybox}, *_renderPass);
     _atmosphere->create_resources(*_layoutCache, *_allocator, *_renderPass);
     _atmosphere->precompute_resources();
+    _indirectDraw->setup_pipeline(*_materialManager);
 }
 
 /**
  * @brief Update user interface
  * Handle object which need update per frame (ie. camera movement)
  */
-void VulkanEngine::ui_overlay() {
+void VulkanEngine::ui_overlay(VkCommandBuffer commandBuffer) {
     Performance::Statistics stats = Performance::monitoring(_window.get(), _camera.get());
     stats._cmdTimestamps = get_current_frame()._queryTimestamp._results;
 
-    bool updated = _ui->render(get_current_frame()._commandBuffer->_commandBuffer, stats);
+    bool updated = _ui->render(commandBuffer, stats);
     if (updated) {
         // Skybox
         _skybox->_display = _ui->p_open[SKYBOX_EDITOR];
@@ -355,7 +397,12 @@ void VulkanEngine::build_command_buffers(FrameData& frame, int imageIndex) {
     // === Cascaded depth map render pass ===  
     if (_enabledFeatures.shadowMapping) {
         uint32_t start = frame._queryTimestamp.write(frame._commandBuffer->_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
-        _cascadedShadow->compute_resources(frame, _scene->_renderables);
+        _cascadedShadow->cull_casters(_scene->_culling);
+        if (_secondaryRecorder->_enabled) {
+            _cascadedShadow->compute_resources(frame, _scene->_queue, *_secondaryRecorder, _frameNumber % FRAME_OVERLAP);
+        } else {
+            _cascadedShadow->compute_resources(frame, _scene->_queue);
+        }
         uint32_t end = frame._queryTimestamp.write(frame._commandBuffer->_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
         frame._queryTimestamp.record("Cascaded shadows", start, end);
     }
@@ -365,6 +412,11 @@ void VulkanEngine::build_command_buffers(FrameData& frame, int imageIndex) {
         _atmosphere->compute_resources(_frameNumber % FRAME_OVERLAP);
     }
 
+    // === Scene frustum culling ===
+    if (_enabledFeatures.meshes && _enabledFeatures.indirectDraw) {
+        _indirectDraw->cull(frame._commandBuffer->_commandBuffer, frame, *_camera);
+    }
+
     // === Scene render pass ===
     {
         // Record command buffers
@@ -384,8 +436,46 @@ void VulkanEngine::build_command_buffers(FrameData& frame, int imageIndex) {
 
         uint32_t start = frame._queryTimestamp.write(frame._commandBuffer->_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 
-        vkCmdBeginRenderPass(frame._commandBuffer->_commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        {
+        // Shadow map debugging records into the frame command buffer
+        const bool secondary = _secondaryRecorder->_enabled && !(_enabledFeatures.shadowMapping && this->_cascadedShadow->_debug);
+
+        vkCmdBeginRenderPass(frame._commandBuffer->_commandBuffer, &renderPassInfo, secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        if (secondary) {
+            // Background, mesh ranges (in parallel) and UI are recorded into secondary command buffers, executed in order
+            const uint32_t frameIndex = _frameNumber % FRAME_OVERLAP;
+            SecondaryRecorder::Inheritance inheritance{_renderPass->_renderPass, _frameBuffers.at(imageIndex)._frameBuffer, viewport, scissor};
+            std::vector<VkCommandBuffer> commandBuffers;
+
+            if (_enabledFeatures.skybox || _enabledFeatures.atmosphere) {
+                _secondaryRecorder->record(frameIndex, inheritance, 1, [&](VkCommandBuffer commandBuffer, uint32_t) {
+                    // === Skybox ===
+                    if (_enabledFeatures.skybox) {
+                        this->_skybox->build_command_buffer(commandBuffer, &frame.skyboxDescriptor);
+                    }
+
+                    // === Atmosphere (WIP) ===
+                    if (_enabledFeatures.atmosphere) {
+                        this->_atmosphere->draw(commandBuffer, &frame.atmosphereDescriptor);
+                    }
+                }, commandBuffers);
+            }
+
+            // === Meshes ===
+            if (_enabledFeatures.meshes) {
+                this->_scene->render_objects(*_secondaryRecorder, frameIndex, inheritance, frame, commandBuffers);
+            }
+
+            // === UI ===
+            if (_enabledFeatures.ui) {
+                _secondaryRecorder->record(frameIndex, inheritance, 1, [&](VkCommandBuffer commandBuffer, uint32_t) {
+                    this->ui_overlay(commandBuffer);
+                }, commandBuffers);
+            }
+
+            if (!commandBuffers.empty()) {
+                vkCmdExecuteCommands(frame._commandBuffer->_commandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+            }
+        } else {
             // Debug shadow map
             if (_enabledFeatures.shadowMapping && this->_cascadedShadow->_debug) {
                 this->_cascadedShadow->debug_depth(frame);
@@ -408,9 +498,8 @@ void VulkanEngine::build_command_buffers(FrameData& frame, int imageIndex) {
 
             // === UI ===
             if (_enabledFeatures.ui) {
-                this->ui_overlay();
+                this->ui_overlay(frame._commandBuffer->_commandBuffer);
             }
-
         }
         vkCmdEndRenderPass(frame._commandBuffer->_commandBuffer);
         uint32_t end = frame._queryTimestamp.write(frame._commandBuffer->_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
@@ -421,22 +510,23 @@ void VulkanEngine::build_command_buffers(FrameData& frame, int imageIndex) {
 }
 
 /**
- * @brief update objects buffer
+ * The buffer is persistently mapped : the frame must no longer be in flight (its fence has been waited on).
+ * @brief update objects buffer of a frame
+ * @param frame
  * @param first
  * @param count
  */
-void VulkanEngine::update_objects_buffer(RenderObject *first, int count) {
+void VulkanEngine::update_objects_buffer(FrameData& frame, RenderObject *first, int count) {
     // Objects : write into the buffer by copying the render matrices from our render objects into it
     // Object not moving : call only when change scene
-    for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
-        FrameData& frame = g_frames[i]; // if object moves, call each frame.
-        frame.objectBuffer.map();
-        GPUObjectData* objectSSBO = (GPUObjectData*)frame.objectBuffer._data;
-        for (int j = 0; j < count; j++) {
-            RenderObject& object = first[j];
-            objectSSBO[j].model = object.transformMatrix;
+    GPUObjectData* objectSSBO = (GPUObjectData*)frame.objectBuffer._data; // persistently mapped
+    for (int j = 0; j < count; j++) {
+        RenderObject& object = first[j];
+        objectSSBO[j].model = object.transformMatrix;
+        objectSSBO[j].materialIndex = GPUObjectData::NO_MATERIAL;
+        if (object.model && object.materialIndex >= 0 && static_cast<size_t>(object.materialIndex) < object.model->_materials.size()) {
+            objectSSBO[j].materialIndex = object.model->_materials[object.materialIndex]._bindlessIndex;
         }
-        frame.objectBuffer.unmap();
     }
 }
 
@@ -448,24 +538,22 @@ void VulkanEngine::update_uniform_buffers() {
     FrameData& frame =  get_current_frame();
     uint32_t frameIndex = _frameNumber % FRAME_OVERLAP;
 
+    // Frame fence has been signaled: previous slices of the arena are no longer read by the GPU
+    frame.uniformArena.reset();
+
     // === Camera & Objects & Environment ===
-    // Camera : write into the buffer by copying the render matrices from camera object into it
+    // Camera : write into the buffer by copying the render matrices from camera object into it (persistently mapped)
     GPUCameraData camData = _camera->gpu_format();
-    frame.cameraBuffer.map();
     frame.cameraBuffer.copyFrom(&camData, sizeof(GPUCameraData));
-    frame.cameraBuffer.unmap();
 
-    // Light : write scene data into lighting buffer
+    // Light : write scene data into the frame arena
     GPULightData lightingData = _lightingManager->gpu_format();
-    frame.lightingBuffer.map();
-    frame.lightingBuffer.copyFrom(&lightingData, sizeof(GPULightData));
-    frame.lightingBuffer.unmap();
+    frame.lightingOffset = frame.uniformArena.push(lightingData);
 
-    // Cascaded shadow
+    // Cascaded shadow : arena slice for environment set, dedicated buffer for depth pass
     CascadedShadow::GPUCascadedShadowData cascadedOffscreenData = _cascadedShadow->gpu_format();
-    frame.cascadedOffscreenBuffer.map();
+    frame.cascadedOffset = frame.uniformArena.push(cascadedOffscreenData);
     frame.cascadedOffscreenBuffer.copyFrom(&cascadedOffscreenData, sizeof(CascadedShadow::GPUCascadedShadowData));
-    frame.cascadedOffscreenBuffer.unmap();
 
     // === Enabled Features ===
     GPUEnabledFeaturesData featuresData{};
@@ -473,9 +561,22 @@ void VulkanEngine::update_uniform_buffers() {
     featuresData.atmosphere = _enabledFeatures.atmosphere;
     featuresData.skybox = _enabledFeatures.skybox;
 
-    frame.enabledFeaturesBuffer.map();
     frame.enabledFeaturesBuffer.copyFrom(&featuresData, sizeof(GPUEnabledFeaturesData));
-    frame.enabledFeaturesBuffer.unmap();
+}
+
+/**
+ * Scene materials are specialized by the enabled features rather than branching on them in shaders.
+ * @brief shader variant matching the enabled features
+ * @return shader variant
+ */
+ShaderVariant VulkanEngine::shader_variant() const {
+    ShaderVariant variant;
+    variant.shadowMapping = _enabledFeatures.shadowMapping ? VK_TRUE : VK_FALSE;
+    variant.skybox = _enabledFeatures.skybox ? VK_TRUE : VK_FALSE;
+    variant.atmosphere = _enabledFeatures.atmosphere ? VK_TRUE : VK_FALSE;
+    variant.cascadeCount = CascadedShadow::COUNT;
+    variant.indirectDraw = _enabledFeatures.indirectDraw ? VK_TRUE : VK_FALSE;
+    return variant;
 }
 
 /**
@@ -512,12 +613,32 @@ void VulkanEngine::render(int imageIndex) {
     }
 
     if (_scene->_ready) {
-        _device->_queue->queue_wait(); // Prevent call to destroy pipelines while in-use by command buffer
+        // Replaced pipelines are retired to the deletion queue: no need to wait for the queue to be idle
         _cascadedShadow->setup_pipelines(*_device, *_materialManager, {_descriptorSetLayouts.cascadedOffscreen, _descriptorSetLayouts.matrices, _descriptorSetLayouts.textures}, *_renderPass);
-        update_objects_buffer(_scene->_renderables.data(), _scene->_renderables.size());
+        _sceneVersion++; // the other frame may still be in flight : its buffers are written when it is recorded again
+        _indirectDraw->build(_scene->_renderables);
+        _scene->_culling.build(_scene->_renderables);
+        _scene->_queue.build(_scene->_renderables);
+        _cascadedShadow->invalidate(); // cached cascades hold the previous casters
+        _ui->scene_changed();
         _scene->_ready = false;
     }
 
+    // The fence of this frame has been waited on : its buffers are no longer read by the GPU
+    if (frame.sceneVersion != _sceneVersion) {
+        update_objects_buffer(frame, _scene->_renderables.data(), _scene->_renderables.size());
+        _indirectDraw->upload(frame);
+        frame.sceneVersion = _sceneVersion;
+    }
+
+    // Toggled features : variants are compiled in the background, the previous ones are drawn meanwhile
+    const ShaderVariant variant = shader_variant();
+    if (variant.key() != _variantKey && _scene->_mutex.try_lock()) { // a loading scene prepares its own variants
+        _scene->prepare_variants(variant);
+        _variantKey = variant.key();
+        _scene->_mutex.unlock();
+    }
+
     // === Update resources ===
     compute();
 
@@ -559,6 +680,7 @@ void VulkanEngine::recreate_swap_chain() {
     }
 
     vkDeviceWaitIdle(_device->_logicalDevice);
+    _materialManager->wait_all(); // queued variants reference the pipeline builder
     _pipelineBuilder.reset();
     _renderPass.reset();
     _swapchain.reset();
@@ -575,6 +697,7 @@ void VulkanEngine::recreate_swap_chain() {
     init_default_renderpass();
     init_framebuffers(); // framebuffers depend on renderpass for device for creation and destruction
     _pipelineBuilder = std::make_unique<GraphicPipeline>(*_device, *_renderPass);
+    _pipelineBuilder->_dynamicRaster = true; // scene material variants share pipelines
 
     if ((float)_window->_windowExtent.width > 0.0f && (float)_window->_windowExtent.height > 0.0f) {
         _camera->set_aspect((float)_window->_windowExtent.width / (float)_window->_windowExtent.height);
@@ -592,6 +715,10 @@ void VulkanEngine::draw() {
     // Wait GPU to render latest frame. Timeout of 1 second
      VK_CHECK(frame._renderFence->wait(1000000000));
      VK_CHECK(frame._renderFence->reset());
+    _secondaryRecorder->reset(_frameNumber % FRAME_OVERLAP);
+
+    // Frame slot no longer in use by the GPU: destroy resources retired while it was recorded
+    g_deletionQueue.flush(_frameNumber % FRAME_OVERLAP);
 
     // Acquire next presentable image. Use occur only after the image is returned by vkAcquireNextImageKHR and before vkQueuePresentKHR.
     uint32_t imageIndex;
@@ -656,14 +783,21 @@ void VulkanEngine::cleanup() {
             g_frames[i]._queryTimestamp.destroy();
         }
 
+        _materialManager->wait_all(); // no request left referencing the pipeline builder
         JobManager::destroy();
 
+        // Released models hand their bindless slots to the deletion queue : released before the final flush
         _scene->_renderables.clear();
+        _meshManager->clear_entities();
+        g_deletionQueue.flush_all();
         _atmosphere.reset();
         _skybox.reset();
         _cascadedShadow.reset();
+        _indirectDraw.reset();
+        _secondaryRecorder.reset();
         _ui.reset();
         _meshManager.reset();
+        _bindless.reset();
         _materialManager.reset();
         _systemManager.reset();
         _pipelineBuilder.reset();
@@ -671,9 +805,16 @@ void VulkanEngine::cleanup() {
         _renderPass.reset();
         _swapchain.reset();
         _mainDeletionQueue.flush();
+        _device->_pipelineLibrary.reset();
+        _device->_shaderModuleCache.reset();
+        _device->_pipelineLayoutCache.reset();
+        _device->_pipelineCache->save();
+        _device->_pipelineCache.reset();
 
         delete _uploadContext._commandBuffer;
         delete _uploadContext._commandPool;
+        delete _uploadContext._transferBuffer;
+        delete _uploadContext._transferPool;
 
         // todo find a way to move this into vk_device without breaking swapchain
         vmaDestroyAllocator(_device->_allocator);
@@ -30,6 +30,7 @@
 #include "core/vk_descriptor_allocator.h"
 #include "core/vk_descriptor_builder.h"
 #include "core/vk_descriptor_cache.h"
+#include "core/vk_bindless_table.h"
 #include "core/vk_fence.h"
 #include "core/vk_semaphore.h"
 #include "core/vk_texture.h"
@@ -37,6 +38,7 @@
 #include "core/vk_command_buffer.h"
 #include "core/vk_buffer.h"
 #include "core/vk_query_pool.h"
+#include "core/vk_secondary_recorder.h"
 
 #include "core/manager/vk_material_manager.h"
 #include "core/manager/vk_mesh_manager.h"
@@ -54,6 +56,7 @@
 
 #include "techniques/vk_cascaded_shadow_map.h"
 #include "techniques/vk_atmosphere.h"
+#include "techniques/vk_indirect_draw.h"
 
 class Window;
 class Device;
@@ -91,6 +94,10 @@ class VulkanEngine {
 public:
 	bool _isInitialized = false;
     uint32_t _frameNumber = 0;
+    /** @brief incremented when the scene renderables change, frames compare it to their own buffers */
+    uint32_t _sceneVersion = 0;
+    /** @brief key of the shader variant prepared for the scene materials */
+    uint64_t _variantKey = 0;
 
     std::unique_ptr<Window> _window;
     std::unique_ptr<Device> _device;
@@ -104,6 +111,8 @@ public:
     std::unique_ptr<Skybox> _skybox;
     std::unique_ptr<CascadedShadow> _cascadedShadow;
     std::unique_ptr<Atmosphere> _atmosphere;
+    std::unique_ptr<IndirectDraw> _indirectDraw;
+    std::unique_ptr<SecondaryRecorder> _secondaryRecorder;
 
     std::unique_ptr<SystemManager> _systemManager;
     std::shared_ptr<MaterialManager> _materialManager;
@@ -116,6 +125,7 @@ public:
 
     DescriptorLayoutCache* _layoutCache;
     DescriptorAllocator* _allocator;
+    std::unique_ptr<BindlessTable> _bindless;
 
     struct {
         VkDescriptorSetLayout skybox = VK_NULL_HANDLE;
@@ -134,6 +144,7 @@ public:
         bool skybox = false;
         bool atmosphere = false;
         bool meshes = true;
+        bool indirectDraw = false;
         bool ui = true;
     } _enabledFeatures;
 
@@ -144,6 +155,7 @@ public:
 	void init();
 	void cleanup();
 	void run();
+    ShaderVariant shader_variant() const;
 
 private:
     bool _reset {false};
@@ -163,9 +175,9 @@ private:
     void init_materials();
     void init_managers();
     void recreate_swap_chain();
-    void ui_overlay();
+    void ui_overlay(VkCommandBuffer commandBuffer);
     void update_uniform_buffers();
-    void update_objects_buffer(RenderObject *first, int count);
+    void update_objects_buffer(FrameData& frame, RenderObject *first, int count);
     void build_command_buffers(FrameData& frame, int imageIndex);
     void compute();
     void render(int imageIndex);
@@ -182,7 +194,8 @@ private:
     void allocate_buffers(Device& device) {
         for (int i = 0; i < FRAME_OVERLAP; i++) {
             const size_t depthBufferSize =  helper::pad_uniform_buffer_size(device, sizeof(GPUEnabledFeaturesData));
-            Buffer::create_buffer(device, &g_frames[i].enabledFeaturesBuffer, depthBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+            Buffer::create_buffer(device, &g_frames[i].enabledFeaturesBuffer, depthBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+            g_frames[i].uniformArena.init(device);
         }
     }
 };